@@ -170,6 +170,7 @@ public:
     project.set_storage_model (Project::StorageModel::COPY);
 
     // initialize mix_freq with something to avoid crashes; can be overwritten later in activate
+    project.enable_voice_pool();
     project.set_mix_freq (48000);
   }
 
@@ -299,6 +300,18 @@ public:
           }
       }
   }
+  /*--- latency ---*/
+  bool
+  implementsLatency() const noexcept override
+  {
+    return true;
+  }
+  uint32_t
+  latencyGet() const noexcept override
+  {
+    // the MidiSynth is created by activate(), so the host gets the latency for the current sample rate
+    return project.midi_synth()->latency();
+  }
   /*--- processing ---*/
   bool
   activate (double sampleRate, uint32_t minFrameCount, uint32_t maxFrameCount) noexcept override
@@ -0,0 +1,231 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smdialog.hh"
+#include "smbutton.hh"
+#include "smlabel.hh"
+#include "smfixedgrid.hh"
+#include "smsynthinterface.hh"
+
+#include <functional>
+#include <numeric>
+#include <map>
+
+namespace SpectMorph
+{
+
+/* shows where the synthesis thread spends its time (per operator) and how many partials
+ * partial culling drops, while the dialog is open
+ */
+class DspLoadDialog : public Dialog
+{
+  static constexpr int    MAX_ROWS = 8;
+  static constexpr double UPDATE_SECONDS = 0.5;   // average measurements over this amount of audio
+
+  struct Row
+  {
+    Label *name = nullptr;
+    Label *total = nullptr;
+    std::array<Label *, DspProfile::N_CATEGORIES> category {};
+  };
+  std::vector<Row>  rows;
+  Label            *summary_label = nullptr;
+  Label            *culling_label = nullptr;
+  MorphPlan        *morph_plan = nullptr;
+  SynthInterface   *synth_interface = nullptr;
+
+  /* accumulated measurements */
+  std::map<uintptr_t, std::array<double, DspProfile::N_CATEGORIES>> op_time;
+  double audio_time = 0;
+  double synth_time = 0;
+  double max_voice_load = 0;
+  size_t n_voices = 0;
+  bool   partial_culling = false;
+  int    max_culled_partials = 0; // for all voices
+
+  static std::string
+  category_name (int c)
+  {
+    switch (c)
+      {
+        case DspProfile::OPERATOR: return "Other";
+        case DspProfile::SINES:    return "Sines";
+        case DspProfile::NOISE:    return "Noise";
+        case DspProfile::FILTER:   return "Filter";
+        case DspProfile::MORPH:    return "Morph";
+      }
+    return "?";
+  }
+  std::string
+  op_name (uintptr_t ptr_id)
+  {
+    for (auto op : morph_plan->operators())
+      if (op->ptr_id() == ptr_id)
+        return op->name();
+    return "-";
+  }
+  std::string
+  percent (double time)
+  {
+    return string_printf ("%.1f%%", time / audio_time * 100);
+  }
+  void
+  update_labels()
+  {
+    std::vector<std::pair<double, uintptr_t>> ops;
+    for (const auto& [op, times] : op_time)
+      ops.emplace_back (std::accumulate (times.begin(), times.end(), 0.0), op);
+
+    std::sort (ops.begin(), ops.end(), std::greater<>());
+
+    for (size_t r = 0; r < rows.size(); r++)
+      {
+        Row& row = rows[r];
+        if (r < ops.size())
+          {
+            const auto& times = op_time[ops[r].second];
+
+            row.name->set_text (op_name (ops[r].second));
+            row.total->set_text (percent (ops[r].first));
+            for (int c = 0; c < DspProfile::N_CATEGORIES; c++)
+              row.category[c]->set_text (percent (times[c]));
+          }
+        else
+          {
+            row.name->set_text ("");
+            row.total->set_text ("");
+            for (auto label : row.category)
+              label->set_text ("");
+          }
+      }
+    summary_label->set_text (string_printf ("Synthesis: %.1f%%     Voices: %zd (max. %.1f%% per voice)",
+                                            synth_time / audio_time * 100, n_voices, max_voice_load * 100));
+    if (partial_culling)
+      culling_label->set_text (string_printf ("Partial Culling: max. %d partials not rendered", max_culled_partials));
+    else
+      culling_label->set_text ("");
+  }
+public:
+  DspLoadDialog (Window *window, MorphPlan *morph_plan, SynthInterface *synth_interface) :
+    Dialog (window),
+    morph_plan (morph_plan),
+    synth_interface (synth_interface)
+  {
+    FixedGrid grid;
+
+    const double name_w = 16;
+    const double col_w = 8;
+    const double w = name_w + col_w * (DspProfile::N_CATEGORIES + 1) + 4;
+
+    double yoffset = 1;
+
+    auto title_label = new Label (this, "DSP Load");
+    title_label->set_bold (true);
+    title_label->set_align (TextAlign::CENTER);
+    grid.add_widget (title_label, 0, yoffset, w, 3);
+    yoffset += 4;
+
+    auto add_row = [&] (bool bold)
+      {
+        Row row;
+        auto mk_label = [&] (double x, double width, TextAlign align)
+          {
+            auto label = new Label (this, "");
+            label->set_align (align);
+            label->set_bold (bold);
+            grid.add_widget (label, x, yoffset, width, 2);
+            return label;
+          };
+        row.name = mk_label (2, name_w, TextAlign::LEFT);
+        row.total = mk_label (2 + name_w, col_w, TextAlign::RIGHT);
+        for (int c = 0; c < DspProfile::N_CATEGORIES; c++)
+          row.category[c] = mk_label (2 + name_w + col_w * (c + 1), col_w, TextAlign::RIGHT);
+        yoffset += 2;
+        return row;
+      };
+    Row header = add_row (true);
+    header.name->set_text ("Operator");
+    header.total->set_text ("Total");
+    for (int c = 0; c < DspProfile::N_CATEGORIES; c++)
+      header.category[c]->set_text (category_name (c));
+    yoffset++;
+
+    for (int r = 0; r < MAX_ROWS; r++)
+      rows.push_back (add_row (false));
+    yoffset++;
+
+    summary_label = new Label (this, "Play some notes to measure the DSP load.");
+    grid.add_widget (summary_label, 2, yoffset, w - 4, 2);
+    yoffset += 2;
+
+    culling_label = new Label (this, "");
+    grid.add_widget (culling_label, 2, yoffset, w - 4, 2);
+    yoffset += 3;
+
+    auto ok_button = new Button (this, "Ok");
+    grid.add_widget (ok_button, w / 2 - 5, yoffset, 10, 3);
+    connect (ok_button->signal_clicked, this, &Dialog::on_accept);
+    yoffset += 4;
+
+    grid.add_widget (this, 0, 0, w, yoffset);
+
+    window->set_keyboard_focus (this);
+
+    connect (synth_interface->signal_notify_event, this, &DspLoadDialog::on_synth_notify_event);
+    synth_interface->emit_dsp_profile (true);
+  }
+  ~DspLoadDialog()
+  {
+    synth_interface->emit_dsp_profile (false);
+  }
+  void
+  on_synth_notify_event (SynthNotifyEvent *ne)
+  {
+    auto voice_status = dynamic_cast<ActiveVoiceStatusEvent *> (ne);
+    if (voice_status && voice_status->culled_partials.size())
+      {
+        partial_culling = true;
+        max_culled_partials = std::max (max_culled_partials, std::accumulate (voice_status->culled_partials.begin(),
+                                                                               voice_status->culled_partials.end(), 0));
+      }
+    auto profile = dynamic_cast<DspProfileEvent *> (ne);
+    if (!profile)
+      return;
+
+    audio_time += profile->audio_time;
+    synth_time += profile->synth_time;
+    for (size_t i = 0; i < profile->ops.size(); i++)
+      {
+        auto& times = op_time[profile->ops[i]];
+        for (int c = 0; c < DspProfile::N_CATEGORIES; c++)
+          times[c] += profile->op_time[c][i];
+      }
+    n_voices = std::max (n_voices, profile->voices.size());
+    if (profile->audio_time > 0)
+      {
+        for (auto t : profile->voice_time)
+          max_voice_load = std::max<double> (max_voice_load, t / profile->audio_time);
+      }
+
+    if (audio_time >= UPDATE_SECONDS)
+      {
+        update_labels();
+
+        op_time.clear();
+        audio_time = 0;
+        synth_time = 0;
+        max_voice_load = 0;
+        n_voices = 0;
+        partial_culling = false;
+        max_culled_partials = 0;
+      }
+  }
+  void
+  key_press_event (const PuglEventKey& key_event) override
+  {
+    on_accept();
+  }
+};
+
+}
@@ -89,8 +89,17 @@ MorphOutputView::MorphOutputView (Widget *parent, MorphOutput *morph_output, Mor
   pv_vibrato_frequency = add_property_view (MorphOutput::P_VIBRATO_FREQUENCY, op_layout);
   pv_vibrato_attack = add_property_view (MorphOutput::P_VIBRATO_ATTACK, op_layout);
 
+  // Partial Culling
+  pv_partial_culling = add_property_view (MorphOutput::P_PARTIAL_CULLING, op_layout);
+  pv_partial_budget = add_property_view (MorphOutput::P_PARTIAL_BUDGET, op_layout);
+
+  // Early Voice Termination
+  pv_early_termination = add_property_view (MorphOutput::P_EARLY_TERMINATION, op_layout);
+  pv_early_termination_threshold = add_property_view (MorphOutput::P_EARLY_TERMINATION_THRESHOLD, op_layout);
+  pv_early_termination_hold = add_property_view (MorphOutput::P_EARLY_TERMINATION_HOLD, op_layout);
+
   // visibility updates
-  for (auto pv : { pv_unison, pv_adsr, pv_filter, pv_filter_type, pv_portamento, pv_vibrato })
+  for (auto pv : { pv_unison, pv_adsr, pv_filter, pv_filter_type, pv_portamento, pv_vibrato, pv_partial_culling, pv_early_termination })
     connect (pv->property()->signal_value_changed, this, &MorphOutputView::update_visible);
 
   update_visible();
@@ -156,6 +165,13 @@ MorphOutputView::update_visible()
   pv_vibrato_frequency->set_visible (vibrato);
   pv_vibrato_attack->set_visible (vibrato);
 
+  bool partial_culling = pv_partial_culling->property()->get_bool();
+  pv_partial_budget->set_visible (partial_culling);
+
+  bool early_termination = pv_early_termination->property()->get_bool();
+  pv_early_termination_threshold->set_visible (early_termination);
+  pv_early_termination_hold->set_visible (early_termination);
+
   op_layout.activate();
   signal_size_changed();
 }
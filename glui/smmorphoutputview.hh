@@ -53,6 +53,11 @@ class MorphOutputView : public MorphOperatorView
   PropertyView               *pv_vibrato_depth;
   PropertyView               *pv_vibrato_frequency;
   PropertyView               *pv_vibrato_attack;
+  PropertyView               *pv_partial_culling;
+  PropertyView               *pv_partial_budget;
+  PropertyView               *pv_early_termination;
+  PropertyView               *pv_early_termination_threshold;
+  PropertyView               *pv_early_termination_hold;
 
   OutputADSRWidget           *output_adsr_widget;
 
@@ -8,6 +8,7 @@
 #include "smconfig.hh"
 #include "smtimer.hh"
 #include "smpathdialog.hh"
+#include "smdsploaddialog.hh"
 
 using namespace SpectMorph;
 using std::string;
@@ -67,6 +68,8 @@ MorphPlanWindow::MorphPlanWindow (EventLoop& event_loop,
   connect (about_item->signal_clicked, this, &MorphPlanWindow::on_about_clicked);
   MenuItem *show_paths = help_menu->add_item ("Show Paths...");
   connect (show_paths->signal_clicked, this, &MorphPlanWindow::on_show_paths_clicked);
+  MenuItem *dsp_load = help_menu->add_item ("DSP Load...");
+  connect (dsp_load->signal_clicked, this, &MorphPlanWindow::on_dsp_load_clicked);
 
   grid.add_widget (menu_bar, 1, 1, 94, 3);
 
@@ -250,6 +253,14 @@ MorphPlanWindow::on_show_paths_clicked()
   dialog->run();
 }
 
+void
+MorphPlanWindow::on_dsp_load_clicked()
+{
+  auto dialog = new DspLoadDialog (this, m_morph_plan, m_synth_interface);
+
+  dialog->run();
+}
+
 SynthInterface*
 MorphPlanWindow::synth_interface()
 {
@@ -57,6 +57,7 @@ public:
   void on_file_export_clicked();
   void on_about_clicked();
   void on_show_paths_clicked();
+  void on_dsp_load_clicked();
   void on_synth_notify_event (SynthNotifyEvent *ne);
 };
 
@@ -90,7 +90,10 @@ protected:
     });
     connect (line_edit->signal_return_pressed, [this] {
       if (line_edit_changed)
-        this->property.set_edit_str (line_edit->text());
+        {
+          this->property.set_edit_str (line_edit->text());
+          update_line_edit_text(); // property doesn't notify if the value didn't change
+        }
       else
         on_accept();
     });
@@ -112,6 +112,7 @@ JackSynth::JackSynth (jack_client_t *client, Project *project) :
   m_project (project)
 {
   m_mix_freq = jack_get_sample_rate (client);
+  m_project->enable_voice_pool();
   m_project->set_mix_freq (m_mix_freq);
 
   // JACK version of SpectMorph exports its control signal by CC#16,...
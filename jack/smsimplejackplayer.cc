@@ -44,7 +44,7 @@ Source::rt_audio_block (size_t index, RTAudioBlock& out_block)
 {
   if (my_audio && index < my_audio->contents.size())
     {
-      out_block.assign (my_audio->contents[index]);
+      out_block.borrow (my_audio->contents[index]);
       return true;
     }
   else
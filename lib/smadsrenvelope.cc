@@ -70,6 +70,18 @@ ADSREnvelope::done() const
   return (state == State::DONE);
 }
 
+bool
+ADSREnvelope::is_constant() const
+{
+  return (state == State::SUSTAIN);
+}
+
+double
+ADSREnvelope::current_level() const
+{
+  return level;
+}
+
 void
 ADSREnvelope::compute_slope_params (int len, float start_x, float end_x, State param_state)
 {
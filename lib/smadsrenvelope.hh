@@ -35,6 +35,8 @@ public:
   void retrigger();
   void release();
   bool done() const;
+  bool is_constant() const;
+  double current_level() const;
   void process (size_t n_values, float *values);
 
   // test only
@@ -3,6 +3,8 @@
 #include "smconfig.hh"
 #include "smmicroconf.hh"
 
+#include <algorithm>
+
 using namespace SpectMorph;
 
 using std::string;
@@ -30,6 +32,22 @@ Config::Config()
         {
           m_zoom = i;
         }
+      else if (cfg_parser.command ("render_threads", i))
+        {
+          m_render_threads = std::max (i, 0);
+        }
+      else if (cfg_parser.command ("max_voices", i))
+        {
+          m_max_voices = std::clamp (i, 1, 256);
+        }
+      else if (cfg_parser.command ("spectral_mixing", i))
+        {
+          m_spectral_mixing = i;
+        }
+      else if (cfg_parser.command ("fixed_internal_rate", i))
+        {
+          m_fixed_internal_rate = i;
+        }
       else if (cfg_parser.command ("debug", s))
         {
           m_debug.push_back (s);
@@ -61,6 +79,30 @@ Config::set_zoom (int z)
   m_zoom = z;
 }
 
+int
+Config::render_threads() const
+{
+  return m_render_threads;
+}
+
+int
+Config::max_voices() const
+{
+  return m_max_voices;
+}
+
+bool
+Config::spectral_mixing() const
+{
+  return m_spectral_mixing;
+}
+
+bool
+Config::fixed_internal_rate() const
+{
+  return m_fixed_internal_rate;
+}
+
 vector<string>
 Config::debug()
 {
@@ -91,6 +133,18 @@ Config::store()
   fprintf (file, "# it can be manually edited, however, if you do that, be careful\n");
   fprintf (file, "zoom %d\n", m_zoom);
 
+  if (m_render_threads)
+    fprintf (file, "render_threads %d\n", m_render_threads);
+
+  if (m_max_voices != 128)
+    fprintf (file, "max_voices %d\n", m_max_voices);
+
+  if (m_spectral_mixing)
+    fprintf (file, "spectral_mixing 1\n");
+
+  if (m_fixed_internal_rate)
+    fprintf (file, "fixed_internal_rate 1\n");
+
   for (auto area : m_debug)
     fprintf (file, "debug %s\n", area.c_str());
 
@@ -13,6 +13,10 @@ namespace SpectMorph
 class Config
 {
   int                      m_zoom = 100;
+  int                      m_render_threads = 0;
+  int                      m_max_voices = 128;
+  bool                     m_spectral_mixing = false;
+  bool                     m_fixed_internal_rate = false;
   std::vector<std::string> m_debug;
   std::string              m_font;
   std::string              m_font_bold;
@@ -24,6 +28,11 @@ public:
   int   zoom() const;
   void  set_zoom (int z);
 
+  int   render_threads() const;
+  int   max_voices() const;
+  bool  spectral_mixing() const;
+  bool  fixed_internal_rate() const;
+
   std::vector<std::string> debug();
 
   std::string font() const;
@@ -0,0 +1,85 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smdspprofile.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+thread_local DspProfile        *DspProfile::t_profile = nullptr;
+thread_local DspProfile::Scope *DspProfile::t_scope = nullptr;
+
+void
+DspProfile::Scope::start (Category category, uintptr_t op)
+{
+  m_profile  = t_profile;
+  m_parent   = t_scope;
+  m_category = category;
+  m_op       = (op || !m_parent) ? op : m_parent->m_op;
+
+  t_scope = this;
+  m_start = ticks();
+}
+
+void
+DspProfile::Scope::stop()
+{
+  const uint64 elapsed = ticks() - m_start;
+
+  m_profile->add (m_op, m_category, elapsed - std::min (m_child_ticks, elapsed));
+  if (m_parent)
+    m_parent->m_child_ticks += elapsed;
+
+  t_scope = m_parent;
+}
+
+void
+DspProfile::set_thread_profile (DspProfile *profile)
+{
+  assert (!t_scope); // must not be changed while measuring
+
+  t_profile = profile;
+}
+
+void
+DspProfile::add (uintptr_t op, Category category, uint64 ticks)
+{
+  for (size_t i = 0; i < m_n_entries; i++)
+    {
+      if (m_entries[i].op == op)
+        {
+          m_entries[i].ticks[category] += ticks;
+          return;
+        }
+    }
+  /* no allocation here: if the table is full, time for further operators is not recorded */
+  if (m_n_entries < MAX_ENTRIES)
+    {
+      Entry& entry = m_entries[m_n_entries++];
+
+      entry.op = op;
+      entry.ticks.fill (0);
+      entry.ticks[category] = ticks;
+    }
+}
+
+void
+DspProfile::merge (const DspProfile& other)
+{
+  for (size_t i = 0; i < other.m_n_entries; i++)
+    {
+      const Entry& entry = other.m_entries[i];
+
+      for (int c = 0; c < N_CATEGORIES; c++)
+        {
+          if (entry.ticks[c])
+            add (entry.op, Category (c), entry.ticks[c]);
+        }
+    }
+}
+
+void
+DspProfile::clear()
+{
+  m_n_entries = 0;
+}
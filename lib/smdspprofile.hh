@@ -0,0 +1,92 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smutils.hh"
+
+#include <array>
+#include <chrono>
+
+namespace SpectMorph
+{
+
+/*
+ * DspProfile measures where the synthesis thread spends its time
+ *
+ * Code that should be measured creates a DspProfile::Scope. The time of each scope
+ * is accumulated per operator and category. Nested scopes are subtracted from the
+ * enclosing scope, so that the times of all entries add up to the total time.
+ *
+ * Profiling is enabled for a thread by setting a profile with set_thread_profile().
+ * Without profile (the default), a scope only checks a thread local pointer.
+ */
+class DspProfile
+{
+public:
+  enum Category {
+    OPERATOR,     // operator code not covered by other categories
+    SINES,        // LiveDecoder::gen_sines
+    NOISE,        // LiveDecoder::gen_noise
+    FILTER,       // output filter
+    MORPH,        // MorphUtils::morph
+    N_CATEGORIES
+  };
+  struct Entry
+  {
+    uintptr_t                           op = 0;
+    std::array<uint64, N_CATEGORIES>    ticks {};
+  };
+  static constexpr size_t MAX_ENTRIES = 64;
+
+  class Scope
+  {
+    SPECTMORPH_CLASS_NON_COPYABLE (Scope);
+
+    DspProfile *m_profile = nullptr;
+    Scope      *m_parent = nullptr;
+    uintptr_t   m_op = 0;
+    Category    m_category = OPERATOR;
+    uint64      m_start = 0;
+    uint64      m_child_ticks = 0;
+
+    void start (Category category, uintptr_t op);
+    void stop();
+  public:
+    /* op == 0: use the operator of the enclosing scope */
+    Scope (Category category, uintptr_t op = 0)
+    {
+      if (t_profile)
+        start (category, op);
+    }
+    ~Scope()
+    {
+      if (m_profile)
+        stop();
+    }
+  };
+private:
+  std::array<Entry, MAX_ENTRIES> m_entries;
+  size_t                         m_n_entries = 0;
+
+  static thread_local DspProfile *t_profile;
+  static thread_local Scope      *t_scope;
+
+  void add (uintptr_t op, Category category, uint64 ticks);
+public:
+  static uint64
+  ticks()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+  static constexpr double TICKS_PER_SECOND = 1e9;
+
+  static void set_thread_profile (DspProfile *profile);
+
+  void merge (const DspProfile& other);
+  void clear();
+
+  size_t       n_entries() const { return m_n_entries; }
+  const Entry& entry (size_t i) const { return m_entries[i]; }
+};
+
+}
@@ -40,6 +40,11 @@ public:
   {
     return state == State::DONE;
   }
+  bool
+  is_constant() const
+  {
+    return state == State::ON;
+  }
   void
   process (size_t n_values, float *values)
   {
@@ -141,6 +146,7 @@ EffectDecoder::EffectDecoder (MorphOutputModule *output_module, float mix_freq)
   output_module (output_module),
   chain_decoder (mix_freq)
 {
+  chain_decoder.set_output_module (output_module);
   skip_source.reset (new EffectDecoderSource());
   adsr_envelope.reset (new ADSREnvelope());
   simple_envelope.reset (new SimpleEnvelope (mix_freq));
@@ -204,6 +210,10 @@ EffectDecoder::set_config (const MorphOutput::Config *cfg, LiveDecoderSource *so
     chain_decoder.set_filter (nullptr);
 
   filter_enabled = cfg->filter;
+
+  early_termination = cfg->early_termination;
+  early_termination_level = db_to_factor (cfg->early_termination_threshold);
+  early_termination_hold = sm_round_positive (cfg->early_termination_hold / 1000 * mix_freq);
 }
 
 void
@@ -214,6 +224,10 @@ EffectDecoder::retrigger (int channel, float freq, int midi_velocity)
 
   current_freq = freq;
 
+  released = false;
+  terminated_early = false;
+  quiet_samples = 0;
+
   if (adsr_enabled)
     adsr_envelope->retrigger();
   else
@@ -228,17 +242,60 @@ EffectDecoder::process (RTMemoryArea& rt_memory_area,
                         const float  *freq_in,
                         float        *audio_out)
 {
+  /* the spectral mixer can be used if the envelope doesn't change the signal
+   * (except for a constant factor) during this block
+   */
+  bool mixed = true;
+  if (spectral_mixer && adsr_enabled && adsr_envelope->is_constant())
+    chain_decoder.set_spectral_mixer (spectral_mixer, spectral_mixer_gain * adsr_envelope->current_level());
+  else if (spectral_mixer && !adsr_enabled && simple_envelope->is_constant())
+    chain_decoder.set_spectral_mixer (spectral_mixer, spectral_mixer_gain);
+  else
+    {
+      chain_decoder.set_spectral_mixer (nullptr, 0);
+      mixed = false;
+    }
+
   chain_decoder.process (rt_memory_area, n_values, freq_in, audio_out);
 
   if (adsr_enabled)
     adsr_envelope->process (n_values, audio_out);
   else
     simple_envelope->process (n_values, audio_out);
+
+  if (early_termination && released)
+    update_early_termination (n_values, audio_out, mixed);
+}
+
+void
+EffectDecoder::update_early_termination (size_t n_values, const float *audio_out, bool mixed)
+{
+  /* with the spectral mixer, (most of) the output of this voice is not in audio_out,
+   * so we can't use this block to decide whether the voice is still audible
+   */
+  if (mixed)
+    {
+      quiet_samples = 0;
+      return;
+    }
+  float peak = 0;
+  for (size_t i = 0; i < n_values; i++)
+    peak = std::max (peak, std::abs (audio_out[i]));
+
+  if (peak < early_termination_level)
+    quiet_samples += n_values;
+  else
+    quiet_samples = 0;
+
+  if (quiet_samples >= early_termination_hold)
+    terminated_early = true;
 }
 
 void
 EffectDecoder::release()
 {
+  released = true;
+
   if (adsr_enabled)
     adsr_envelope->release();
   else
@@ -251,14 +308,54 @@ EffectDecoder::release()
 bool
 EffectDecoder::done()
 {
+  if (terminated_early)
+    return true;
+
   if (adsr_enabled)
     return adsr_envelope->done();
   else
     return simple_envelope->done();
 }
 
+void
+EffectDecoder::set_spectral_mixer (SpectralMixer *mixer, float gain)
+{
+  spectral_mixer = mixer;
+  spectral_mixer_gain = gain;
+
+  /* without mixer, blocks that were already mixed are moved back to the voice immediately (see
+   * LiveDecoder::set_spectral_mixer), since the old mixer may be deleted before the next block
+   */
+  if (!mixer)
+    chain_decoder.set_spectral_mixer (nullptr, 0);
+}
+
+void
+EffectDecoder::set_partial_budget (size_t max_partials)
+{
+  chain_decoder.set_partial_budget (max_partials);
+}
+
+size_t
+EffectDecoder::culled_partials() const
+{
+  return chain_decoder.culled_partials();
+}
+
 double
 EffectDecoder::time_offset_ms() const
 {
   return chain_decoder.time_offset_ms();
 }
+
+double
+EffectDecoder::process_offset_ms() const
+{
+  return chain_decoder.process_offset_ms();
+}
+
+void
+EffectDecoder::set_split_positions (const std::vector<uint> *positions)
+{
+  chain_decoder.set_split_positions (positions);
+}
@@ -30,6 +30,19 @@ class EffectDecoder
   LiveDecoderFilter                     live_decoder_filter;
   float                                 current_freq = 440;
 
+  SpectralMixer                        *spectral_mixer = nullptr;
+  float                                 spectral_mixer_gain = 0;
+
+  /* early termination: released voices are done if their output stays below a threshold */
+  bool                                  early_termination = false;
+  float                                 early_termination_level = 0;
+  size_t                                early_termination_hold = 0;
+  size_t                                quiet_samples = 0;
+  bool                                  released = false;
+  bool                                  terminated_early = false;
+
+  void update_early_termination (size_t n_values, const float *audio_out, bool mixed);
+
 public:
   EffectDecoder (MorphOutputModule *output_module, float mix_freq);
   ~EffectDecoder();
@@ -43,8 +56,13 @@ public:
                 float        *audio_out);
   void release();
   bool done();
+  void set_spectral_mixer (SpectralMixer *mixer, float gain);
+  void set_partial_budget (size_t max_partials);
 
+  size_t culled_partials() const;
   double time_offset_ms() const;
+  double process_offset_ms() const;
+  void   set_split_positions (const std::vector<uint> *positions);
 };
 
 }
@@ -8,7 +8,6 @@
 #include "smutils.hh"
 #include "smblockutils.hh"
 #include "smalignedarray.hh"
-#include "smrandom.hh"
 #include "smaudiotool.hh"
 #include "config.h"
 
@@ -17,10 +16,14 @@
 #include <assert.h>
 
 #include <complex>
+#include <array>
+#include <limits>
 #include <map>
 #include <algorithm>
 #include <memory>
 #include <cinttypes>
+#include <thread>
+#include <atomic>
 
 using namespace SpectMorph;
 using std::vector;
@@ -278,6 +281,58 @@ Encoder::Encoder (const EncoderParams& enc_params)
   optimal_attack.attack_end_ms = 0;
 }
 
+/**
+ * Number of threads to use for analysis steps that process frames independently.
+ */
+int
+Encoder::frame_threads()
+{
+  int n_threads = enc_params.n_threads;
+  if (n_threads <= 0)
+    n_threads = std::max<int> (std::thread::hardware_concurrency(), 1);
+
+  return std::min<size_t> (n_threads, std::max<size_t> (audio_blocks.size(), 1));
+}
+
+/**
+ * This function calls frame_func (frame, thread_index) for each frame, using frame_threads() threads.
+ *
+ * The frame function must only modify the data of its own frame, so that the results
+ * don't depend on the number of threads or the order in which frames are processed.
+ * Per thread data can be indexed with thread_index (0 <= thread_index < frame_threads()).
+ * If the encoder is killed, the remaining frames are skipped.
+ */
+void
+Encoder::for_each_frame (const char *where, const std::function<void (size_t frame, int thread_index)>& frame_func)
+{
+  const size_t n_frames = audio_blocks.size();
+
+  std::atomic<size_t> next_frame { 0 };
+  std::atomic<bool>   stop { false };
+
+  auto run_frames = [&] (int thread_index)
+    {
+      size_t frame, frames_done = 0;
+      while (!stop && (frame = next_frame++) < n_frames)
+        {
+          frame_func (frame, thread_index);
+
+          // every thread checks the kill function, so a slow frame on one thread doesn't delay termination
+          if (killed (where, frames_done++ & 7))
+            stop = true;
+        }
+    };
+
+  vector<std::thread> threads;
+  for (int t = 1; t < frame_threads(); t++)
+    threads.emplace_back (run_frames, t);
+
+  run_frames (0);
+
+  for (auto& thread : threads)
+    thread.join();
+}
+
 /**
  * This function computes the short-time-fourier-transform (STFT) of the input
  * signal using a window to cut the individual frames out of the sample.
@@ -310,45 +365,67 @@ Encoder::compute_stft (const WavData& multi_channel_wav_data, int channel)
 
   sample_count = n_values;
 
-  vector<double> in (block_size * zeropad), out (block_size * zeropad + 2);
+  /* frames are transformed in batches, using one fftw plan for all frames of the batch */
+  constexpr size_t STFT_BATCH = 16;
 
-  float *fft_in = FFT::new_array_float (in.size());
-  float *fft_out = FFT::new_array_float (in.size());
+  const size_t fft_size   = block_size * zeropad;
+  const size_t fft_stride = FFT::fftar_many_stride (fft_size);
+  const FFT::Plan *fft_plan = FFT::plan_fftar_many_float (fft_size, STFT_BATCH);
 
-  for (uint64 pos = 0; pos < n_values; pos += enc_params.frame_step)
+  float *fft_in = FFT::new_array_float (fft_stride * STFT_BATCH);
+  float *fft_out = FFT::new_array_float (fft_stride * STFT_BATCH);
+
+  vector<double> out (fft_size + 2);
+
+  for (uint64 batch_pos = 0; batch_pos < n_values; batch_pos += enc_params.frame_step * STFT_BATCH)
     {
-      EncoderBlock audio_block;
+      const size_t first_block = audio_blocks.size();
 
-      /* start with zero block, so the incomplete blocks at end are zeropadded */
-      vector<float> block (block_size);
+      /* unused frames of the last batch (and zeropadding) stay zero */
+      std::fill (fft_in, fft_in + fft_stride * STFT_BATCH, 0);
 
-      for (size_t offset = 0; offset < block.size(); offset++)
+      size_t n_frames = 0;
+      for (uint64 pos = batch_pos; pos < n_values && n_frames < STFT_BATCH; pos += enc_params.frame_step)
         {
-          if (pos + offset < wav_data.n_values())
-            block[offset] = wav_data[pos + offset];
-        }
-      vector<float> debug_samples (block.begin(), block.end());
-      Block::mul (enc_params.block_size, &block[0], &window[0]);
+          EncoderBlock audio_block;
 
-      int j = in.size() - enc_params.frame_size / 2;
-      for (vector<float>::const_iterator i = block.begin(); i != block.end(); i++)
-        in[(j++) % in.size()] = *i;
+          /* start with zero block, so the incomplete blocks at end are zeropadded */
+          vector<float> block (block_size);
 
-      std::copy (in.begin(), in.end(), fft_in);
-      FFT::fftar_float (in.size(), fft_in, fft_out);
-      std::copy (fft_out, fft_out + in.size(), out.begin());
+          for (size_t offset = 0; offset < block.size(); offset++)
+            {
+              if (pos + offset < wav_data.n_values())
+                block[offset] = wav_data[pos + offset];
+            }
+          audio_block.debug_samples.assign (block.begin(), block.begin() + frame_size);
+          Block::mul (enc_params.block_size, &block[0], &window[0]);
 
-      out[block_size * zeropad] = out[1];
-      out[block_size * zeropad + 1] = 0;
-      out[1] = 0;
+          float *in = fft_in + n_frames * fft_stride;
+          int j = fft_size - enc_params.frame_size / 2;
+          for (vector<float>::const_iterator i = block.begin(); i != block.end(); i++)
+            in[(j++) % fft_size] = *i;
 
-      audio_block.noise.assign (out.begin(), out.end()); // <- will be overwritten by noise spectrum later on
-      audio_block.original_fft.assign (out.begin(), out.end());
-      audio_block.debug_samples.assign (debug_samples.begin(), debug_samples.begin() + frame_size);
+          audio_blocks.push_back (audio_block);
+          n_frames++;
+        }
 
-      audio_blocks.push_back (audio_block);
+      FFT::execute_fftar_many_float (fft_size, STFT_BATCH, fft_in, fft_out, fft_plan);
+
+      for (size_t f = 0; f < n_frames; f++)
+        {
+          EncoderBlock& audio_block = audio_blocks[first_block + f];
 
-      if (killed ("_stft", audio_blocks.size() & 63))
+          const float *frame_out = fft_out + f * fft_stride;
+          std::copy (frame_out, frame_out + fft_size, out.begin());
+          out[fft_size] = out[1];
+          out[fft_size + 1] = 0;
+          out[1] = 0;
+
+          audio_block.noise.assign (out.begin(), out.end()); // <- will be overwritten by noise spectrum later on
+          audio_block.original_fft.assign (out.begin(), out.end());
+        }
+
+      if (killed ("_stft"))
         break; // break to avoid leaking fft_in, fft_out
     }
   FFT::free_array_float (fft_in);
@@ -674,11 +751,21 @@ Encoder::spectral_subtract()
   const size_t zeropad    = enc_params.zeropad;
   const auto&  window     = enc_params.window;
 
-  float *fft_in = FFT::new_array_float (block_size * zeropad);
-  float *fft_out = FFT::new_array_float (block_size * zeropad);
+  /* plan lookup needs a lock: do it once, so frames can be transformed without locking */
+  const FFT::Plan *fft_plan = FFT::plan_fftar_float (block_size * zeropad);
 
-  for (uint64 frame = 0; frame < audio_blocks.size(); frame++)
+  vector<float *> fft_in_buffers, fft_out_buffers;
+  for (int t = 0; t < frame_threads(); t++)
+    {
+      fft_in_buffers.push_back (FFT::new_array_float (block_size * zeropad));
+      fft_out_buffers.push_back (FFT::new_array_float (block_size * zeropad));
+    }
+
+  for_each_frame ("_subtract", [&] (uint64 frame, int thread_index)
     {
+      float *fft_in = fft_in_buffers[thread_index];
+      float *fft_out = fft_out_buffers[thread_index];
+
       AlignedArray<float,16> signal (frame_size);
       for (size_t i = 0; i < audio_blocks[frame].freqs.size(); i++)
 	{
@@ -701,7 +788,7 @@ Encoder::spectral_subtract()
       for (size_t k = 0; k < frame_size; k++)
         fft_in[k] = window[k] * signal[k];
       // FFT
-      FFT::fftar_float (block_size * zeropad, fft_in, fft_out);
+      FFT::execute_fftar_float (block_size * zeropad, fft_in, fft_out, fft_plan);
       std::copy (fft_out, fft_out + block_size * zeropad, out.begin());
       out[block_size * zeropad] = out[1];
       out[block_size * zeropad + 1] = 0;
@@ -728,12 +815,11 @@ Encoder::spectral_subtract()
 	    }
 	  debug ("finalspectrum:%" PRId64 " %g\n", frame, mag);
 	}
-
-      if (killed ("_subtract", frame & 7))
-        return;
-    }
-  FFT::free_array_float (fft_in);
-  FFT::free_array_float (fft_out);
+    });
+  for (auto buffer : fft_in_buffers)
+    FFT::free_array_float (buffer);
+  for (auto buffer : fft_out_buffers)
+    FFT::free_array_float (buffer);
 }
 
 template<class AIter, class BIter>
@@ -754,9 +840,14 @@ refine_sine_params_fast (EncoderBlock& audio_block, double mix_freq, int frame,
 {
   const size_t frame_size = audio_block.debug_samples.size();
 
-  AlignedArray<float, 16> sin_vec (frame_size);
-  AlignedArray<float, 16> cos_vec (frame_size);
-  AlignedArray<float, 16> sines (frame_size);
+  /* number of partials that are refined together (correlation loops share signal and window loads) */
+  constexpr size_t BATCH = 4;
+  const size_t stride = (frame_size + 3) & ~size_t (3); // keep each partial's vectors 16 byte aligned
+
+  AlignedArray<float, 16> sin_vec (stride * BATCH);
+  AlignedArray<float, 16> cos_vec (stride * BATCH);
+  AlignedArray<float, 16> sines (stride * BATCH);
+  AlignedArray<float, 16> mirror (stride * BATCH);
   AlignedArray<float, 16> all_sines (frame_size);
 
   vector<float> good_freqs;
@@ -776,34 +867,39 @@ refine_sine_params_fast (EncoderBlock& audio_block, double mix_freq, int frame,
       fast_vector_sinf (params, &all_sines[0], &all_sines[frame_size]);
     }
 
-  double max_mag;
-  size_t partial = 0;
-  do
+  /* signal without the (unrefined) partials */
+  vector<float> residual (frame_size);
+  for (size_t n = 0; n < frame_size; n++)
+    residual[n] = audio_block.debug_samples[n] - all_sines[n];
+
+  /* each partial is refined using the residual + this partial, independent of the other
+   * partials; refined partials are stored in order of decreasing magnitude
+   */
+  vector<size_t> order;
+  for (size_t i = 0; i < audio_block.freqs.size(); i++)
     {
-      max_mag = 0;
-      // search biggest partial
-      for (size_t i = 0; i < audio_block.freqs.size(); i++)
-        {
-          const double mag = audio_block.mags[i];
+      if (audio_block.mags[i] > 0)
+        order.push_back (i);
+    }
+  std::stable_sort (order.begin(), order.end(), [&] (size_t a, size_t b) { return audio_block.mags[a] > audio_block.mags[b]; });
 
-          if (mag > max_mag)
-            {
-              partial = i;
-              max_mag = mag;
-            }
+  for (size_t start = 0; start < order.size(); start += BATCH)
+    {
+      const size_t n_partials = std::min (BATCH, order.size() - start);
+
+      if (n_partials < BATCH) // unused batch entries contribute zeros
+        {
+          std::fill (&sines[n_partials * stride], &sines[BATCH * stride], 0);
+          std::fill (&mirror[n_partials * stride], &mirror[BATCH * stride], 0);
         }
-      // compute reconstruction of that partial
-      if (max_mag > 0)
+      for (size_t b = 0; b < n_partials; b++)
         {
-          // remove partial, so we only do each partial once
-          double f = audio_block.freqs[partial];
-
-          audio_block.mags[partial] = 0;
-
-          double phase;
-          // determine "perfect" phase and magnitude instead of using interpolated fft phase
-          double x_re = 0;
-          double x_im = 0;
+          const size_t partial = order[start + b];
+          const double f = audio_block.freqs[partial];
+          float *b_sin_vec = &sin_vec[b * stride];
+          float *b_cos_vec = &cos_vec[b * stride];
+          float *b_sines   = &sines[b * stride];
+          float *b_mirror  = &mirror[b * stride];
 
           VectorSinParams params;
 
@@ -814,26 +910,14 @@ refine_sine_params_fast (EncoderBlock& audio_block, double mix_freq, int frame,
           params.phase = normalize_phase (params.phase);
           params.mode = VectorSinParams::REPLACE;
 
-          fast_vector_sincosf (params, &sin_vec[0], &sin_vec[frame_size], &cos_vec[0]);
+          fast_vector_sincosf (params, b_sin_vec, b_sin_vec + frame_size, b_cos_vec);
 
           params.freq  = f;
-          params.mag   = max_mag;
+          params.mag   = audio_block.mags[partial];
           params.phase = audio_block.phases[partial];
           params.mode  = VectorSinParams::REPLACE;
 
-          fast_vector_sinf (params, &sines[0], &sines[frame_size]);
-
-          for (size_t n = 0; n < frame_size; n++)
-            {
-              double v = audio_block.debug_samples[n] - all_sines[n] + sines[n];
-              v *= window[n];
-
-              // multiply windowed signal with complex exp function from fourier transform:
-              //
-              //   v * exp (-j * x) = v * (cos (x) - j * sin (x))
-              x_re += v * cos_vec[n];
-              x_im -= v * sin_vec[n];
-            }
+          fast_vector_sinf (params, b_sines, b_sines + frame_size);
 
           // correct influence of mirrored window (caused by negative frequency component)
           params.mix_freq = mix_freq;
@@ -842,35 +926,50 @@ refine_sine_params_fast (EncoderBlock& audio_block, double mix_freq, int frame,
           params.phase = -((frame_size - 1) / 2.0) * (2 * f) / mix_freq * 2.0 * M_PI + 0.5 * M_PI;
           params.phase = normalize_phase (params.phase);
           params.mode = VectorSinParams::REPLACE;
-          fast_vector_sinf (params, &cos_vec[0], &cos_vec[frame_size]);
+          fast_vector_sinf (params, b_mirror, b_mirror + frame_size);
+        }
 
-          double w2omega = 0;
-          for (size_t n = 0; n < frame_size; n++)
-            w2omega += window[n] * cos_vec[n];
+      // determine "perfect" phase and magnitude instead of using interpolated fft phase
+      double x_re[BATCH] = { 0, };
+      double x_im[BATCH] = { 0, };
+      double w2omega[BATCH] = { 0, };
 
-          x_re *= 2 / (window_weight + w2omega);
-          x_im *= 2 / (window_weight - w2omega);
+      for (size_t n = 0; n < frame_size; n++)
+        {
+          for (size_t b = 0; b < BATCH; b++)
+            {
+              double v = residual[n] + sines[b * stride + n];
+              v *= window[n];
+
+              // multiply windowed signal with complex exp function from fourier transform:
+              //
+              //   v * exp (-j * x) = v * (cos (x) - j * sin (x))
+              x_re[b] += v * cos_vec[b * stride + n];
+              x_im[b] -= v * sin_vec[b * stride + n];
+
+              w2omega[b] += window[n] * mirror[b * stride + n];
+            }
+        }
+
+      for (size_t b = 0; b < n_partials; b++)
+        {
+          const double f = audio_block.freqs[order[start + b]];
+
+          x_re[b] *= 2 / (window_weight + w2omega[b]);
+          x_im[b] *= 2 / (window_weight - w2omega[b]);
 
           // compute final magnitude & phase
-          double magnitude = sqrt (x_re * x_re + x_im * x_im);
-          phase = atan2 (x_im, x_re) + 0.5 * M_PI;
+          double magnitude = sqrt (x_re[b] * x_re[b] + x_im[b] * x_im[b]);
+          double phase = atan2 (x_im[b], x_re[b]) + 0.5 * M_PI;
           phase -= (frame_size - 1) / 2.0 / mix_freq * f * 2 * M_PI;
           phase = normalize_phase (phase);
 
-          // restore partial => sines; keep params.freq & params.mix_freq
-          params.freq = f;
-          params.phase = phase;
-          params.mag = magnitude;
-          params.mode = VectorSinParams::ADD;
-          fast_vector_sinf (params, &sines[0], &sines[frame_size]);
-
           // store refined freq, mag and phase
           good_freqs.push_back (f);
           good_mags.push_back (magnitude);
           good_phases.push_back (phase);
         }
     }
-  while (max_mag > 0);
 
   audio_block.freqs = good_freqs;
   audio_block.mags = good_mags;
@@ -934,16 +1033,13 @@ Encoder::optimize_partials (int optimization_level)
 {
   const double mix_freq = enc_params.mix_freq;
 
-  for (uint64 frame = 0; frame < audio_blocks.size(); frame++)
+  for_each_frame ("_optimize", [&] (uint64 frame, int thread_index)
     {
       if (optimization_level >= 1) // redo FFT estmates, only better
         refine_sine_params_fast (audio_blocks[frame], mix_freq, frame, enc_params.window, enc_params.window_weight);
 
       remove_small_partials (audio_blocks[frame]);
-
-      if (killed ("_optimize"))
-        return;
-    }
+    });
 }
 
 static double
@@ -1090,7 +1186,7 @@ Encoder::approx_noise()
   // sum_w2 is the average influence of the window (w[x]^2), multiplied with frame_size
   const double norm = 0.5 * enc_params.mix_freq * sum_w2;
 
-  for (uint64 frame = 0; frame < audio_blocks.size(); frame++)
+  for_each_frame ("_noise", [&] (uint64 frame, int thread_index)
     {
       vector<double> noise_envelope (Audio::N_NOISE_BANDS);
       vector<double> spectrum (audio_blocks[frame].noise.begin(), audio_blocks[frame].noise.end());
@@ -1133,77 +1229,138 @@ Encoder::approx_noise()
       debug ("noiseenergy:%" PRId64 " %f %f %f\n", frame, spect_energy, b4_energy, r_energy);
       /// } DEBUG_CODE
       audio_blocks[frame].noise.assign (noise_envelope.begin(), noise_envelope.end());
-
-      if (killed ("_noise", frame & 7))
-        return;
-    }
+    });
 }
 
 double
-Encoder::attack_error (const vector< vector<double> >& unscaled_signal, const Attack& attack, vector<double>& out_scale)
+Encoder::attack_error (const AttackSignal& signal, const Attack& attack, vector<double>& out_scale)
 {
-  const size_t frames = unscaled_signal.size();
-  double total_error = 0;
-  vector<double> decoded_signal (enc_params.frame_size + enc_params.frame_step * frames);
-  vector<double> orig_signal (decoded_signal.size());
-
-  const auto& window = enc_params.window;
-
+  const size_t frames       = signal.windowed_frames.size();
+  const size_t frame_size   = enc_params.frame_size;
+  const size_t frame_step   = enc_params.frame_step;
+  const size_t n_values     = signal.orig.size();
+  const double ms_per_value = 1000.0 / enc_params.mix_freq;
+
+  /* first value with time >= ms (envelope is zero before attack start, one after attack end) */
+  auto first_value = [&] (double ms) -> size_t
+    {
+      size_t i = std::clamp (ceil (ms / ms_per_value), 0.0, double (n_values));
+      while (i > 0 && (i - 1) * ms_per_value >= ms)
+        i--;
+      while (i < n_values && i * ms_per_value < ms)
+        i++;
+      return i;
+    };
+  const size_t istart = first_value (attack.attack_start_ms);
+  const size_t iend   = std::max (first_value (attack.attack_end_ms), istart);
+
+  vector<double> decoded (signal.decoded.begin() + istart, signal.decoded.end());
   for (size_t f = 0; f < frames; f++)
     {
-      const vector<double>& frame_signal = unscaled_signal[f];
-      size_t zero_values = 0;
+      const size_t frame_start = f * frame_step;
+      const size_t zero_values = std::clamp (istart, frame_start, frame_start + frame_size) - frame_start;
       double scale = 1.0;
 
-      for (size_t n = 0; n < frame_signal.size(); n++)
+      if (zero_values)
         {
-          const double n_ms = f * enc_params.frame_step_ms + n * 1000.0 / enc_params.mix_freq;
-          double env;
-          if (n_ms < attack.attack_start_ms)
-            {
-              env = 0;
-              zero_values++;
-
-              size_t samples_in_frame = frame_signal.size() - zero_values;
-              if (samples_in_frame < (frame_signal.size() / 8))
-                {
-                  /* if we have very few samples in frame, the partials will
-                   * not be reliable, so in this case we cancel out the frame
-                   */
-                  scale = 0;
-                }
-              else
-                {
-                  /* based on an incomplete frame, we boost the partials
-                   * to obtain an estimate for one whole frame
-                   */
-                  scale = frame_signal.size() / double (samples_in_frame);
-                }
-            }
-          else if (n_ms < attack.attack_end_ms)  // during attack
+          const size_t samples_in_frame = frame_size - zero_values;
+          if (samples_in_frame < (frame_size / 8))
             {
-              const double attack_len_ms = attack.attack_end_ms - attack.attack_start_ms;
-
-              env = (n_ms - attack.attack_start_ms) / attack_len_ms;
+              /* if we have very few samples in frame, the partials will
+               * not be reliable, so in this case we cancel out the frame
+               */
+              scale = 0;
             }
-          else // after attack
+          else
             {
-              env = 1.0;
+              /* based on an incomplete frame, we boost the partials
+               * to obtain an estimate for one whole frame
+               */
+              scale = frame_size / double (samples_in_frame);
             }
-          decoded_signal[f * enc_params.frame_step + n] += frame_signal[n] * scale * env * window[n];
-          orig_signal[f * enc_params.frame_step + n] = audio_blocks[f].debug_samples[n];
+          /* signal.decoded uses scale 1 for all frames: correct values after attack start */
+          const vector<double>& windowed_frame = signal.windowed_frames[f];
+          for (size_t i = istart; i < frame_start + frame_size; i++)
+            decoded[i - istart] += (scale - 1) * windowed_frame[i - frame_start];
         }
       out_scale[f] = scale;
     }
-  for (size_t i = 0; i < decoded_signal.size(); i++)
+
+  /* before attack: decoded signal is zero */
+  double total_error = signal.orig_energy[istart];
+
+  const double attack_len_ms = attack.attack_end_ms - attack.attack_start_ms;
+  for (size_t i = istart; i < iend; i++)  // during attack
     {
-      double error = orig_signal[i] - decoded_signal[i];
-      //printf ("%d %f %f\n", i,orig_signal[i], decoded_signal[i]);
+      const double env = (i * ms_per_value - attack.attack_start_ms) / attack_len_ms;
+      const double error = signal.orig[i] - env * decoded[i - istart];
+      total_error += error * error;
+    }
+  for (size_t i = iend; i < n_values; i++) // after attack
+    {
+      const double error = signal.orig[i] - decoded[i - istart];
       total_error += error * error;
     }
   return total_error;
 }
 
+namespace
+{
+
+/* minimize a function of two parameters using the Nelder-Mead simplex method */
+template<class Func> void
+nelder_mead_2d (Func& func, double& x, double& y, double step, double min_step, int max_iterations)
+{
+  struct Point
+  {
+    double x, y, value;
+  };
+  auto point = [&] (double px, double py) -> Point { return { px, py, func (px, py) }; };
+
+  std::array<Point, 3> p { point (x, y), point (x + step, y), point (x, y + step) };
+  for (int iteration = 0; iteration < max_iterations; iteration++)
+    {
+      std::sort (p.begin(), p.end(), [] (const Point& a, const Point& b) { return a.value < b.value; });
+
+      const double size = max (max (fabs (p[1].x - p[0].x), fabs (p[1].y - p[0].y)),
+                               max (fabs (p[2].x - p[0].x), fabs (p[2].y - p[0].y)));
+      if (size < min_step)
+        break;
+
+      const double cx = (p[0].x + p[1].x) / 2;
+      const double cy = (p[0].y + p[1].y) / 2;
+
+      Point r = point (2 * cx - p[2].x, 2 * cy - p[2].y);
+      if (r.value < p[0].value)
+        {
+          Point e = point (3 * cx - 2 * p[2].x, 3 * cy - 2 * p[2].y);
+          p[2] = e.value < r.value ? e : r;
+        }
+      else if (r.value < p[1].value)
+        {
+          p[2] = r;
+        }
+      else
+        {
+          Point c = r.value < p[2].value ? point ((cx + r.x) / 2, (cy + r.y) / 2) : point ((cx + p[2].x) / 2, (cy + p[2].y) / 2);
+          if (c.value < std::min (r.value, p[2].value))
+            {
+              p[2] = c;
+            }
+          else // shrink towards best point
+            {
+              for (int i = 1; i < 3; i++)
+                p[i] = point ((p[0].x + p[i].x) / 2, (p[0].y + p[i].y) / 2);
+            }
+        }
+    }
+  const Point& best = *std::min_element (p.begin(), p.end(), [] (const Point& a, const Point& b) { return a.value < b.value; });
+  x = best.x;
+  y = best.y;
+}
+
+}
+
 /**
  * This function computes the optimal attack parameters, by finding the optimal
  * attack envelope (attack_start_ms and attack_end_ms) given the data.
@@ -1215,9 +1372,14 @@ Encoder::compute_attack_params()
 
   const double mix_freq   = enc_params.mix_freq;
   const size_t frame_size = enc_params.frame_size;
+  const size_t frame_step = enc_params.frame_step;
   const size_t frames = MIN (20, audio_blocks.size());
+  const auto&  window = enc_params.window;
+
+  AttackSignal signal;
+  signal.orig.resize (frame_size + frame_step * frames);
+  signal.decoded.resize (signal.orig.size());
 
-  vector< vector<double> > unscaled_signal;
   for (size_t f = 0; f < frames; f++)
     {
       const EncoderBlock& audio_block = audio_blocks[f];
@@ -1240,68 +1402,75 @@ Encoder::compute_attack_params()
           if (killed ("__attack", killed_iteration++ & 63))
             return;
         }
-      unscaled_signal.push_back (frame_signal);
-    }
+      for (size_t n = 0; n < frame_size; n++)
+        {
+          frame_signal[n] *= window[n];
 
-  /* make attack envelope deterministically return the same result for the same input every time */
-  Random random;
-  random.set_seed (42);
+          signal.decoded[f * frame_step + n] += frame_signal[n];
+          signal.orig[f * frame_step + n] = audio_block.debug_samples[n];
+        }
+      signal.windowed_frames.push_back (std::move (frame_signal));
+    }
+  signal.orig_energy.resize (signal.orig.size() + 1);
+  for (size_t i = 0; i < signal.orig.size(); i++)
+    signal.orig_energy[i + 1] = signal.orig_energy[i] + signal.orig[i] * signal.orig[i];
 
-  Attack attack;
-  int no_modification = 0;
-  double error = 1e7;
   vector<double> scale (frames);
 
-  double zero_values_at_start_ms = zero_values_at_start / mix_freq * 1000;
-  attack.attack_start_ms = zero_values_at_start_ms;
-  attack.attack_end_ms = zero_values_at_start_ms + 10;
-  while (no_modification < 3000)
+  const double zero_values_at_start_ms = zero_values_at_start / mix_freq * 1000;
+
+  /* error for attack (start, end), constraints:
+   *  - attack_start_ms >= zero_values_at_start_ms
+   *  - attack length at least 5ms to avoid clickiness at start
+   *  - attack_end_ms < 200
+   */
+  auto error_func = [&] (double start_ms, double end_ms)
     {
-      double R;
-      Attack new_attack = attack;
-      if (no_modification < 500)
-        R = 100;
-      else if (no_modification < 1000)
-        R = 20;
-      else if (no_modification < 1500)
-        R = 1;
-      else if (no_modification < 2000)
-        R = 0.2;
-      else if (no_modification < 2500)
-        R = 0.01;
-      else
-        R = 0.002;
+      Attack attack { start_ms, max (end_ms, start_ms + 5) };
 
-      new_attack.attack_start_ms += random.random_double_range (-R, R);
-      new_attack.attack_end_ms += random.random_double_range (-R, R);
+      if (attack.attack_start_ms < zero_values_at_start_ms || attack.attack_end_ms >= 200)
+        return std::numeric_limits<double>::max();
 
-      // constrain attack to at least 5ms to avoid clickiness at start
-      new_attack.attack_end_ms = max (new_attack.attack_end_ms, new_attack.attack_start_ms + 5);
+      return attack_error (signal, attack, scale);
+    };
+
+  /* deterministic search: coarse grid over all valid attack envelopes, refined by Nelder-Mead */
+  Attack attack { zero_values_at_start_ms, zero_values_at_start_ms + 10 };
+  double error = error_func (attack.attack_start_ms, attack.attack_end_ms);
+
+  if (error == std::numeric_limits<double>::max())
+    {
+      /* no valid attack envelope (very long silence at start) */
+      for (size_t f = 0; f < frames; f++)
+        audio_blocks[f].mags.assign (audio_blocks[f].mags.size(), 0);
 
-      if (new_attack.attack_start_ms < new_attack.attack_end_ms &&
-          new_attack.attack_start_ms >= zero_values_at_start_ms &&
-          new_attack.attack_end_ms < 200)
+      optimal_attack = attack;
+      return;
+    }
+
+  const double GRID_MS = 5;
+  for (double start_ms = zero_values_at_start_ms; start_ms < 200; start_ms += GRID_MS)
+    {
+      for (double end_ms = start_ms + 5; end_ms < 200; end_ms += GRID_MS)
         {
-          const double new_error = attack_error (unscaled_signal, new_attack, scale);
-#if 0
-          printf ("attack=<%f, %f> error=%.17g new_attack=<%f, %f> new_arror=%.17g\n", attack.attack_start_ms, attack.attack_end_ms, error,
-                                                                                       new_attack.attack_start_ms, new_attack.attack_end_ms, new_error);
-#endif
+          const double new_error = error_func (start_ms, end_ms);
           if (new_error < error)
             {
               error = new_error;
-              attack = new_attack;
-
-              no_modification = 0;
-            }
-          else
-            {
-              no_modification++;
+              attack = { start_ms, end_ms };
             }
         }
-      if (killed ("_attack", killed_iteration++ & 63))
+      if (killed ("_attack"))
         return;
     }
+  nelder_mead_2d (error_func, attack.attack_start_ms, attack.attack_end_ms, GRID_MS / 2, 0.001, 500);
+  attack.attack_end_ms = max (attack.attack_end_ms, attack.attack_start_ms + 5);
+
+  if (killed ("_attack"))
+    return;
+
+  error_func (attack.attack_start_ms, attack.attack_end_ms); // compute scale for optimal attack
+
   for (size_t f = 0; f < frames; f++)
     {
       for (size_t i = 0; i < audio_blocks[f].mags.size(); i++)
@@ -1421,7 +1590,7 @@ string
 Encoder::version() // changes if encoder algorithm changed (for cache invalidation)
 {
   string version = PACKAGE_VERSION;
-  version += "-2024-03-24";
+  version += "-2026-10-17";
   return version;
 }
 
@@ -1515,8 +1684,10 @@ Encoder::estimate_spectral_envelope()
   const auto zeropad = enc_params.zeropad;
   const double window_scale = 2.0 / enc_params.window_weight;
 
-  for (vector<EncoderBlock>::iterator ai = audio_blocks.begin(); ai != audio_blocks.end(); ai++)
+  for_each_frame ("_envelope", [&] (uint64 frame, int thread_index)
     {
+      EncoderBlock *ai = &audio_blocks[frame];
+
       AudioTool::FundamentalEst f_est;
       for (size_t i = 0; i < ai->freqs.size(); i++)
         f_est.add_partial (ai->freqs[i] / enc_params.fundamental_freq, ai->mags[i]);
@@ -1538,7 +1709,7 @@ Encoder::estimate_spectral_envelope()
         }
       ai->env    = senv;
       ai->env_f0 = fundamental;
-    }
+    });
 }
 
 /**
@@ -61,9 +61,12 @@ public:
   /** sum of all entries of the window */
   double  window_weight = 0;
 
-  /** allow termination during encode() */
+  /** allow termination during encode() (may be called by several analysis threads at the same time) */
   std::function<bool()> kill_function;
 
+  /** number of threads for analysis steps that process frames independently (0: one per cpu core) */
+  int     n_threads = 0;
+
   bool add_config_entry (const std::string& param, const std::string& value);
 
   bool load_config (const std::string& filename);
@@ -125,7 +128,14 @@ class Encoder
     double attack_start_ms;
     double attack_end_ms;
   };
-  double attack_error (const std::vector< std::vector<double> >& unscaled_signal, const Attack& attack, std::vector<double>& out_scale);
+  struct AttackSignal  // precomputed data for attack_error()
+  {
+    std::vector<double> orig;           //!< original signal (overlapping frames)
+    std::vector<double> orig_energy;    //!< orig_energy[i] = energy of orig[0..i)
+    std::vector<double> decoded;        //!< sum of windowed frame signals without attack envelope
+    std::vector< std::vector<double> > windowed_frames;
+  };
+  double attack_error (const AttackSignal& signal, const Attack& attack, std::vector<double>& out_scale);
 
   // single encoder steps:
   void compute_stft (const WavData& wav_data, int channel);
@@ -139,6 +149,9 @@ class Encoder
   void sort_freqs();
   void estimate_spectral_envelope();
 
+  int  frame_threads();
+  void for_each_frame (const char *where, const std::function<void (size_t frame, int thread_index)>& frame_func);
+
   inline bool
   killed (const char *where, uint64_t z = 0)
   {
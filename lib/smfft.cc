@@ -59,8 +59,8 @@ namespace
 
 class FFTGlobal
 {
-  static void
-  cleanup_plans (map<int, fftwf_plan>& plan_map)
+  template<class Key> static void
+  cleanup_plans (map<Key, fftwf_plan>& plan_map)
   {
     if (plan_map.size())
       {
@@ -76,6 +76,7 @@ class FFTGlobal
 
 public:
   map<int, fftwf_plan> fftar_float_plan;
+  map<std::pair<int, int>, fftwf_plan> fftar_many_float_plan;
   map<int, fftwf_plan> fftsr_float_plan;
   map<int, fftwf_plan> fftsr_destructive_float_plan;
   map<int, fftwf_plan> fftac_float_plan;
@@ -90,12 +91,12 @@ public:
   /* Mutex to protect the std::map access */
   std::mutex plan_map_mutex;
 
-  fftwf_plan&
-  read_plan_map_threadsafe (std::map<int, fftwf_plan>& plan_map, size_t N)
+  template<class Key> fftwf_plan&
+  read_plan_map_threadsafe (std::map<Key, fftwf_plan>& plan_map, const typename std::map<Key, fftwf_plan>::key_type& key)
   {
     /* std::map access is not threadsafe */
     std::lock_guard<std::mutex> lg (plan_map_mutex);
-    return plan_map[N];
+    return plan_map[key];
   }
 
 
@@ -120,6 +121,7 @@ public:
   ~FFTGlobal()
   {
     cleanup_plans (fftar_float_plan);
+    cleanup_plans (fftar_many_float_plan);
     cleanup_plans (fftsr_float_plan);
     cleanup_plans (fftsr_destructive_float_plan);
     cleanup_plans (fftac_float_plan);
@@ -152,8 +154,13 @@ plan_flags (FFT::PlanMode plan_mode)
     }
 }
 
-void
-FFT::fftar_float (size_t N, float *in, float *out, PlanMode plan_mode)
+/*
+ * This function is never RT safe, even if the plan was already generated.
+ * Accessing the plan map fftar_float_plan requires using a lock, which is not
+ * RT safe.
+ */
+const FFT::Plan *
+FFT::plan_fftar_float (size_t N, PlanMode plan_mode)
 {
   FFTGlobal *g = FFTGlobal::the();
   fftwf_plan& plan = g->read_plan_map_threadsafe (g->fftar_float_plan, N);
@@ -172,11 +179,76 @@ FFT::fftar_float (size_t N, float *in, float *out, PlanMode plan_mode)
       free_array_float (plan_out);
       free_array_float (plan_in);
     }
-  fftwf_execute_dft_r2c (plan, in, (fftwf_complex *) out);
+  return &plan;
+}
+
+/*
+ * This function is RT safe, as we already have a plan and executing an fftw plan is
+ * RT safe.
+ */
+void
+FFT::execute_fftar_float (size_t N, float *in, float *out, const Plan *plan) noexcept
+{
+  fftwf_execute_dft_r2c (*plan, in, (fftwf_complex *) out);
 
   out[1] = out[N];
 }
 
+void
+FFT::fftar_float (size_t N, float *in, float *out, PlanMode plan_mode)
+{
+  const Plan *plan = plan_fftar_float (N, plan_mode);
+
+  execute_fftar_float (N, in, out, plan);
+}
+
+/*
+ * Distance between two transforms for batched FFTs: N + 2 values for r2c output,
+ * rounded up so that every transform has the same (64 byte) alignment.
+ */
+size_t
+FFT::fftar_many_stride (size_t N)
+{
+  return (N + 2 + 15) & ~size_t (15);
+}
+
+const FFT::Plan *
+FFT::plan_fftar_many_float (size_t N, size_t howmany, PlanMode plan_mode)
+{
+  FFTGlobal *g = FFTGlobal::the();
+  fftwf_plan& plan = g->read_plan_map_threadsafe (g->fftar_many_float_plan, std::make_pair (int (N), int (howmany)));
+
+  if (!plan)
+    {
+      std::lock_guard<std::mutex> lg (g->fftw_plan_mutex);
+      const int n = N;
+      const int stride = fftar_many_stride (N);
+      float *plan_in = new_array_float (stride * howmany);
+      float *plan_out = new_array_float (stride * howmany);
+      plan = fftwf_plan_many_dft_r2c (1, &n, howmany, plan_in, nullptr, 1, stride,
+                                      (fftwf_complex *) plan_out, nullptr, 1, stride / 2, plan_flags (plan_mode));
+      if (!plan) /* missing from wisdom -> create plan and save it */
+        {
+          plan = fftwf_plan_many_dft_r2c (1, &n, howmany, plan_in, nullptr, 1, stride,
+                                          (fftwf_complex *) plan_out, nullptr, 1, stride / 2, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
+          save_wisdom();
+        }
+      free_array_float (plan_out);
+      free_array_float (plan_in);
+    }
+  return &plan;
+}
+
+void
+FFT::execute_fftar_many_float (size_t N, size_t howmany, float *in, float *out, const Plan *plan) noexcept
+{
+  fftwf_execute_dft_r2c (*plan, in, (fftwf_complex *) out);
+
+  const size_t stride = fftar_many_stride (N);
+  for (size_t i = 0; i < howmany; i++)
+    out[i * stride + 1] = out[i * stride + N];
+}
+
 void
 FFT::fftsr_float (size_t N, float *in, float *out, PlanMode plan_mode)
 {
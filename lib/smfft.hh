@@ -26,6 +26,17 @@ void   fftsr_destructive_float (size_t N, float *in, float *out, PlanMode plan_m
 void   fftac_float (size_t N, float *in, float *out, PlanMode plan_mode = PLAN_PATIENT);
 void   fftsc_float (size_t N, float *in, float *out, PlanMode plan_mode = PLAN_PATIENT);
 
+const Plan *plan_fftar_float (size_t N, PlanMode plan_mode = PLAN_PATIENT);
+void execute_fftar_float (size_t N, float *in, float *out, const Plan *plan) noexcept SM_CLANG_NONBLOCKING;
+
+/* batched fftar_float: howmany transforms of size N, in/out arrays must be allocated
+ * with new_array_float (fftar_many_stride (N) * howmany), transform i uses the data at
+ * in + i * fftar_many_stride (N) and out + i * fftar_many_stride (N)
+ */
+size_t fftar_many_stride (size_t N);
+const Plan *plan_fftar_many_float (size_t N, size_t howmany, PlanMode plan_mode = PLAN_PATIENT);
+void execute_fftar_many_float (size_t N, size_t howmany, float *in, float *out, const Plan *plan) noexcept SM_CLANG_NONBLOCKING;
+
 const Plan *plan_fftsr_destructive_float (size_t N, PlanMode plan_mode = PLAN_PATIENT);
 void execute_fftsr_destructive_float (size_t N, float *in, float *out, const Plan *plan) noexcept SM_CLANG_NONBLOCKING;
 
@@ -82,7 +82,7 @@ FormantCorrection::process_block (const AudioBlock& in_block, RTAudioBlock& out_
 {
   if (mode == MODE_REPITCH)
     {
-      out_block.assign (in_block);
+      out_block.borrow (in_block);
       return;
     }
   auto emag = [&] (int i) {
@@ -122,7 +122,7 @@ FormantCorrection::process_block (const AudioBlock& in_block, RTAudioBlock& out_
     sm_factor2idbs (mags, mags_count, imags);
     out_block.mags.assign (imags, imags + mags_count);
   };
-  out_block.noise.assign (in_block.noise);
+  out_block.noise.borrow (in_block.noise);
   if (mode == MODE_PRESERVE_SPECTRAL_ENVELOPE)
     {
       out_block.freqs.set_capacity (in_block.freqs.size());
@@ -79,6 +79,8 @@ IFFTSynth::IFFTSynth (size_t block_size, double mix_freq, WindowType win_type) :
             {
               int pos = i * 256 - freq_frac;
               table->win_trans.push_back (wspectrum[abs (pos * 2)]);
+              table->win_trans_dup.push_back (wspectrum[abs (pos * 2)]);
+              table->win_trans_dup.push_back (wspectrum[abs (pos * 2)]);
             }
         }
       FFT::free_array_float (win);
@@ -118,6 +120,84 @@ IFFTSynth::~IFFTSynth()
   FFT::free_array_float (fft_out);
 }
 
+/*
+ * render a batch of partials (same result as calling render_partial() for each partial)
+ *
+ * the result is bit-identical, unless the compiler fuses multiply and add in render_partial()
+ * (for instance on ARM or with -mfma), in which case the results differ slightly due to rounding
+ *
+ * the per partial setup (frequency quantization, phase rotation via sin_table) is
+ * done for a number of partials at once in simple loops which the compiler can
+ * vectorize, and the spectrum update uses SSE (or NEON) instructions
+ */
+void
+IFFTSynth::render_partials (size_t n_partials, const float *freqs, const float *mags, const uint *phases)
+{
+  const int range = 4;
+  const size_t BATCH_SIZE = 64;
+
+  int   freq256[BATCH_SIZE];
+  uint  iarg[BATCH_SIZE];
+  float phase_rsmag[BATCH_SIZE];
+  float phase_rcmag[BATCH_SIZE];
+
+  for (size_t start = 0; start < n_partials; start += BATCH_SIZE)
+    {
+      const size_t n = std::min (n_partials - start, BATCH_SIZE);
+
+      for (size_t i = 0; i < n; i++)
+        freq256[i] = sm_round_positive (freqs[start + i] * freq256_factor);
+
+      /* sincos (phase + phase_adjust), see render_partial() */
+      static constexpr uint div = (1LL << 32) / SIN_TABLE_SIZE;
+      for (size_t i = 0; i < n; i++)
+        iarg[i] = (phases[start + i] + div / 2) / div + freq256[i] * SIN_TABLE_SIZE / 512 + (SIN_TABLE_SIZE - SIN_TABLE_SIZE / 4);
+
+      for (size_t i = 0; i < n; i++)
+        {
+          const float nmag = mags[start + i] * mag_norm;
+
+          phase_rsmag[i] = sin_table[iarg[i] & SIN_TABLE_MASK] * nmag;
+          phase_rcmag[i] = sin_table[(iarg[i] + SIN_TABLE_SIZE / 4) & SIN_TABLE_MASK] * nmag;
+        }
+
+      for (size_t i = 0; i < n; i++)
+        {
+          const int ibin = freq256[i] >> 8;
+
+          if (ibin > range && 2 * (ibin + range) < static_cast<int> (block_size))
+            {
+              float *sp = fft_in + 2 * (ibin - range);
+#if defined(__SSE__) || defined(SM_ARM_SSE)
+              const float *wmag_p = &table->win_trans_dup[(freq256[i] & 0xff) * (range * 2 + 1) * 2];
+              const __m128 rcs = _mm_set_ps (phase_rsmag[i], phase_rcmag[i], phase_rsmag[i], phase_rcmag[i]);
+
+              /* 4 complex values per SSE instruction: 8 bins, last bin is done without SSE */
+              for (int k = 0; k < 16; k += 4)
+                _mm_storeu_ps (sp + k, _mm_add_ps (_mm_loadu_ps (sp + k), _mm_mul_ps (rcs, _mm_loadu_ps (wmag_p + k))));
+
+              sp[16] += phase_rcmag[i] * wmag_p[16];
+              sp[17] += phase_rsmag[i] * wmag_p[17];
+#else
+              const float *wmag_p = &table->win_trans[(freq256[i] & 0xff) * (range * 2 + 1)];
+
+              for (int k = 0; k <= 2 * range; k++)
+                {
+                  const float wmag = wmag_p[k];
+                  *sp++ += phase_rcmag[i] * wmag;
+                  *sp++ += phase_rsmag[i] * wmag;
+                }
+#endif
+            }
+          else
+            {
+              /* corner cases are rare, so we use the (slower) code from render_partial() */
+              render_partial (freqs[start + i], mags[start + i], phases[start + i]);
+            }
+        }
+    }
+}
+
 void
 IFFTSynth::get_samples (float      *samples,
                         OutputMode  output_mode)
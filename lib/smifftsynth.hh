@@ -67,6 +67,7 @@ public:
   }
 
   inline void render_partial (float freq, float mag, uint phase);
+  void render_partials (size_t n_partials, const float *freqs, const float *mags, const uint *phases);
   void get_samples (float *samples, OutputMode output_mode = REPLACE);
   void precompute_tables();
 
@@ -76,6 +77,7 @@ public:
 struct IFFTSynthTable
 {
   std::vector<float> win_trans;
+  std::vector<float> win_trans_dup; // win_trans with each value stored twice (for re/im SIMD updates)
 
   float             *win_scale = nullptr;
 
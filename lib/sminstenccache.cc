@@ -172,7 +172,7 @@ mk_version (const string& wav_data_hash, int midi_note, int iclipstart, int icli
 
 Audio *
 InstEncCache::encode (Group *group, const WavData& wav_data, const string& wav_data_hash, int midi_note, int iclipstart, int iclipend, Instrument::EncoderConfig& cfg,
-                      const std::function<bool()>& kill_function)
+                      const std::function<bool()>& kill_function, int n_threads)
 {
   // if group is not specified we create a random group just for this one request
   std::unique_ptr<Group> random_group;
@@ -204,7 +204,7 @@ InstEncCache::encode (Group *group, const WavData& wav_data, const string& wav_d
   WavData wav_data_clipped (clipped_samples, 1, wav_data.mix_freq(), wav_data.bit_depth());
 
   InstEncoder enc;
-  audio = enc.encode (wav_data_clipped, midi_note, cfg, kill_function);
+  audio = enc.encode (wav_data_clipped, midi_note, cfg, kill_function, n_threads);
   if (!audio)
     return nullptr;
 
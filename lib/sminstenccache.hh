@@ -47,7 +47,7 @@ public:
 
   Audio      *encode (Group *group, const WavData& wav_data, const std::string& wav_data_hash,
                       int midi_note, int iclipstart, int iclipend, Instrument::EncoderConfig& cfg,
-                      const std::function<bool()>& kill_function);
+                      const std::function<bool()>& kill_function, int n_threads = 0);
   void        clear();
   Group      *create_group();
 
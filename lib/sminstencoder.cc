@@ -15,7 +15,7 @@ freq_from_note (float note)
 }
 
 Audio *
-InstEncoder::encode (const WavData& wav_data, int midi_note, Instrument::EncoderConfig& cfg, const std::function<bool()>& kill_function)
+InstEncoder::encode (const WavData& wav_data, int midi_note, Instrument::EncoderConfig& cfg, const std::function<bool()>& kill_function, int n_threads)
 {
   if (cfg.enabled)
     {
@@ -30,6 +30,7 @@ InstEncoder::encode (const WavData& wav_data, int midi_note, Instrument::Encoder
   enc_params.setup_params (wav_data, freq_from_note (midi_note));
   enc_params.enable_phases = false; // save some space
   enc_params.set_kill_function (kill_function);
+  enc_params.n_threads = n_threads;
 
   Encoder encoder (enc_params);
 
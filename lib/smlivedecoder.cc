@@ -1,14 +1,18 @@
 // Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
 
 #include "smlivedecoder.hh"
+#include "smspectralmixer.hh"
 #include "smlivedecoderfilter.hh"
+#include "smmorphoutputmodule.hh"
 #include "smmath.hh"
 #include "smutils.hh"
 #include "smrtmemory.hh"
 #include "smfft.hh"
 #include "smblockutils.hh"
 #include "smmain.hh"
+#include "smdspprofile.hh"
 
+#include <algorithm>
 #include <stdio.h>
 #include <assert.h>
 
@@ -53,6 +57,7 @@ LiveDecoder::LiveDecoder (float mix_freq) :
   audio (NULL),
   block_size (NoiseDecoder::preferred_block_size (mix_freq)),
   ifft_synth (block_size, mix_freq, IFFTSynth::WIN_HANN),
+  osc_bank (block_size, mix_freq),
   noise_decoder (mix_freq, block_size),
   source (NULL),
   sines_enabled (true),
@@ -65,7 +70,10 @@ LiveDecoder::LiveDecoder (float mix_freq) :
   random_seed (-1),
   sine_samples (block_size * 3 / 2),
   noise_samples (block_size),
-  vibrato_enabled (false)
+  vibrato_enabled (false),
+  mixed_spectrum (block_size * 2),
+  merged_noise_spectrum (block_size * 2),
+  loop_cache_table (block_size * 4)
 {
   set_unison_voices (1, 0);
 
@@ -75,6 +83,17 @@ LiveDecoder::LiveDecoder (float mix_freq) :
   unison_phases[0].reserve (PARTIAL_STATE_RESERVE * MAX_UNISON_VOICES);
   unison_phases[1].reserve (PARTIAL_STATE_RESERVE * MAX_UNISON_VOICES);
   unison_freq_factor.reserve (MAX_UNISON_VOICES);
+  render_freqs.reserve (PARTIAL_STATE_RESERVE * MAX_UNISON_VOICES);
+  render_mags.reserve (PARTIAL_STATE_RESERVE * MAX_UNISON_VOICES);
+  render_phases.reserve (PARTIAL_STATE_RESERVE * MAX_UNISON_VOICES);
+  loop_cache_phases.reserve (PARTIAL_STATE_RESERVE);
+  loop_cache_cycles.reserve (PARTIAL_STATE_RESERVE);
+  loop_cache_mags.reserve (PARTIAL_STATE_RESERVE);
+  partial_keep.reserve (PARTIAL_STATE_RESERVE);
+  partial_cull_mags.reserve (PARTIAL_STATE_RESERVE);
+
+  for (size_t i = 0; i < block_size; i++)
+    loop_cache_window.push_back (window_cos (2.0 * i / block_size - 1.0));
 
   fft_plan = FFT::plan_fftsr_destructive_float (block_size); // not RT-safe due to locking
   aa_filter_table = AAFilterTable::the();
@@ -131,6 +150,9 @@ LiveDecoder::retrigger (int channel, float freq, int midi_velocity)
     }
   audio = best_audio;
 
+  /* blocks of the previous note are no longer related to this voice */
+  mixed_lane[0] = mixed_lane[1] = nullptr;
+
   if (best_audio)
     {
       frame_step = audio->frame_step_ms * mix_freq / 1000;
@@ -173,6 +195,11 @@ LiveDecoder::retrigger (int channel, float freq, int midi_velocity)
       unison_phases[0].clear();
       unison_phases[1].clear();
 
+      last_block_mixed = false;
+      noise_merged = false;
+      merged_noise[0] = merged_noise[1] = false;
+      reset_loop_cache();
+
       // setup vibrato state
       vibrato_phase = 0;
       vibrato_env = 0;
@@ -181,6 +208,30 @@ LiveDecoder::retrigger (int channel, float freq, int midi_velocity)
   current_freq = freq;
 }
 
+/* if set, blocks can be synthesized by the spectral mixer instead of our own IFFTs,
+ * gain is applied to these blocks only
+ *
+ * blocks that were already mixed still play with the old gain, so if the gain changes
+ * (for instance because the envelope is released), these are moved back to our own
+ * output, which means the new gain applies exactly from the current sample on
+ */
+void
+LiveDecoder::set_spectral_mixer (SpectralMixer *mixer, float gain)
+{
+  if (mixer != spectral_mixer || gain != spectral_mixer_gain)
+    unmix();
+
+  spectral_mixer = mixer;
+  spectral_mixer_gain = gain;
+}
+
+/* if set, only up to max_partials partials (including unison voices) are rendered per block */
+void
+LiveDecoder::set_partial_budget (size_t max_partials)
+{
+  partial_budget = max_partials;
+}
+
 void
 LiveDecoder::set_source (LiveDecoderSource *source)
 {
@@ -229,9 +280,297 @@ LiveDecoder::compute_loop_frame_index (size_t frame_idx, Audio *audio)
   return frame_idx;
 }
 
+IFFTSynth *
+LiveDecoder::spectral_mixer_ifft_synth (size_t offset, float portamento_stretch)
+{
+  /* the next block can only be synthesized by the spectral mixer if
+   *  - sine and noise blocks are aligned, and we're at an integer sample position
+   *  - the output is not changed by filter, vibrato, portamento or attack envelope
+   */
+  if (!spectral_mixer || spectral_mixer->block_size() != block_size || filter || vibrato_enabled)
+    return nullptr;
+
+  if (pos != block_size / 2 || noise_index != block_size / 2 || portamento_stretch != old_portamento_stretch)
+    return nullptr;
+
+  if (env_pos < zero_values_at_start_scaled || env_pos * 1000.0 / mix_freq < audio->attack_end_ms)
+    return nullptr;
+
+  if (done_state != DoneState::ACTIVE || offset >= spectral_mixer->max_n_values())
+    return nullptr;
+
+  return spectral_mixer->ifft_synth (offset);
+}
+
+/* true if the sines of the last block were played from the loop cache */
+bool
+LiveDecoder::loop_cache_active() const
+{
+  return loop_cache_state == LoopCacheState::ACTIVE;
+}
+
+void
+LiveDecoder::reset_loop_cache()
+{
+  loop_cache_state = LoopCacheState::OFF;
+  loop_cache_stationary_blocks = 0;
+}
+
+/* returns true if the loop cache should be used for the sines of the current block */
+bool
+LiveDecoder::update_loop_cache (vector<PartialState>& new_pstate, const vector<PartialState>& old_pstate, float portamento_stretch)
+{
+  /* check if partials didn't change since the last block */
+  bool stationary = loop_cache_enabled && unison_voices == 1 && !mixer_ifft_synth && !new_pstate.empty() &&
+                    new_pstate.size() == old_pstate.size() && portamento_stretch == old_portamento_stretch;
+
+  for (size_t p = 0; stationary && p < new_pstate.size(); p++)
+    stationary = (new_pstate[p].freq == old_pstate[p].freq && new_pstate[p].mag == old_pstate[p].mag);
+
+  if (!stationary)
+    {
+      reset_loop_cache();
+      return false;
+    }
+  if (loop_cache_state == LoopCacheState::OFF)
+    {
+      loop_cache_stationary_blocks++;
+      if (loop_cache_stationary_blocks < LOOP_CACHE_MIN_BLOCKS)
+        return false;
+
+      /* we only try once: as long as the partials don't change, the result would be the same */
+      if (!prepare_loop_cache (new_pstate, portamento_stretch))
+        {
+          loop_cache_state = LoopCacheState::FAILED;
+          return false;
+        }
+      loop_cache_state = LoopCacheState::BUILDING;
+    }
+  if (loop_cache_state == LoopCacheState::BUILDING)
+    {
+      if (!build_loop_cache (new_pstate))
+        return false;
+
+      loop_cache_state = LoopCacheState::ACTIVE;
+      loop_cache_pos = 0;
+    }
+  return loop_cache_state == LoopCacheState::ACTIVE;
+}
+
+/* check if partials can be played from a periodic table and setup table length, cycles and phases */
+bool
+LiveDecoder::prepare_loop_cache (const vector<PartialState>& partials, float portamento_stretch)
+{
+  float max_mag = 0;
+  for (const auto& ps : partials)
+    max_mag = max (max_mag, ps.mag);
+
+  /* the fundamental of the sample may differ from the note frequency, so we estimate it
+   * from the loud partials (least squares fit, weighted by magnitude)
+   */
+  double f0 = current_freq * portamento_stretch;
+  double fit_num = 0, fit_den = 0;
+  for (const auto& ps : partials)
+    {
+      const double freq = ps.freq * portamento_stretch;
+      const int    harmonic = sm_round_positive (freq / f0);
+
+      if (harmonic >= 1 && ps.mag > max_mag * LOOP_CACHE_QUIET_MAG)
+        {
+          fit_num += ps.mag * freq * harmonic;
+          fit_den += ps.mag * harmonic * harmonic;
+        }
+    }
+  if (fit_den > 0)
+    f0 = fit_num / fit_den;
+
+  /* the table contains an integer number of periods of the fundamental, and is at least two blocks
+   * long, so the error we get from rounding the table length is small
+   */
+  const double period = mix_freq / f0;
+  const int    n_periods = max (1, int (ceil (2 * block_size / period)));
+  const size_t len = sm_round_positive (n_periods * period);
+
+  if (len < 1 || len > loop_cache_table.size())
+    return false;
+
+  /* building the table is spread over several blocks, we use the phases the partials will
+   * have when the table is complete, so there is no phase jump when switching to the table
+   */
+  /* with a partial budget, culled partials are not rendered into the table; playing the table
+   * costs the same for any number of partials, so later budget changes don't affect the table
+   */
+  loop_cache_culled = 0;
+  if (partial_budget)
+    loop_cache_culled = cull_partials (partials, partial_budget);
+
+  const size_t build_step = max<size_t> (1, LOOP_CACHE_BUILD_LOAD * block_size / len);
+  const size_t build_blocks = (partials.size() + build_step - 1) / build_step;
+  const float  phase_factor = block_size * M_PI / mix_freq * ifft_synth.phase_to_uint_factor();
+
+  /* each partial is played at the closest frequency that is periodic within the table; this
+   * is exact for harmonic partials, loud inharmonic partials can't be played from the table
+   */
+  loop_cache_cycles.clear();
+  loop_cache_phases.clear();
+  loop_cache_mags.clear();
+  for (size_t p = 0; p < partials.size(); p++)
+    {
+      const auto&  ps = partials[p];
+      const double freq = ps.freq * portamento_stretch;
+      const int    cycles = sm_round_positive (freq * len / mix_freq);
+      const double table_freq = cycles * mix_freq / len;
+      const float  mag = (partial_budget && !partial_keep[p]) ? 0 : ps.mag;
+
+      if (cycles < 1)
+        return false;
+
+      if (mag > max_mag * LOOP_CACHE_QUIET_MAG && max (freq / table_freq, table_freq / freq) > LOOP_CACHE_MAX_DETUNE)
+        return false;
+
+      const int64_t phase_inc = ifft_synth.quantized_freq (ps.freq * portamento_stretch) * phase_factor;
+
+      loop_cache_cycles.push_back (cycles);
+      loop_cache_phases.push_back (ps.phase + uint (phase_inc * int64_t (build_blocks - 1)));
+      loop_cache_mags.push_back (mag);
+    }
+  zero_float_block (len, &loop_cache_table[0]);
+
+  loop_cache_len = len;
+  loop_cache_build_partial = 0;
+  loop_cache_build_step = build_step;
+  return true;
+}
+
+/* add the next partials to the table, returns true if the table is complete */
+bool
+LiveDecoder::build_loop_cache (const vector<PartialState>& partials)
+{
+  const size_t end = min (partials.size(), loop_cache_build_partial + loop_cache_build_step);
+
+  for (size_t p = loop_cache_build_partial; p < end; p++)
+    {
+      if (loop_cache_mags[p] > 0)
+        {
+          VectorSinParams params;
+
+          params.mix_freq = mix_freq;
+          params.freq     = loop_cache_cycles[p] * mix_freq / loop_cache_len;
+          params.phase    = loop_cache_phases[p] / ifft_synth.phase_to_uint_factor();
+          params.mag      = loop_cache_mags[p];
+          params.mode     = VectorSinParams::ADD;
+
+          fast_vector_sinf (params, &loop_cache_table[0], &loop_cache_table[loop_cache_len]);
+        }
+    }
+  loop_cache_build_partial = end;
+  return end == partials.size();
+}
+
+/* add (hann windowed) block from the loop cache table, so the result is equivalent to IFFT synthesis */
+void
+LiveDecoder::render_loop_cache (vector<PartialState>& partials)
+{
+  float *out = &sine_samples[block_size / 2];
+
+  size_t i = 0, table_pos = loop_cache_pos;
+  while (i < block_size)
+    {
+      const size_t todo = min (block_size - i, loop_cache_len - table_pos);
+      for (size_t j = 0; j < todo; j++)
+        out[i + j] += loop_cache_window[i + j] * loop_cache_table[table_pos + j];
+
+      i += todo;
+      table_pos = (table_pos + todo) % loop_cache_len;
+    }
+
+  /* keep partial phases in sync with the table, for switching back to IFFT synthesis */
+  for (size_t p = 0; p < partials.size(); p++)
+    {
+      const uint64 cycle_pos = (uint64 (loop_cache_cycles[p]) * loop_cache_pos) % loop_cache_len;
+
+      partials[p].phase = loop_cache_phases[p] + uint ((cycle_pos << 32) / loop_cache_len);
+    }
+  loop_cache_pos = (loop_cache_pos + block_size / 2) % loop_cache_len;
+}
+
+/*
+ * decide which partials to render (partial_keep) and return the number of partials that should
+ * not be rendered; partials are removed if
+ *  - they are below an absolute threshold relative to the loudest partial of the block
+ *  - they are masked by a much louder neighbour partial within the same critical band
+ *  - if more than max_partials partials remain, the quietest partials are removed
+ */
+size_t
+LiveDecoder::cull_partials (const vector<PartialState>& partials, size_t max_partials)
+{
+  const float abs_threshold_factor = 3.1623e-5;  // -90 dB
+  const float masking_factor = 0.01;             // -40 dB
+
+  float peak = 0;
+  for (const auto& ps : partials)
+    peak = max (peak, ps.mag);
+
+  /* partials are sorted by frequency, so we only need to check the direct neighbours for masking */
+  auto masked_by = [&] (const PartialState& ps, const PartialState& neighbour)
+    {
+      const float critical_band = max (100.f, 0.2f * ps.freq);
+      return ps.mag < neighbour.mag * masking_factor && std::abs (ps.freq - neighbour.freq) < critical_band;
+    };
+
+  partial_keep.clear();
+  partial_cull_mags.clear();
+  for (size_t p = 0; p < partials.size(); p++)
+    {
+      bool keep = partials[p].mag > peak * abs_threshold_factor;
+
+      if (keep && p > 0 && masked_by (partials[p], partials[p - 1]))
+        keep = false;
+      if (keep && p + 1 < partials.size() && masked_by (partials[p], partials[p + 1]))
+        keep = false;
+
+      partial_keep.push_back (keep);
+      if (keep)
+        partial_cull_mags.push_back (partials[p].mag);
+    }
+
+  if (partial_cull_mags.size() > max_partials)
+    {
+      /* find magnitude of the quietest partial we can keep */
+      std::nth_element (partial_cull_mags.begin(), partial_cull_mags.begin() + max_partials - 1, partial_cull_mags.end(), std::greater<float>());
+      const float min_mag = partial_cull_mags[max_partials - 1];
+
+      size_t n_greater = 0;
+      for (size_t p = 0; p < partials.size(); p++)
+        if (partial_keep[p] && partials[p].mag > min_mag)
+          n_greater++;
+
+      /* keep all partials louder than min_mag, and as many partials with min_mag as possible */
+      size_t n_equal = max_partials - n_greater;
+      for (size_t p = 0; p < partials.size(); p++)
+        {
+          if (partial_keep[p] && partials[p].mag <= min_mag)
+            {
+              if (partials[p].mag == min_mag && n_equal > 0)
+                n_equal--;
+              else
+                partial_keep[p] = false;
+            }
+        }
+    }
+
+  size_t n_culled = 0;
+  for (auto keep : partial_keep)
+    if (!keep)
+      n_culled++;
+  return n_culled;
+}
+
 void
-LiveDecoder::gen_sines (float freq_in)
+LiveDecoder::gen_sines (float freq_in, size_t offset)
 {
+  DspProfile::Scope profile_scope (DspProfile::SINES);
+
   if (get_loop_type() == Audio::LOOP_TIME_FORWARD)
     {
       size_t xenv_pos = env_pos;
@@ -258,12 +597,15 @@ LiveDecoder::gen_sines (float freq_in)
   bool         have_audio_block = false;
   if (source)
     {
+      if (output_module)
+        output_module->update_control_values();
+
       source->set_portamento_freq (freq_in);
       have_audio_block = source->rt_audio_block (frame_idx, audio_block);
     }
   else if (frame_idx < audio->contents.size())
     {
-      audio_block.assign (audio->contents[frame_idx]);
+      audio_block.borrow (audio->contents[frame_idx]);
       have_audio_block = true;
     }
   if (have_audio_block)
@@ -271,6 +613,26 @@ LiveDecoder::gen_sines (float freq_in)
       float portamento_stretch = freq_in / current_freq;
       assert (audio_block.freqs.size() == audio_block.mags.size());
 
+      /* the sine signal will be resampled (or rendered again), so it must not contain noise */
+      if (portamento_stretch != old_portamento_stretch)
+        unmerge_noise();
+
+      mixer_ifft_synth = spectral_mixer_ifft_synth (offset, portamento_stretch);
+      if (mixer_ifft_synth)
+        zero_float_block (block_size, &mixed_spectrum[(merged_noise_last ^ 1) * block_size]);
+
+      /* silent noise is not synthesized at all, very quiet noise with less detail */
+      const NoiseDecoder::Detail block_noise_detail = NoiseDecoder::envelope_detail (audio_block.noise.data());
+
+      /* sines and noise can share one IFFT if the sine and noise blocks are aligned (see below); the
+       * sine signal is resampled during pitch bend / portamento / vibrato, but noise always plays at
+       * a fixed rate, so this is only possible if the frequency is constant
+       */
+      const bool can_merge_noise = noise_enabled && done_state == DoneState::ACTIVE && !vibrato_enabled &&
+                                   freq_in_constant && portamento_stretch == old_portamento_stretch &&
+                                   pos == block_size / 2 && noise_index == block_size / 2 &&
+                                   block_noise_detail != NoiseDecoder::Detail::SILENT;
+
       // point n_pstate to pstate[0] and pstate[1] alternately (one holds points to last state and the other points to new state)
       bool lps_zero = (last_pstate == &pstate[0]);
       vector<PartialState>& new_pstate = lps_zero ? pstate[1] : pstate[0];
@@ -404,9 +766,12 @@ LiveDecoder::gen_sines (float freq_in)
 
           /* check if there is a relevant difference between old portamento stretch and new portamento stretch
            * if not we can use the old synthesis results and overlap/add with the new output (which is faster)
+           *
+           * if the last block was synthesized by the spectral mixer, we can't change it anymore
            */
           const float delta = 1 / 2000.;
-          if (std::abs (old_portamento_stretch / portamento_stretch - 1) > delta)
+          const bool rerender = std::abs (old_portamento_stretch / portamento_stretch - 1) > delta && !last_block_mixed;
+          if (rerender)
             {
               ifft_synth.clear_partials();
 
@@ -446,27 +811,95 @@ LiveDecoder::gen_sines (float freq_in)
             }
           zero_float_block (block_size / 2, &sine_samples[block_size]);
 
-          ifft_synth.clear_partials();
+          n_culled_partials = 0;
 
-          if (unison_voices == 1)
+          /* stationary harmonic signals (like single frame loops) can be played from the loop cache */
+          if (update_loop_cache (new_pstate, old_pstate, portamento_stretch))
             {
-              for (auto ps : new_pstate)
-                ifft_synth.render_partial (ps.freq * portamento_stretch, ps.mag, ps.phase);
+              render_loop_cache (new_pstate);
+              n_culled_partials = loop_cache_culled;
             }
           else
             {
-              for (size_t p = 0; p < new_pstate.size(); p++)
+              /* with a partial budget, we don't render partials that are inaudible or exceed the budget */
+              if (partial_budget)
+                n_culled_partials = cull_partials (new_pstate, max<size_t> (partial_budget / unison_voices, 1));
+
+              render_freqs.clear();
+              render_mags.clear();
+              render_phases.clear();
+              if (unison_voices == 1)
                 {
-                  for (int i = 0; i < unison_voices; i++)
+                  for (size_t p = 0; p < new_pstate.size(); p++)
                     {
-                      ifft_synth.render_partial (new_pstate[p].freq * unison_freq_factor[i] * portamento_stretch,
-                                                 new_pstate[p].mag,
-                                                 unison_new_phases[p * unison_voices + i]);
+                      if (partial_budget && !partial_keep[p])
+                        continue;
+
+                      render_freqs.push_back (new_pstate[p].freq * portamento_stretch);
+                      render_mags.push_back (new_pstate[p].mag);
+                      render_phases.push_back (new_pstate[p].phase);
                     }
                 }
-            }
+              else
+                {
+                  for (size_t p = 0; p < new_pstate.size(); p++)
+                    {
+                      if (partial_budget && !partial_keep[p])
+                        continue;
 
-          ifft_synth.get_samples (&sine_samples[block_size / 2], IFFTSynth::ADD);
+                      for (int i = 0; i < unison_voices; i++)
+                        {
+                          render_freqs.push_back (new_pstate[p].freq * unison_freq_factor[i] * portamento_stretch);
+                          render_mags.push_back (new_pstate[p].mag);
+                          render_phases.push_back (unison_new_phases[p * unison_voices + i]);
+                        }
+                    }
+                }
+
+              /* if no re-rendering was necessary, we add the noise spectrum to the sine spectrum, so we only
+               * need one IFFT for both (BH92 window is converted to hann window by IFFTSynth)
+               */
+              const bool merge_noise = can_merge_noise && !rerender;
+
+              /* for sparse frames, the time domain oscillator bank is cheaper than the IFFT; since both
+               * produce the same hann windowed block, overlap-add crossfades between them when switching
+               */
+              const bool use_osc_bank = osc_bank_enabled && !mixer_ifft_synth && !merge_noise &&
+                                        OscBank::cheaper_than_ifft (render_freqs.size(), block_size);
+              if (mixer_ifft_synth)
+                {
+                  /* keep the spectrum of the block, it is added to the spectrum of the spectral mixer by gen_noise() */
+                  ifft_synth.clear_partials();
+                  ifft_synth.render_partials (render_freqs.size(), render_freqs.data(), render_mags.data(), render_phases.data());
+                  Block::add (block_size, &mixed_spectrum[(merged_noise_last ^ 1) * block_size], ifft_synth.fft_input());
+                }
+              else if (use_osc_bank)
+                {
+                  /* use the same frequencies as IFFTSynth, so phases continue correctly for the next block */
+                  for (auto& freq : render_freqs)
+                    freq = ifft_synth.quantized_freq (freq);
+
+                  osc_bank.render_partials (render_freqs.size(), render_freqs.data(), render_mags.data(), render_phases.data(), &sine_samples[block_size / 2]);
+                }
+              else
+                {
+                  ifft_synth.clear_partials();
+                  ifft_synth.render_partials (render_freqs.size(), render_freqs.data(), render_mags.data(), render_phases.data());
+
+                  noise_merged = merge_noise;
+                  if (noise_merged)
+                    {
+                      /* keep the noise spectrum, in case we need to separate noise and sines later (see unmerge_noise) */
+                      float *noise_spectrum = &merged_noise_spectrum[(merged_noise_last ^ 1) * block_size];
+
+                      zero_float_block (block_size, noise_spectrum);
+                      noise_decoder.process (audio_block.noise.data(), noise_spectrum, NoiseDecoder::ADD_SPECTRUM_BH92, 1, 1, block_noise_detail);
+                      Block::add (block_size, ifft_synth.fft_input(), noise_spectrum);
+                    }
+
+                  ifft_synth.get_samples (&sine_samples[block_size / 2], IFFTSynth::ADD);
+                }
+            }
         }
       else
         {
@@ -476,6 +909,11 @@ LiveDecoder::gen_sines (float freq_in)
           zero_float_block (block_size / 2, &sine_samples[block_size]);
         }
       last_pstate = &new_pstate;
+      last_block_mixed = (mixer_ifft_synth != nullptr);
+      merged_noise_last ^= 1;
+      merged_noise[merged_noise_last] = noise_merged;
+      mixed_lane[merged_noise_last] = mixer_ifft_synth;
+      mixed_gain[merged_noise_last] = spectral_mixer_gain;
 
       pos -= block_size / 2;
       /* adjust remaining fractional position matching to new stretch */
@@ -484,10 +922,15 @@ LiveDecoder::gen_sines (float freq_in)
       old_portamento_stretch = portamento_stretch;
       assert (audio_block.noise.size() == noise_envelope.size());
       std::copy_n (audio_block.noise.data(), noise_envelope.size(), noise_envelope.begin());
+      noise_detail = block_noise_detail;
     }
   else
     {
       pos = 0;
+      last_block_mixed = false;
+      merged_noise[0] = merged_noise[1] = false;
+      mixed_lane[0] = mixed_lane[1] = nullptr;
+      reset_loop_cache();
       if (done_state == DoneState::ACTIVE)
         {
           done_state = DoneState::ALMOST_DONE;
@@ -498,13 +941,100 @@ LiveDecoder::gen_sines (float freq_in)
   rt_memory_area->free_all();
 }
 
+/* The noise of the last two blocks may have been added to the sine signal (see gen_sines), which is only
+ * correct as long as the sine signal is not resampled. Before it is resampled, we move the noise to the
+ * noise signal, using the same spectrum, so the noise continues seamlessly.
+ *
+ * Merged noise implies that sines and noise were played without resampling since the merge, so
+ * sine_samples[block_size / 2 + i] and noise_samples[i] belong to the same output sample.
+ */
+void
+LiveDecoder::unmerge_noise()
+{
+  for (int b = 0; b < 2; b++)
+    {
+      const bool last_block = (b == 1);
+      const int  index = last_block ? merged_noise_last : merged_noise_last ^ 1;
+      if (!merged_noise[index])
+        continue;
+
+      float block_noise[block_size];
+      std::copy_n (&merged_noise_spectrum[index * block_size], block_size, ifft_synth.fft_input());
+      ifft_synth.get_samples (block_noise, IFFTSynth::REPLACE);
+
+      /* the last block starts at sine_samples[block_size / 2], only the second half of the block before overlaps */
+      const size_t start = last_block ? 0 : block_size / 2;
+      for (size_t i = start; i < block_size; i++)
+        {
+          sine_samples[block_size / 2 + i - start] -= block_noise[i];
+          noise_samples[i - start] += block_noise[i];
+        }
+      merged_noise[index] = false;
+    }
+}
+
+/* Blocks synthesized by the spectral mixer are played with the gain we had when mixing them.
+ * If the gain changes, we remove the part of these blocks that has not been played yet from
+ * the spectral mixer and add it to sine_samples, so it is played with the new gain.
+ *
+ * Mixed blocks imply that the lane of the spectral mixer is aligned with sine_samples: the
+ * last block starts at sine_samples[block_size / 2] and at the start of the lane samples.
+ */
+void
+LiveDecoder::unmix()
+{
+  for (int b = 0; b < 2; b++)
+    {
+      const bool last_block = (b == 1);
+      const int  index = last_block ? merged_noise_last : merged_noise_last ^ 1;
+      if (!mixed_lane[index])
+        continue;
+
+      float block_samples[block_size];
+      std::copy_n (&mixed_spectrum[index * block_size], block_size, ifft_synth.fft_input());
+      ifft_synth.get_samples (block_samples, IFFTSynth::REPLACE);
+
+      /* the last block starts at sine_samples[block_size / 2], only the second half of the block before overlaps */
+      const size_t start = last_block ? 0 : block_size / 2;
+      spectral_mixer->subtract (mixed_lane[index], block_size - start, block_samples + start, mixed_gain[index]);
+      Block::add (block_size - start, &sine_samples[block_size / 2], block_samples + start);
+
+      mixed_lane[index] = nullptr;
+    }
+}
+
 void
 LiveDecoder::gen_noise()
 {
-  if (noise_enabled && done_state == DoneState::ACTIVE)
+  DspProfile::Scope profile_scope (DspProfile::NOISE);
+
+  const bool noise_silent = (noise_detail == NoiseDecoder::Detail::SILENT);
+
+  if (done_state == DoneState::ACTIVE && mixer_ifft_synth)
+    {
+      /* add noise to the spectrum of the block: BH92 window is converted to hann window by IFFTSynth */
+      float *spectrum = &mixed_spectrum[merged_noise_last * block_size];
+      if (noise_enabled && !noise_silent)
+        noise_decoder.process (noise_envelope.data(), spectrum, NoiseDecoder::ADD_SPECTRUM_BH92, 1, 1, noise_detail);
+
+      /* add block to the spectrum of the spectral mixer */
+      float *mixer_spectrum = mixer_ifft_synth->fft_input();
+      for (size_t i = 0; i < block_size; i++)
+        mixer_spectrum[i] += spectrum[i] * spectral_mixer_gain;
+
+      std::copy (&noise_samples[block_size / 2], &noise_samples[block_size], &noise_samples[0]);
+      zero_float_block (block_size / 2, &noise_samples[block_size / 2]);
+    }
+  else if (noise_merged || (noise_enabled && done_state == DoneState::ACTIVE && noise_silent))
+    {
+      /* noise for this block was already added to sine_samples by gen_sines(), or is silent */
+      std::copy (&noise_samples[block_size / 2], &noise_samples[block_size], &noise_samples[0]);
+      zero_float_block (block_size / 2, &noise_samples[block_size / 2]);
+    }
+  else if (noise_enabled && done_state == DoneState::ACTIVE)
     {
       /* generate hann-windowed noise using IFFT */
-      noise_decoder.process (noise_envelope.data(), ifft_synth.fft_input(), NoiseDecoder::SET_SPECTRUM_HANN, 1);
+      noise_decoder.process (noise_envelope.data(), ifft_synth.fft_input(), NoiseDecoder::SET_SPECTRUM_HANN, 1, 1, noise_detail);
       FFT::execute_fftsr_destructive_float (block_size, ifft_synth.fft_input(), ifft_synth.fft_output(), fft_plan);
 
       /* perform overlap-add (in the IFFT output, the first and second half of the windowed noise signal is swapped) */
@@ -517,6 +1047,8 @@ LiveDecoder::gen_noise()
       zero_float_block (block_size / 2, &noise_samples[0]);
     }
   noise_index = 0;
+  mixer_ifft_synth = nullptr;
+  noise_merged = false;
 }
 
 size_t
@@ -574,6 +1106,8 @@ LiveDecoder::write_audio_out (size_t n_values, float *audio_out, const float *vi
     }
   else
     {
+      unmerge_noise(); // sine signal is resampled
+
       const int todo = min (block_size / 2 - noise_index, n_values);
       while (k < todo)
         {
@@ -645,11 +1179,13 @@ LiveDecoder::process_internal (size_t n_values, const float *freq_in, const floa
       return;
     }
 
+  freq_in_constant = std::all_of (freq_in, freq_in + n_values, [&] (float freq) { return freq == freq_in[0]; });
+
   unsigned int i = 0;
   while (i < n_values)
     {
       if (pos >= block_size / 2)
-        gen_sines (freq_in[i]);
+        gen_sines (freq_in[i], process_offset + i);
 
       if (noise_index == block_size / 2)
         gen_noise();
@@ -744,6 +1280,8 @@ LiveDecoder::process_with_filter (size_t n_values, const float *freq_in, float *
 
   if (filter)
     {
+      DspProfile::Scope profile_scope (DspProfile::FILTER);
+
       const float current_note = sm_freq_to_note (freq_in[0]);
       if (ramp)
         {
@@ -795,6 +1333,7 @@ LiveDecoder::process (RTMemoryArea& rt_memory_area, size_t n_values, const float
   const size_t orig_n_values = n_values;
   const float *orig_audio_out = audio_out;
 
+  process_offset = 0;
   if (n_values && filter && filter_latency_compensation)
     {
       // latency compensation for filter oversampling: throw away a few samples at the start
@@ -819,10 +1358,21 @@ LiveDecoder::process (RTMemoryArea& rt_memory_area, size_t n_values, const float
       filter_latency_compensation = false;
     }
 
+  size_t split_index = 0;
   while (n_values > 0)
     {
       size_t todo_values = min (n_values, max_n_values);
 
+      process_offset = orig_n_values - n_values;
+      if (split_positions)
+        {
+          /* control values change at split positions: don't process across them */
+          while (split_index < split_positions->size() && (*split_positions)[split_index] <= process_offset)
+            split_index++;
+
+          if (split_index < split_positions->size())
+            todo_values = min<size_t> (todo_values, (*split_positions)[split_index] - process_offset);
+        }
       process_with_filter (todo_values, freq_in, audio_out, false);
 
       if (freq_in)
@@ -896,6 +1446,18 @@ LiveDecoder::enable_start_skip (bool ess)
   start_skip_enabled = ess;
 }
 
+void
+LiveDecoder::enable_loop_cache (bool elc)
+{
+  loop_cache_enabled = elc;
+}
+
+void
+LiveDecoder::enable_osc_bank (bool eob)
+{
+  osc_bank_enabled = eob;
+}
+
 void
 LiveDecoder::precompute_tables (float mix_freq)
 {
@@ -984,6 +1546,12 @@ LiveDecoder::set_vibrato (bool enabled, float depth, float frequency, float atta
   vibrato_attack      = attack;
 }
 
+size_t
+LiveDecoder::culled_partials() const
+{
+  return n_culled_partials;
+}
+
 double
 LiveDecoder::current_pos() const
 {
@@ -1024,8 +1592,35 @@ LiveDecoder::time_offset_ms() const
   return 1000 * (env_pos - start_env_pos) / mix_freq;
 }
 
+/* start of the part of the block that is currently processed (relative to the start of the block) */
+double
+LiveDecoder::process_offset_ms() const
+{
+  assert (in_process);
+  return 1000 * process_offset / mix_freq;
+}
+
+/* positions (sorted, relative to the start of the next process() call) where process()
+ * needs to split the block, i.e. because control values change
+ */
+void
+LiveDecoder::set_split_positions (const std::vector<uint> *positions)
+{
+  split_positions = positions;
+}
+
 void
 LiveDecoder::set_filter (LiveDecoderFilter *new_filter)
 {
   filter = new_filter;
 }
+
+/* output module of the voice (if the decoder plays a morph plan): before each frame is
+ * requested from the source, the control operators of the voice are evaluated once, the
+ * modules that compute the frame only read the values
+ */
+void
+LiveDecoder::set_output_module (MorphOutputModule *new_output_module)
+{
+  output_module = new_output_module;
+}
@@ -9,6 +9,7 @@
 #include "smlivedecodersource.hh"
 #include "smpolyphaseinter.hh"
 #include "smalignedarray.hh"
+#include "smoscbank.hh"
 #include <vector>
 #include <functional>
 #include <array>
@@ -16,11 +17,17 @@
 namespace SpectMorph {
 
 class LiveDecoderFilter;
+class SpectralMixer;
+class MorphOutputModule;
 class LiveDecoder
 {
   static constexpr size_t PARTIAL_STATE_RESERVE = 2048; // maximum number of partials to expect
   static constexpr size_t MAX_N_VALUES = 64;            // maximum number of values to process at once
   static constexpr size_t MAX_UNISON_VOICES = 7;        // maximum number of unison voices
+  static constexpr int    LOOP_CACHE_MIN_BLOCKS = 2;    // stationary blocks before loop cache is built
+  static constexpr double LOOP_CACHE_MAX_DETUNE = 1.0012;  // max. frequency change of loud partials in loop cache (2 cent)
+  static constexpr float  LOOP_CACHE_QUIET_MAG = 0.003;    // partials 50 dB below the loudest partial may be detuned more
+  static constexpr size_t LOOP_CACHE_BUILD_LOAD = 16;      // max. table samples rendered per block while building (in blocks)
 
   LeakDebugger leak_debugger { "SpectMorph::LiveDecoder" };
 
@@ -39,6 +46,7 @@ class LiveDecoder
 
   size_t              block_size;
   IFFTSynth           ifft_synth;
+  OscBank             osc_bank;
   NoiseDecoder        noise_decoder;
   const FFT::Plan    *fft_plan;
   LiveDecoderSource  *source;
@@ -46,6 +54,7 @@ class LiveDecoder
   AAFilterTable      *aa_filter_table = nullptr;
   RTMemoryArea       *rt_memory_area = nullptr;
   LiveDecoderFilter  *filter = nullptr;
+  MorphOutputModule  *output_module = nullptr;
   bool                filter_latency_compensation;
 
   bool                sines_enabled;
@@ -55,6 +64,8 @@ class LiveDecoder
   bool                original_samples_enabled;
   bool                loop_enabled;
   bool                start_skip_enabled;
+  bool                loop_cache_enabled = true;
+  bool                osc_bank_enabled = true;
 
   double              frame_step;
   size_t              zero_values_at_start_scaled;
@@ -79,6 +90,7 @@ class LiveDecoder
   AlignedArray<float,16> noise_samples;
 
   std::array<uint16_t, Audio::N_NOISE_BANDS> noise_envelope;
+  NoiseDecoder::Detail noise_detail = NoiseDecoder::Detail::FULL;  // detail level of noise_envelope
 
   // unison
   int                 unison_voices;
@@ -86,6 +98,11 @@ class LiveDecoder
   std::vector<float>  unison_freq_factor;
   float               unison_gain;
 
+  // partials to render for the current block (for IFFTSynth::render_partials)
+  std::vector<float>  render_freqs;
+  std::vector<float>  render_mags;
+  std::vector<uint>   render_phases;
+
   // vibrato
   bool                vibrato_enabled;
   float               vibrato_depth;
@@ -94,6 +111,51 @@ class LiveDecoder
   float               vibrato_phase;   // state
   float               vibrato_env;     // state
 
+  // spectral mixing
+  SpectralMixer      *spectral_mixer = nullptr;
+  float               spectral_mixer_gain = 0;
+  IFFTSynth          *mixer_ifft_synth = nullptr;  // set if current block is synthesized by spectral mixer
+  bool                last_block_mixed = false;
+  AlignedArray<float,16> mixed_spectrum;             // spectra of the last two blocks without gain (2 * block_size)
+  IFFTSynth          *mixed_lane[2] = { nullptr, nullptr }; // spectral mixer lane of block (nullptr: not mixed)
+  float               mixed_gain[2] = { 0, 0 };     // gain of block in spectral mixer lane
+  size_t              process_offset = 0;
+
+  const std::vector<uint> *split_positions = nullptr;
+
+  // sine + noise synthesis using one IFFT
+  bool                noise_merged = false;             // noise of current block was added to sine_samples
+  bool                freq_in_constant = false;         // input frequency is constant during current process call
+  AlignedArray<float,16> merged_noise_spectrum;         // noise spectra of the last two blocks (2 * block_size)
+  bool                merged_noise[2] = { false, false }; // noise of block was added to sine_samples
+  int                 merged_noise_last = 0;            // index of last block in merged_noise / merged_noise_spectrum / mixed_*
+
+  // loop cache: stationary harmonic sines are played from a periodic table instead of IFFT synthesis
+  enum class LoopCacheState {
+    OFF,        // partials not stationary (yet)
+    BUILDING,   // table is rendered incrementally, sines still use normal synthesis
+    ACTIVE,     // sines are played from the table
+    FAILED      // partials are not harmonic, don't retry until the partials change
+  };
+  LoopCacheState      loop_cache_state = LoopCacheState::OFF;
+  AlignedArray<float,16> loop_cache_table;
+  std::vector<float>  loop_cache_window;
+  std::vector<uint>   loop_cache_phases;   // phase of each partial at table position 0
+  std::vector<uint>   loop_cache_cycles;   // number of cycles of each partial within the table
+  std::vector<float>  loop_cache_mags;     // magnitude of each partial in the table (0 if culled)
+  size_t              loop_cache_culled = 0;  // number of partials culled when preparing the table
+  size_t              loop_cache_len = 0;  // table length
+  size_t              loop_cache_pos = 0;
+  size_t              loop_cache_build_partial = 0;  // next partial to add to the table while building
+  size_t              loop_cache_build_step = 0;     // number of partials to add to the table per block
+  int                 loop_cache_stationary_blocks = 0;
+
+  // partial culling
+  size_t              partial_budget = 0;        // maximum number of partials to render (0: no limit)
+  size_t              n_culled_partials = 0;     // number of partials not rendered in the last block
+  std::vector<char>   partial_keep;
+  std::vector<float>  partial_cull_mags;
+
   // timing related
   double              start_env_pos = 0;
   bool                in_process    = false;
@@ -108,8 +170,18 @@ class LiveDecoder
 
   Audio::LoopType     get_loop_type();
 
-  void   gen_sines (float freq);
+  IFFTSynth *spectral_mixer_ifft_synth (size_t offset, float portamento_stretch);
+
+  bool   update_loop_cache (std::vector<PartialState>& new_pstate, const std::vector<PartialState>& old_pstate, float portamento_stretch);
+  bool   prepare_loop_cache (const std::vector<PartialState>& partials, float portamento_stretch);
+  bool   build_loop_cache (const std::vector<PartialState>& partials);
+  void   render_loop_cache (std::vector<PartialState>& partials);
+  void   reset_loop_cache();
+  size_t cull_partials (const std::vector<PartialState>& partials, size_t max_partials);
+  void   gen_sines (float freq, size_t offset);
   void   gen_noise();
+  void   unmerge_noise();
+  void   unmix();
   size_t write_audio_out (size_t n_values, float *audio_out, const float *vib_freq_in);
 
   void process_internal (size_t       n_values,
@@ -137,11 +209,17 @@ public:
   void enable_original_samples (bool eos);
   void enable_loop (bool eloop);
   void enable_start_skip (bool ess);
+  void enable_loop_cache (bool elc);
+  void enable_osc_bank (bool eob);
   void set_random_seed (int seed);
   void set_unison_voices (int voices, float detune);
   void set_vibrato (bool enable_vibrato, float depth, float frequency, float attack);
   void set_filter (LiveDecoderFilter *filter);
+  void set_output_module (MorphOutputModule *output_module);
   void set_source (LiveDecoderSource *source);
+  void set_spectral_mixer (SpectralMixer *mixer, float gain);
+  void set_partial_budget (size_t max_partials);
+  void set_split_positions (const std::vector<uint> *positions);
 
   static void precompute_tables (float mix_freq);
   void retrigger (int channel, float freq, int midi_velocity);
@@ -150,6 +228,8 @@ public:
                 const float  *freq_in,
                 float        *audio_out);
 
+  size_t culled_partials() const;
+  bool   loop_cache_active() const;
   double current_pos() const;
   double fundamental_note() const;
 
@@ -157,6 +237,7 @@ public:
   bool done() const;
 
   double time_offset_ms() const;
+  double process_offset_ms() const;
 };
 
 }
@@ -130,6 +130,8 @@ LiveDecoderFilter::process (size_t n_values, float *audio, float current_note)
       }
   };
 
+  output_module->update_control_values();
+
   float delta_cent = (current_note - 60) * key_tracking;
   float filter_keytrack_octaves = delta_cent * (1 / 1200.f);
 
@@ -15,6 +15,11 @@ public:
   virtual Audio *audio() = 0;
   virtual bool rt_audio_block (size_t index, RTAudioBlock& rt_audio_block) = 0;
   virtual void set_portamento_freq (float freq) = 0;
+
+  /* if rt_audio_block() output only depends on the block index, return a pointer that
+   * identifies the data (used as MorphCache key), otherwise nullptr
+   */
+  virtual const void *block_cache_id() { return nullptr; }
   virtual ~LiveDecoderSource();
 };
 
@@ -17,6 +17,16 @@ static inline __attribute__((always_inline)) __m128 _mm_set_ps(float e3, float e
   return r;
 }
 
+static inline __attribute__((always_inline)) __m128 _mm_loadu_ps(const float *p)
+{
+  return vld1q_f32(p);
+}
+
+static inline __attribute__((always_inline)) void _mm_storeu_ps(float *p, __m128 a)
+{
+  vst1q_f32(p, a);
+}
+
 #define _MM_SHUFFLE(z, y, x, w) (((z) << 6) | ((y) << 4) | ((x) << 2) | (w))
 
 static inline __attribute__((always_inline)) __m128 _mm_mul_ps(__m128 a, __m128 b)
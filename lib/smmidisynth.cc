@@ -3,6 +3,7 @@
 #include "smmidisynth.hh"
 #include "smmorphoutputmodule.hh"
 #include "smdebug.hh"
+#include "smvoicepool.hh"
 
 #include <mutex>
 #include <cinttypes>
@@ -27,11 +28,17 @@ using std::string;
 #define SM_MIDI_CTL_CONTROL_3     18
 #define SM_MIDI_CTL_CONTROL_4     19
 
-MidiSynth::MidiSynth (double mix_freq, size_t n_voices) :
-  morph_plan_synth (mix_freq, n_voices),
-  m_inst_edit_synth (mix_freq),
-  m_mix_freq (mix_freq),
-  m_time_info_gen (mix_freq),
+using PandaResampler::Resampler2;
+
+/* n_voices:            maximum number of voices
+ * pool_size:           number of voices that can be used initially (0: all voices), see VoicePool
+ * fixed_internal_rate: synthesize at 44.1/48 kHz for high host rates, see upsample_factor()
+ */
+MidiSynth::MidiSynth (double mix_freq, size_t n_voices, size_t pool_size, bool fixed_internal_rate) :
+  morph_plan_synth (mix_freq / upsample_factor (mix_freq, fixed_internal_rate), n_voices, pool_size),
+  m_inst_edit_synth (mix_freq / upsample_factor (mix_freq, fixed_internal_rate)),
+  m_mix_freq (mix_freq / upsample_factor (mix_freq, fixed_internal_rate)),
+  m_time_info_gen (mix_freq / upsample_factor (mix_freq, fixed_internal_rate)),
   audio_time_stamp (0),
   mono_enabled (false),
   portamento_note_id (0),
@@ -42,34 +49,133 @@ MidiSynth::MidiSynth (double mix_freq, size_t n_voices) :
   voices.clear();
   voices.resize (n_voices);
   active_voices.reserve (n_voices);
+  m_deferred_notes.reserve (MAX_VOICES);
   events.reserve (1024);
 
   for (size_t i = 0; i < n_voices; i++)
     {
       voices[i].mp_voice = morph_plan_synth.voice (i);
-      idle_voices.push_back (&voices[i]);
+      idle_voices.push_back (&voices[n_voices - 1 - i]);
     }
+  m_voice_limit = morph_plan_synth.pool_size();
   global_modulation.fill (0);
+
+  m_upsample_factor = upsample_factor (mix_freq, fixed_internal_rate);
+  if (m_upsample_factor > 1)
+    {
+      m_upsampler.reset (new Resampler2 (Resampler2::UP, m_upsample_factor, Resampler2::PREC_72DB));
+
+      /* process() renders at most MAX_RENDER_VALUES internal samples at once */
+      m_internal_samples.resize (MAX_RENDER_VALUES);
+      m_upsample_buffer.resize (MAX_RENDER_VALUES * m_upsample_factor);
+      m_later_events.reserve (events.capacity());
+    }
+}
+
+/* Synthesis costs (FFT sizes, per sample work) grow with the sample rate, although
+ * the output filter removes everything above 18 kHz anyway. So for high host rates
+ * we can optionally synthesize at 44.1/48 kHz and upsample the mix once.
+ */
+uint
+MidiSynth::upsample_factor (double mix_freq, bool fixed_internal_rate)
+{
+  uint factor = 1;
+
+  if (fixed_internal_rate)
+    {
+      // Resampler2 supports factors 2, 4 and 8
+      while (factor < 8 && mix_freq / (factor * 2) >= 44100)
+        factor *= 2;
+    }
+  return factor;
 }
 
 MidiSynth::Voice *
 MidiSynth::alloc_voice()
 {
-  if (idle_voices.empty()) // out of voices?
+  /* use the idle voice with the lowest index, so that voices at the end of
+   * the pool (above the voice limit) stay idle if they are not needed and the
+   * pool can shrink
+   */
+  const size_t pool_size = morph_plan_synth.pool_size();
+
+  size_t idle_index = idle_voices.size();
+  for (size_t i = 0; i < idle_voices.size(); i++)
+    {
+      if (size_t (idle_voices[i] - &voices[0]) < pool_size && (idle_index == idle_voices.size() || idle_voices[i] < idle_voices[idle_index]))
+        idle_index = i;
+    }
+  if (idle_index == idle_voices.size()) // out of voices?
     return NULL;
 
-  Voice *voice = idle_voices.back();
+  Voice *voice = idle_voices[idle_index];
   assert (voice->state == Voice::STATE_IDLE);   // every item in idle_voices should be idle
 
   voice->note_id = next_note_id++;
+  voice->steal_fade_pos = 0;
+
+  // pending control changes belong to the previous note (if the voice was stolen)
+  voice->mp_voice->clear_control_changes();
 
   // move voice from idle to active list
+  idle_voices[idle_index] = idle_voices.back();
   idle_voices.pop_back();
   active_voices.push_back (voice);
 
   return voice;
 }
 
+size_t
+MidiSynth::idle_pool_voices() const
+{
+  const size_t pool_size = morph_plan_synth.pool_size();
+
+  size_t n_idle = 0;
+  for (auto voice : idle_voices)
+    {
+      if (size_t (voice - &voices[0]) < pool_size)
+        n_idle++;
+    }
+  return n_idle;
+}
+
+/* voice stealing: fade out oldest released voice, or if there is none, the oldest voice */
+MidiSynth::Voice *
+MidiSynth::steal_voice()
+{
+  Voice *steal = nullptr;
+
+  for (auto voice : active_voices)
+    {
+      if (voice->state == Voice::STATE_IDLE || voice->mono_type != Voice::MonoType::POLY || voice->steal_fade_pos)
+        continue;
+
+      if (!steal)
+        {
+          steal = voice;
+        }
+      else
+        {
+          const bool released = voice->state == Voice::STATE_RELEASE;
+          const bool steal_released = steal->state == Voice::STATE_RELEASE;
+
+          if ((released && !steal_released) || (released == steal_released && voice->note_id < steal->note_id))
+            steal = voice;
+        }
+    }
+  if (steal)
+    {
+      MIDI_DEBUG ("steal voice, note %d, note_id %d\n", steal->midi_note, steal->note_id);
+
+      /* the voice becomes idle once the fade out is done (see render_voice) */
+      steal->state = Voice::STATE_RELEASE;
+      steal->pedal = false;
+      steal->steal_fade_len = max (sm_round_positive (STEAL_FADE_MS / 1000 * m_mix_freq), 1);
+      steal->steal_fade_pos = steal->steal_fade_len;
+    }
+  return steal;
+}
+
 void
 MidiSynth::free_unused_voices()
 {
@@ -127,10 +233,68 @@ MidiSynth::process_note_on (const NoteEvent& note)
   if (!morph_plan_synth.have_output())
     return;
 
+  // keep note order: notes that are already waiting for a voice go first
+  start_deferred_notes();
+
+  if (m_deferred_notes.empty() && start_note (note))
+    return;
+
+  /* No voice available: if the pool can still grow, the note waits until VoicePool
+   * has added voices. If the pool is at the maximum size, a voice is faded out and
+   * the note is started afterwards.
+   */
+  if (m_deferred_notes.size() == m_deferred_notes.capacity())
+    {
+      MIDI_DEBUG ("dropping note on event, note %d: too many notes waiting for a voice\n", note.key);
+      return;
+    }
+  m_deferred_notes.push_back ({ note });
+
+  if (morph_plan_synth.pool_size() == voices.size())
+    {
+      size_t n_fading = 0;
+      for (auto voice : active_voices)
+        {
+          if (voice->steal_fade_pos)
+            n_fading++;
+        }
+      if (n_fading < m_deferred_notes.size())
+        steal_voice();
+    }
+}
+
+void
+MidiSynth::start_deferred_notes()
+{
+  size_t n_started = 0;
+
+  while (n_started < m_deferred_notes.size() && start_note (m_deferred_notes[n_started].note))
+    {
+      const DeferredNote& deferred = m_deferred_notes[n_started++];
+
+      if (deferred.released)
+        process_note_off (deferred.note.channel, deferred.note.key);
+    }
+  m_deferred_notes.erase (m_deferred_notes.begin(), m_deferred_notes.begin() + n_started);
+}
+
+/* returns false if there are not enough idle voices in the pool to start the note */
+bool
+MidiSynth::start_note (const NoteEvent& note)
+{
   const MorphOutputModule *output = voices[0].mp_voice->output();
   set_mono_enabled (output->portamento());
   portamento_glide = output->portamento_glide();
 
+  // in mono mode, an extra voice is needed if there is no mono voice yet
+  size_t n_needed = 1;
+  if (mono_enabled && std::none_of (active_voices.begin(), active_voices.end(),
+                                    [] (Voice *v) { return v->state == Voice::STATE_ON && v->mono_type == Voice::MonoType::MONO; }))
+    n_needed++;
+
+  if (idle_pool_voices() < n_needed)
+    return false;
+
   TimeInfo time_info = m_time_info_gen.time_info (0);
 
   Voice *voice = alloc_voice();
@@ -186,6 +350,7 @@ MidiSynth::process_note_on (const NoteEvent& note)
             }
         }
     }
+  return true;
 }
 
 bool
@@ -248,6 +413,12 @@ MidiSynth::start_pitch_bend (Voice *voice, double dest_freq, double time_ms)
 void
 MidiSynth::process_note_off (int channel, int midi_note)
 {
+  for (auto& deferred : m_deferred_notes)
+    {
+      if (deferred.note.channel == channel && deferred.note.key == midi_note)
+        deferred.released = true;
+    }
+
   if (mono_enabled)
     {
       bool need_free = false;
@@ -355,6 +526,11 @@ MidiSynth::process_midi_controller (int channel, int controller, int value)
         {
           process_note_off (cn.first, cn.second);
         }
+      for (auto& deferred : m_deferred_notes)
+        {
+          if (deferred.note.channel == channel)
+            deferred.released = true;
+        }
     }
   if (m_control_by_cc)
     {
@@ -503,15 +679,110 @@ MidiSynth::add_midi_event (size_t offset, const unsigned char *midi_data) noexce
     }
 }
 
+bool
+MidiSynth::render_voice (Voice *voice, RTMemoryArea& rt_memory_area, SpectralMixer *spectral_mixer, float *samples, size_t n_values)
+{
+  bool have_samples = false;
+  float *values[1] = { samples };
+
+  for (int c = 0; c < MorphPlan::N_CONTROL_INPUTS; c++)
+    {
+      /* with pending control changes, the voice already knows the value at the start of the block */
+      if (!voice->mp_voice->have_control_changes (c))
+        voice->mp_voice->set_control_input (c, voice_control (voice, c));
+    }
+
+  const float *freq_in = nullptr;
+  float frequencies[n_values];
+  if (fabs (voice->pitch_bend_freq - voice->freq) > 1e-3 || voice->pitch_bend_steps > 0)
+    {
+      for (unsigned int i = 0; i < n_values; i++)
+        {
+          frequencies[i] = voice->pitch_bend_freq;
+          if (voice->pitch_bend_steps > 0)
+            {
+              voice->pitch_bend_freq *= voice->pitch_bend_factor;
+              voice->pitch_bend_steps--;
+            }
+        }
+      freq_in = frequencies;
+      voice->mp_voice->set_current_freq (frequencies[0]);
+    }
+  else
+    {
+      voice->mp_voice->set_current_freq (voice->freq);
+    }
+  if (voice->mono_type == Voice::MonoType::SHADOW)
+    {
+      /* skip: shadow voices are not rendered */
+    }
+  else if (voice->state == Voice::STATE_ON || voice->state == Voice::STATE_RELEASE)
+    {
+      MorphOutputModule *output_module = voice->mp_voice->output();
+
+      /* need to check done because in some cases voices jump to done state
+       * (i.e. full updates, adsr envelope toggled...) and we don't want
+       * to process these
+       */
+      if (!output_module->done())
+        {
+          const uint64 profile_start = m_dsp_profile_enabled ? DspProfile::ticks() : 0;
+
+          /* fading voices are not mixed spectrally, the fade is applied to the samples */
+          output_module->set_spectral_mixer (voice->steal_fade_pos ? nullptr : spectral_mixer, voice->gain * m_gain);
+          output_module->set_partial_budget (m_voice_partial_budget);
+          output_module->process (m_time_info_gen, rt_memory_area, n_values, values, 1, freq_in);
+          have_samples = true;
+
+          if (m_dsp_profile_enabled)
+            voice->profile_ticks += DspProfile::ticks() - profile_start;
+        }
+
+      if (voice->steal_fade_pos)
+        {
+          if (have_samples)
+            {
+              for (size_t i = 0; i < n_values; i++)
+                samples[i] *= float (max<int> (voice->steal_fade_pos - int (i), 0)) / voice->steal_fade_len;
+            }
+
+          voice->steal_fade_pos = max<int> (voice->steal_fade_pos - int (n_values), 0);
+          if (!voice->steal_fade_pos)
+            voice->state = Voice::STATE_IDLE;
+        }
+      if (output_module->done())
+        {
+          /* envelope reached zero -> voice can be reused later */
+          voice->state = Voice::STATE_IDLE;
+          voice->pedal = false;
+        }
+    }
+  else
+    {
+      g_assert_not_reached();
+    }
+  voice->mp_voice->advance_control_changes ((audio_time_stamp + n_values) / m_mix_freq * 1000);
+  return have_samples;
+}
+
 void
 MidiSynth::process_audio (float *output, size_t n_values)
 {
   if (!n_values)    /* this can happen if multiple midi events occur at the same time */
     return;
 
+  /* spectral mixing is only used if all voices are rendered by the synthesis thread */
+  SpectralMixer *spectral_mixer = m_render_pool ? nullptr : m_spectral_mixer.get();
+  if (spectral_mixer && n_values > spectral_mixer->max_n_values())
+    {
+      const size_t max_n_values = spectral_mixer->max_n_values();
+
+      for (size_t offset = 0; offset < n_values; offset += max_n_values)
+        process_audio (output + offset, min (n_values - offset, max_n_values));
+      return;
+    }
+
   bool  need_free = false;
-  float samples[n_values];
-  float *values[1] = { samples };
 
   zero_float_block (n_values, output);
 
@@ -519,67 +790,82 @@ MidiSynth::process_audio (float *output, size_t n_values)
   if (!morph_plan_synth.have_output())
     return;
 
-  for (Voice *voice : active_voices)
+  update_voice_partial_budget();
+
+  const bool render_parallel = m_render_pool && n_values <= MAX_RENDER_VALUES && active_voices.size() > 1;
+
+  /* voices rendered by the synthesis thread can share morph results */
+  morph_plan_synth.morph_cache()->new_block (!render_parallel && active_voices.size() > 1);
+
+  if (render_parallel)
     {
-      for (int c = 0; c < MorphPlan::N_CONTROL_INPUTS; c++)
-        voice->mp_voice->set_control_input (c, voice_control (voice, c));
+      /* render voices in parallel, each voice into its own buffer */
+      auto render_job = [&] (size_t job, int thread_index)
+        {
+          RTMemoryArea& rt_memory_area = thread_index ? *m_render_rt_memory_areas[thread_index - 1] : m_rt_memory_area;
+
+          /* synthesis thread (thread_index 0) already uses m_dsp_profile */
+          if (m_dsp_profile_enabled && thread_index)
+            DspProfile::set_thread_profile (m_render_dsp_profiles[thread_index - 1].get());
+
+          m_render_have_samples[job] = render_voice (active_voices[job], rt_memory_area, nullptr, &m_render_samples[job * MAX_RENDER_VALUES], n_values);
+
+          if (m_dsp_profile_enabled && thread_index)
+            DspProfile::set_thread_profile (nullptr);
+        };
+      m_render_pool->run (active_voices.size(), render_job);
 
-      const float gain = voice->gain * m_gain;
-      const float *freq_in = nullptr;
-      float frequencies[n_values];
-      if (fabs (voice->pitch_bend_freq - voice->freq) > 1e-3 || voice->pitch_bend_steps > 0)
+      if (m_dsp_profile_enabled)
         {
-          for (unsigned int i = 0; i < n_values; i++)
+          for (auto& profile : m_render_dsp_profiles)
             {
-              frequencies[i] = voice->pitch_bend_freq;
-              if (voice->pitch_bend_steps > 0)
-                {
-                  voice->pitch_bend_freq *= voice->pitch_bend_factor;
-                  voice->pitch_bend_steps--;
-                }
+              m_dsp_profile.merge (*profile);
+              profile->clear();
             }
-          freq_in = frequencies;
-          voice->mp_voice->set_current_freq (frequencies[0]);
-        }
-      else
-        {
-          voice->mp_voice->set_current_freq (voice->freq);
         }
-      if (voice->mono_type == Voice::MonoType::SHADOW)
-        {
-          /* skip: shadow voices are not rendered */
-        }
-      else if (voice->state == Voice::STATE_ON || voice->state == Voice::STATE_RELEASE)
+
+      /* mix in voice order, so that the result is identical to single threaded rendering */
+      for (size_t job = 0; job < active_voices.size(); job++)
         {
-          MorphOutputModule *output_module = voice->mp_voice->output();
+          Voice *voice = active_voices[job];
+          const float gain = voice->gain * m_gain;
+          const float *samples = &m_render_samples[job * MAX_RENDER_VALUES];
 
-          /* need to check done because in some cases voices jump to done state
-           * (i.e. full updates, adsr envelope toggled...) and we don't want
-           * to process these
-           */
-          if (!output_module->done())
+          if (m_render_have_samples[job])
             {
-              output_module->process (m_time_info_gen, m_rt_memory_area, n_values, values, 1, freq_in);
               for (size_t i = 0; i < n_values; i++)
                 output[i] += samples[i] * gain;
             }
+          if (voice->state == Voice::STATE_IDLE)
+            need_free = true; // need to recompute active_voices and idle_voices vectors
+        }
+    }
+  else
+    {
+      float samples[n_values];
 
-          if (output_module->done())
-            {
-              /* envelope reached zero -> voice can be reused later */
-              voice->state = Voice::STATE_IDLE;
-              voice->pedal = false;
+      for (Voice *voice : active_voices)
+        {
+          const float gain = voice->gain * m_gain;
 
-              need_free = true; // need to recompute active_voices and idle_voices vectors
+          if (render_voice (voice, m_rt_memory_area, spectral_mixer, samples, n_values))
+            {
+              for (size_t i = 0; i < n_values; i++)
+                output[i] += samples[i] * gain;
             }
+          if (voice->state == Voice::STATE_IDLE)
+            need_free = true; // need to recompute active_voices and idle_voices vectors
         }
-      else
-        {
-          g_assert_not_reached();
-        }
+      if (spectral_mixer)
+        spectral_mixer->process (output, n_values);
     }
   if (need_free)
-    free_unused_voices();
+    {
+      free_unused_voices();
+
+      // stolen voices that finished fading out can be used by waiting notes
+      start_deferred_notes();
+    }
 
   audio_time_stamp += n_values;
   m_time_info_gen.update_time_stamp (audio_time_stamp);
@@ -618,8 +904,164 @@ MidiSynth::sort_events_stable()
 }
 
 
+/* events that only change control values (not notes or pitch) */
+bool
+MidiSynth::is_control_event (const Event& event) const
+{
+  switch (event.type)
+    {
+      case EVENT_CONTROL_VALUE:
+      case EVENT_MOD_VALUE:
+        return true;
+      case EVENT_CC:
+        return event.cc.controller != SM_MIDI_CTL_SUSTAIN && event.cc.controller != SM_MIDI_CTL_ALL_NOTES_OFF;
+      default:
+        return false;
+    }
+}
+
+/* apply control event and pass the resulting value changes to the voices
+ *
+ * render_offset is the position of the event relative to the audio that will be
+ * rendered by the next process_audio() call
+ */
+void
+MidiSynth::process_control_event (const Event& event, uint render_offset)
+{
+  const size_t n_voices = active_voices.size();
+
+  float old_values[n_voices * MorphPlan::N_CONTROL_INPUTS];
+  for (size_t v = 0; v < n_voices; v++)
+    for (int c = 0; c < MorphPlan::N_CONTROL_INPUTS; c++)
+      old_values[v * MorphPlan::N_CONTROL_INPUTS + c] = voice_control (active_voices[v], c);
+
+  switch (event.type)
+    {
+      case EVENT_CONTROL_VALUE:
+        {
+          MIDI_DEBUG ("%" PRIu64 " | control input %d -> %f\n", audio_time_stamp + render_offset, event.value.control_input, event.value.value);
+
+          set_control_input (event.value.control_input, event.value.value);
+        }
+        break;
+      case EVENT_MOD_VALUE:
+        {
+          MIDI_DEBUG ("%" PRIu64 " | mod event, clap_id %d, channel %d, note %d | control input %d -> %f\n",
+                      audio_time_stamp + render_offset, event.mod.clap_id, event.mod.channel, event.mod.key, event.mod.control_input, event.mod.value);
+
+          process_mod_value (event.mod);
+        }
+        break;
+      case EVENT_CC:
+        {
+          MIDI_DEBUG ("%" PRIu64 " | controller event, %d %d\n", audio_time_stamp + render_offset, event.cc.controller, event.cc.value);
+
+          process_midi_controller (event.cc.channel, event.cc.controller, event.cc.value);
+        }
+        break;
+      default:
+        g_assert_not_reached();
+    }
+
+  const double time_ms = (audio_time_stamp + render_offset) / m_mix_freq * 1000;
+  for (size_t v = 0; v < n_voices; v++)
+    {
+      Voice *voice = active_voices[v];
+
+      for (int c = 0; c < MorphPlan::N_CONTROL_INPUTS; c++)
+        {
+          const float old_value = old_values[v * MorphPlan::N_CONTROL_INPUTS + c];
+          const float new_value = voice_control (voice, c);
+
+          if (new_value != old_value)
+            voice->mp_voice->add_control_change (c, time_ms, old_value, new_value);
+        }
+    }
+}
+
+
 void
 MidiSynth::process (float *output, size_t n_values, MidiSynthCallbacks *process_callbacks) noexcept
+{
+  if (!m_upsampler)
+    {
+      process_block (output, n_values, process_callbacks);
+      return;
+    }
+
+  /* output upsampled values left from the previous block (less than m_upsample_factor) */
+  const size_t n_left = min (n_values, m_upsample_buffer_len - m_upsample_buffer_pos);
+  std::copy_n (&m_upsample_buffer[m_upsample_buffer_pos], n_left, output);
+  m_upsample_buffer_pos += n_left;
+
+  if (n_left == n_values)
+    {
+      // tiny block: events will be processed at the start of the next block
+      for (auto& event : events)
+        event.offset = 0;
+      return;
+    }
+
+  /* event offsets are given at host rate, convert them to internal rate
+   *
+   * events are processed at the next internal sample, so the result doesn't
+   * depend on how the host splits the audio into blocks
+   */
+  for (auto& event : events)
+    event.offset = event.offset > n_left ? (event.offset - n_left + m_upsample_factor - 1) / m_upsample_factor : 0;
+
+  sort_events_stable();
+
+  output += n_left;
+  n_values -= n_left;
+  while (n_values)
+    {
+      /* large blocks are rendered in parts, so the buffers never need to grow here */
+      const size_t n_internal = min<size_t> ((n_values + m_upsample_factor - 1) / m_upsample_factor, MAX_RENDER_VALUES);
+      const size_t n_todo = min<size_t> (n_values, n_internal * m_upsample_factor);
+
+      /* events after this part are kept for the next part */
+      m_later_events.clear();
+      if (n_todo < n_values)
+        {
+          auto later = std::find_if (events.begin(), events.end(), [&] (const Event& event) { return event.offset >= n_internal; });
+          for (auto it = later; it != events.end(); it++)
+            {
+              m_later_events.push_back (*it);
+              m_later_events.back().offset -= n_internal;
+            }
+          events.erase (later, events.end());
+        }
+      process_block (m_internal_samples.data(), n_internal, process_callbacks);
+      events.swap (m_later_events);
+
+      m_upsampler->process_block (m_internal_samples.data(), n_internal, m_upsample_buffer.data());
+      std::copy_n (m_upsample_buffer.data(), n_todo, output);
+
+      m_upsample_buffer_pos = n_todo;
+      m_upsample_buffer_len = n_internal * m_upsample_factor;
+
+      output += n_todo;
+      n_values -= n_todo;
+    }
+}
+
+/* Latency of the output (in samples at host rate)
+ *
+ * The upsampler (fixed internal rate) delays the output, so plugins report this
+ * to the host, which compensates it.
+ */
+uint
+MidiSynth::latency() const
+{
+  if (m_upsampler)
+    return sm_round_positive (m_upsampler->delay());
+
+  return 0;
+}
+
+void
+MidiSynth::process_block (float *output, size_t n_values, MidiSynthCallbacks *process_callbacks)
 {
   if (inst_edit) // inst edit mode? -> delegate
     {
@@ -643,6 +1085,12 @@ MidiSynth::process (float *output, size_t n_values, MidiSynthCallbacks *process_
   assert (m_process_callbacks == nullptr);
   m_process_callbacks = process_callbacks;
 
+  /* the synthesis time is needed for DSP profiling and to adapt the partial budget */
+  const bool   measure_time = m_dsp_profile_enabled || m_voice_partial_budget;
+  const uint64 profile_start = measure_time ? DspProfile::ticks() : 0;
+  if (m_dsp_profile_enabled)
+    DspProfile::set_thread_profile (&m_dsp_profile);
+
   uint32_t offset = 0;
 
   m_time_info_gen.start_block (audio_time_stamp, n_values, m_ppq_pos, m_tempo);
@@ -655,11 +1103,21 @@ MidiSynth::process (float *output, size_t n_values, MidiSynthCallbacks *process_
    */
   sort_events_stable();
 
+  // notes waiting for a voice can be started if the pool has grown
+  start_deferred_notes();
+
   for (const auto& event : events)
     {
       // ensure that new offset from midi event is not larger than n_values
       uint32_t new_offset = min <uint32_t> (event.offset, n_values);
 
+      // control events don't split the block, voices get sample accurate control changes instead
+      if (is_control_event (event))
+        {
+          process_control_event (event, new_offset - offset);
+          continue;
+        }
+
       // process any audio that is before the event
       process_audio (output + offset, new_offset - offset);
       offset = new_offset;
@@ -681,21 +1139,6 @@ MidiSynth::process (float *output, size_t n_values, MidiSynthCallbacks *process_
               process_note_off (event.note.channel, event.note.key);
             }
             break;
-          case EVENT_CONTROL_VALUE:
-            {
-              MIDI_DEBUG ("%" PRIu64 " | control input %d -> %f\n", audio_time_stamp, event.value.control_input, event.value.value);
-
-              set_control_input (event.value.control_input, event.value.value);
-            }
-            break;
-          case EVENT_MOD_VALUE:
-            {
-              MIDI_DEBUG ("%" PRIu64 " | mod event, clap_id %d, channel %d, note %d | control input %d -> %f\n",
-                          audio_time_stamp, event.mod.clap_id, event.mod.channel, event.mod.key, event.mod.control_input, event.mod.value);
-
-              process_mod_value (event.mod);
-            }
-            break;
           case EVENT_PITCH_EXPRESSION:
             {
               MIDI_DEBUG ("%" PRIu64 " | pitch expression event: channel %d, note %d, %.2f semi tones\n",
@@ -724,6 +1167,8 @@ MidiSynth::process (float *output, size_t n_values, MidiSynthCallbacks *process_
               process_midi_controller (event.cc.channel, event.cc.controller, event.cc.value);
             }
             break;
+          default:
+            g_assert_not_reached();
         }
     }
 
@@ -732,9 +1177,25 @@ MidiSynth::process (float *output, size_t n_values, MidiSynthCallbacks *process_
 
   events.clear();
 
+  update_pool_status();
+
   m_ppq_pos += n_values * m_tempo / (60. * m_mix_freq);
   m_process_callbacks = nullptr;
 
+  if (measure_time)
+    {
+      const uint64 ticks = DspProfile::ticks() - profile_start;
+
+      if (m_dsp_profile_enabled)
+        {
+          DspProfile::set_thread_profile (nullptr);
+
+          m_dsp_profile_ticks += ticks;
+          m_dsp_profile_samples += n_values;
+        }
+      if (m_voice_partial_budget)
+        update_partial_budget_scale (ticks, n_values);
+    }
   notify_active_voice_status();
 }
 
@@ -795,10 +1256,100 @@ MidiSynth::prepare_update (const MorphPlan& plan)
   return morph_plan_synth.prepare_update (plan);
 }
 
+MorphPlanSynth::UpdateP
+MidiSynth::prepare_pool_update (size_t pool_size)
+{
+  return morph_plan_synth.prepare_pool_update (pool_size);
+}
+
 void
 MidiSynth::apply_update (MorphPlanSynth::UpdateP update)
 {
+  if (update->pool)
+    {
+      /* voices without modules must not play (VoicePool only shrinks the pool if they are idle) */
+      bool need_free = false;
+      for (auto voice : active_voices)
+        {
+          if (size_t (voice - &voices[0]) >= update->pool_size && voice->state != Voice::STATE_IDLE)
+            {
+              voice->state = Voice::STATE_IDLE;
+              voice->pedal = false;
+              need_free = true;
+            }
+        }
+      if (need_free)
+        free_unused_voices();
+    }
   morph_plan_synth.apply_update (update);
+
+  if (update->pool)
+    m_voice_limit = morph_plan_synth.pool_size();
+}
+
+size_t
+MidiSynth::max_voices() const
+{
+  return voices.size();
+}
+
+/* number of voices that have modules (audio thread) */
+size_t
+MidiSynth::pool_size() const
+{
+  return morph_plan_synth.pool_size();
+}
+
+/* restrict voice allocation to voices [0, limit) (called before shrinking the pool) */
+void
+MidiSynth::set_voice_limit (size_t limit, uint serial)
+{
+  m_voice_limit = std::min (limit, morph_plan_synth.pool_size());
+  m_voice_limit_serial = serial;
+}
+
+/* voice pool that adapts the pool size of this MidiSynth (not rt safe, before synthesis starts) */
+void
+MidiSynth::set_voice_pool (VoicePool *voice_pool)
+{
+  m_voice_pool = voice_pool;
+}
+
+/* maximum number of voices needed since last call (called by VoicePool thread) */
+size_t
+MidiSynth::take_peak_voice_count()
+{
+  return m_pool_peak_voices.exchange (0);
+}
+
+/* true if no voice beyond the limit set with serial is active (called by VoicePool thread) */
+bool
+MidiSynth::voices_above_limit_idle (uint serial) const
+{
+  return m_pool_limit_status.load() == (uint64 (serial) << 32);
+}
+
+void
+MidiSynth::update_pool_status()
+{
+  /* notes waiting for a voice are counted, too, otherwise the pool would not grow beyond the
+   * number of voices available when a large chord is played
+   */
+  const int n_voices = active_voices.size() + m_deferred_notes.size();
+  if (n_voices > m_pool_peak_voices.load())
+    m_pool_peak_voices.store (n_voices);
+
+  uint64 n_above_limit = 0;
+  for (auto voice : active_voices)
+    {
+      if (size_t (voice - &voices[0]) >= m_voice_limit)
+        n_above_limit++;
+    }
+  m_pool_limit_status.store ((uint64 (m_voice_limit_serial) << 32) + n_above_limit);
+
+  /* don't wait for the next regular pool update if notes are waiting for voices */
+  if (m_voice_pool && !m_deferred_notes.empty() && morph_plan_synth.pool_size() < voices.size())
+    m_voice_pool->request_update();
 }
 
 void
@@ -825,6 +1376,7 @@ MidiSynth::inst_edit_synth()
   return &m_inst_edit_synth;
 }
 
+/* internal synthesis rate (differs from the host rate if upsampling is used) */
 double
 MidiSynth::mix_freq() const
 {
@@ -837,6 +1389,75 @@ MidiSynth::set_control_by_cc (bool control_by_cc)
   m_control_by_cc = control_by_cc;
 }
 
+/* Render voices using n_threads worker threads in addition to the synthesis
+ * thread; n_threads = 0 renders all voices in the synthesis thread.
+ *
+ * not rt safe, needs to be called when synthesis thread is not running
+ */
+void
+MidiSynth::set_render_threads (int n_threads)
+{
+  /* voices rendered by the render pool don't use the spectral mixer */
+  if (n_threads > 0)
+    detach_spectral_mixer();
+
+  m_render_pool.reset();
+  m_render_rt_memory_areas.clear();
+  m_render_dsp_profiles.clear();
+  m_render_samples.clear();
+  m_render_have_samples.clear();
+
+  if (n_threads > 0)
+    {
+      m_render_pool.reset (new RTWorkerPool (n_threads + 1));
+
+      /* thread_index 0 (synthesis thread) uses m_rt_memory_area */
+      for (int t = 0; t < n_threads; t++)
+        {
+          m_render_rt_memory_areas.emplace_back (new RTMemoryArea());
+          m_render_dsp_profiles.emplace_back (new DspProfile());
+        }
+
+      m_render_samples.resize (voices.size() * MAX_RENDER_VALUES);
+      m_render_have_samples.resize (voices.size());
+    }
+}
+
+/* Use one shared IFFT for all voices with aligned blocks (if possible).
+ *
+ * not rt safe, needs to be called when synthesis thread is not running
+ */
+void
+MidiSynth::set_spectral_mixing (bool spectral_mixing)
+{
+  detach_spectral_mixer();
+
+  if (spectral_mixing)
+    m_spectral_mixer.reset (new SpectralMixer (m_mix_freq));
+  else
+    m_spectral_mixer.reset();
+}
+
+/* blocks that voices have already added to the spectral mixer are moved back to the voices,
+ * so the spectral mixer can be deleted (or is no longer used)
+ */
+void
+MidiSynth::detach_spectral_mixer()
+{
+  for (auto& voice : voices)
+    {
+      MorphOutputModule *output_module = voice.mp_voice->output();
+      if (output_module)
+        output_module->set_spectral_mixer (nullptr, 0);
+    }
+}
+
+MorphCache *
+MidiSynth::morph_cache()
+{
+  return morph_plan_synth.morph_cache();
+}
+
 void
 MidiSynth::set_random_seed (int seed)
 {
@@ -884,10 +1505,139 @@ MidiSynth::notify_active_voice_status()
 
           m_notify_buffer.write_seq (control_input_seq, n_voices);
         }
+
+      /* partial culling disabled: empty sequence */
+      const uint n_culled_partials = m_voice_partial_budget ? n_voices : 0;
+
+      int culled_partials_seq[MAX_VOICES];
+      for (uint v = 0; v < n_culled_partials; v++)
+        culled_partials_seq[v] = voices[v]->mp_voice->output()->culled_partials();
+
+      m_notify_buffer.write_seq (culled_partials_seq, n_culled_partials);
+
+      if (m_dsp_profile_enabled)
+        notify_dsp_profile();
+
       m_notify_buffer.end_write();
     }
 }
 
+void
+MidiSynth::notify_dsp_profile()
+{
+  const double ticks_to_seconds = 1 / DspProfile::TICKS_PER_SECOND;
+
+  m_notify_buffer.write_int (DSP_PROFILE_EVENT);
+  m_notify_buffer.write_float (m_dsp_profile_samples / m_mix_freq);
+  m_notify_buffer.write_float (m_dsp_profile_ticks * ticks_to_seconds);
+
+  const size_t n_ops = m_dsp_profile.n_entries();
+
+  uintptr_t op_seq[DspProfile::MAX_ENTRIES];
+  for (size_t i = 0; i < n_ops; i++)
+    op_seq[i] = m_dsp_profile.entry (i).op;
+
+  m_notify_buffer.write_seq (op_seq, n_ops);
+
+  for (int c = 0; c < DspProfile::N_CATEGORIES; c++)
+    {
+      float time_seq[DspProfile::MAX_ENTRIES];
+
+      for (size_t i = 0; i < n_ops; i++)
+        time_seq[i] = m_dsp_profile.entry (i).ticks[c] * ticks_to_seconds;
+
+      m_notify_buffer.write_seq (time_seq, n_ops);
+    }
+
+  uintptr_t voice_seq[MAX_VOICES];
+  float     voice_time_seq[MAX_VOICES];
+  uint      n_voices = 0;
+  for (auto voice : active_voices)
+    {
+      if (voice->mono_type != Voice::MonoType::SHADOW)
+        {
+          voice_seq[n_voices] = (uintptr_t) voice->mp_voice;
+          voice_time_seq[n_voices] = voice->profile_ticks * ticks_to_seconds;
+          n_voices++;
+        }
+    }
+  m_notify_buffer.write_seq (voice_seq, n_voices);
+  m_notify_buffer.write_seq (voice_time_seq, n_voices);
+
+  /* start new measurement */
+  for (auto& voice : voices)
+    voice.profile_ticks = 0;
+
+  m_dsp_profile.clear();
+  m_dsp_profile_ticks = 0;
+  m_dsp_profile_samples = 0;
+}
+
+/* enable or disable DSP time instrumentation (see DspProfile) */
+void
+MidiSynth::set_dsp_profile (bool dsp_profile)
+{
+  m_dsp_profile_enabled = dsp_profile;
+
+  m_dsp_profile.clear();
+  for (auto& profile : m_render_dsp_profiles)
+    profile->clear();
+  for (auto& voice : voices)
+    voice.profile_ticks = 0;
+
+  m_dsp_profile_ticks = 0;
+  m_dsp_profile_samples = 0;
+}
+
+/* distribute the partial budget of the synth evenly among the voices that are rendered */
+void
+MidiSynth::update_voice_partial_budget()
+{
+  const size_t partial_budget = voices[0].mp_voice->output()->partial_budget();
+
+  m_voice_partial_budget = 0;
+  if (partial_budget)
+    {
+      size_t n_render_voices = 0;
+      for (auto voice : active_voices)
+        {
+          if (voice->mono_type != Voice::MonoType::SHADOW)
+            n_render_voices++;
+        }
+      m_voice_partial_budget = max<size_t> (partial_budget * m_partial_budget_scale / max<size_t> (n_render_voices, 1), 1);
+    }
+  else
+    {
+      m_partial_budget_scale = 1;
+      m_partial_budget_ticks = 0;
+      m_partial_budget_samples = 0;
+    }
+}
+
+/* adapt the partial budget to the measured synthesis load: if synthesis needs more than
+ * PARTIAL_BUDGET_MAX_LOAD of the audio time, the budget is reduced quickly, otherwise it
+ * slowly returns to the configured budget
+ */
+void
+MidiSynth::update_partial_budget_scale (uint64 ticks, size_t n_values)
+{
+  m_partial_budget_ticks += ticks;
+  m_partial_budget_samples += n_values;
+
+  const double audio_time = m_partial_budget_samples / m_mix_freq;
+  if (audio_time * 1000 < PARTIAL_BUDGET_UPDATE_MS)
+    return;
+
+  const double load = m_partial_budget_ticks / DspProfile::TICKS_PER_SECOND / audio_time;
+  if (load > PARTIAL_BUDGET_MAX_LOAD)
+    m_partial_budget_scale = max (m_partial_budget_scale * 0.8, PARTIAL_BUDGET_MIN_SCALE);
+  else if (load < PARTIAL_BUDGET_MAX_LOAD * 0.8)
+    m_partial_budget_scale = min (m_partial_budget_scale * 1.05, 1.0);
+
+  m_partial_budget_ticks = 0;
+  m_partial_budget_samples = 0;
+}
+
 NotifyBuffer *
 MidiSynth::notify_buffer()
 {
@@ -905,6 +1655,7 @@ SynthNotifyEvent::create (NotifyBuffer& buffer)
       case INST_EDIT_VOICE_EVENT:     return new InstEditVoiceEvent (buffer);
       case VOICE_OP_VALUES_EVENT:     return new VoiceOpValuesEvent (buffer);
       case ACTIVE_VOICE_STATUS_EVENT: return new ActiveVoiceStatusEvent (buffer);
+      case DSP_PROFILE_EVENT:         return new DspProfileEvent (buffer);
       default:                        printf ("unsupported SynthNotifyEvent %d\n", type);
     }
   return nullptr;
@@ -7,11 +7,18 @@
 #include "smnotifybuffer.hh"
 #include "sminsteditsynth.hh"
 #include "smrtmemory.hh"
+#include "smrtworkerpool.hh"
+#include "smspectralmixer.hh"
+#include "smdspprofile.hh"
+#include "smpandaresampler.hh"
 
 #include <array>
+#include <atomic>
 
 namespace SpectMorph {
 
+class VoicePool;
+
 struct MidiSynthCallbacks
 {
   struct TerminatedVoice
@@ -129,6 +136,9 @@ private:
     int          pitch_bend_steps;
     int          note_id;
     int          clap_id;
+    int          steal_fade_pos = 0; // remaining samples of fade out (stolen voice)
+    int          steal_fade_len = 0;
+    uint64       profile_ticks = 0;  // render time since last DSP profile notification
 
     ControlArray modulation {};
 
@@ -145,6 +155,18 @@ private:
   };
 
   constexpr static int  MAX_VOICES = 256;
+  constexpr static int  MAX_RENDER_VALUES = 4096; // larger blocks are not rendered in parallel
+  constexpr static double STEAL_FADE_MS = 5;      // fade out time for stolen voices
+  constexpr static double PARTIAL_BUDGET_MAX_LOAD = 0.5;   // reduce partial budget above this synthesis load
+  constexpr static double PARTIAL_BUDGET_MIN_SCALE = 0.1;  // never reduce partial budget below 10%
+  constexpr static double PARTIAL_BUDGET_UPDATE_MS = 10;   // measure synthesis load over at least 10 ms
+
+  /* note on events that are waiting for a voice (pool growing / stolen voice fading out) */
+  struct DeferredNote
+  {
+    NoteEvent note;
+    bool      released = false;
+  };
 
   MorphPlanSynth        morph_plan_synth;
   InstEditSynth         m_inst_edit_synth;
@@ -152,8 +174,16 @@ private:
   std::vector<Voice>    voices;
   std::vector<Voice *>  idle_voices;
   std::vector<Voice *>  active_voices;
+  size_t                m_voice_limit = 0;   // voices [m_voice_limit, pool size) are only allocated if all others are busy
+  uint                  m_voice_limit_serial = 0;
+  std::vector<DeferredNote> m_deferred_notes;
+
+  /* voice pool status, written by synthesis thread, read by VoicePool */
+  std::atomic<int>      m_pool_peak_voices { 0 }; // voice demand: active + deferred voices
+  std::atomic<uint64>   m_pool_limit_status { 0 }; // (limit serial << 32) + number of active voices above limit
+  VoicePool            *m_voice_pool = nullptr;
   ControlArray          global_modulation {};
-  double                m_mix_freq;
+  double                m_mix_freq;          // internal synthesis rate
   double                m_gain = 1;
   double                m_tempo = 120;
   double                m_ppq_pos = 0;
@@ -169,18 +199,61 @@ private:
   NotifyBuffer          m_notify_buffer;
   MidiSynthCallbacks   *m_process_callbacks = nullptr;
 
+  // multi-threaded voice rendering
+  std::unique_ptr<RTWorkerPool>              m_render_pool;
+  std::vector<std::unique_ptr<RTMemoryArea>> m_render_rt_memory_areas;
+  std::vector<float>                         m_render_samples;
+  std::vector<char>                          m_render_have_samples;
+
+  std::unique_ptr<SpectralMixer>             m_spectral_mixer;
+
+  // DSP time instrumentation (accumulated until the GUI fetches the next notify events)
+  bool                                       m_dsp_profile_enabled = false;
+  DspProfile                                 m_dsp_profile;
+  std::vector<std::unique_ptr<DspProfile>>   m_render_dsp_profiles;
+  uint64                                     m_dsp_profile_ticks = 0;
+  uint64                                     m_dsp_profile_samples = 0;
+
+  /* fixed internal rate: synthesize at host rate / m_upsample_factor, upsample the mix */
+  uint                                             m_upsample_factor = 1;
+  std::unique_ptr<PandaResampler::Resampler2>      m_upsampler;
+  std::vector<float>                               m_internal_samples;
+  std::vector<float>                               m_upsample_buffer;
+  size_t                                           m_upsample_buffer_pos = 0;
+  size_t                                           m_upsample_buffer_len = 0;
+  std::vector<Event>                               m_later_events;
+
+  // partial culling: the budget is scaled down if the synthesis load is too high
+  size_t                m_voice_partial_budget = 0;
+  double                m_partial_budget_scale = 1;
+  uint64                m_partial_budget_ticks = 0;
+  uint64                m_partial_budget_samples = 0;
+
   std::vector<float>    control = std::vector<float> (MorphPlan::N_CONTROL_INPUTS);
 
   Voice  *alloc_voice();
+  Voice  *steal_voice();
+  size_t  idle_pool_voices() const;
+  void    start_deferred_notes();
   void    free_unused_voices();
+  void    update_pool_status();
   bool    update_mono_voice();
   float   freq_from_note (float note);
   void    notify_active_voice_status();
+  void    notify_dsp_profile();
+  void    update_voice_partial_budget();
+  void    update_partial_budget_scale (uint64 ticks, size_t n_values);
   float   voice_control (const Voice *voice, int c);
 
   void set_mono_enabled (bool new_value);
+  bool render_voice (Voice *voice, RTMemoryArea& rt_memory_area, SpectralMixer *spectral_mixer, float *samples, size_t n_values);
+  void detach_spectral_mixer();
+  void process_block (float *output, size_t n_values, MidiSynthCallbacks *process_callbacks);
   void process_audio (float *output, size_t n_values);
+  bool is_control_event (const Event& event) const;
+  void process_control_event (const Event& event, uint render_offset);
   void process_note_on (const NoteEvent& note);
+  bool start_note (const NoteEvent& note);
   void process_note_off (int channel, int midi_note);
   void process_midi_controller (int channel, int controller, int value);
   void process_pitch_bend (int channel, float value);
@@ -190,7 +263,9 @@ private:
   void sort_events_stable();
 
 public:
-  MidiSynth (double mix_freq, size_t n_voices);
+  MidiSynth (double mix_freq, size_t n_voices, size_t pool_size = 0, bool fixed_internal_rate = false);
+
+  static uint upsample_factor (double mix_freq, bool fixed_internal_rate);
 
   void add_midi_event (size_t offset, const unsigned char *midi_data) noexcept SM_CLANG_NONBLOCKING;
   void process (float *output, size_t n_values, MidiSynthCallbacks *process_callbacks = nullptr) noexcept SM_CLANG_NONBLOCKING;
@@ -206,8 +281,17 @@ public:
   void set_tempo (double tempo) noexcept SM_CLANG_NONBLOCKING;
   void set_ppq_pos (double ppq_pos) noexcept SM_CLANG_NONBLOCKING;
   MorphPlanSynth::UpdateP prepare_update (const MorphPlan& plan);
+  MorphPlanSynth::UpdateP prepare_pool_update (size_t pool_size);
   void apply_update (MorphPlanSynth::UpdateP update);
+
+  size_t max_voices() const;
+  size_t pool_size() const;
+  void   set_voice_pool (VoicePool *voice_pool);
+  void   set_voice_limit (size_t limit, uint serial);
+  size_t take_peak_voice_count();
+  bool   voices_above_limit_idle (uint serial) const;
   double mix_freq() const;
+  uint   latency() const;
 
   size_t active_voice_count() const;
 
@@ -215,8 +299,12 @@ public:
   void set_gain (double gain);
   void set_random_seed (int seed);
   void set_control_by_cc (bool control_by_cc);
+  void set_render_threads (int n_threads);
+  void set_spectral_mixing (bool spectral_mixing);
+  void set_dsp_profile (bool dsp_profile);
   InstEditSynth *inst_edit_synth();
   NotifyBuffer *notify_buffer();
+  MorphCache *morph_cache();
 };
 
 class SynthNotifyEvent
@@ -234,7 +322,8 @@ enum NotifyEventType
 {
   INST_EDIT_VOICE_EVENT = 748293, // some random number
   VOICE_OP_VALUES_EVENT,
-  ACTIVE_VOICE_STATUS_EVENT
+  ACTIVE_VOICE_STATUS_EVENT,
+  DSP_PROFILE_EVENT
 };
 
 struct InstEditVoiceEvent : public SynthNotifyEvent
@@ -278,10 +367,32 @@ struct ActiveVoiceStatusEvent : public SynthNotifyEvent
   {
     for (auto& ctrl : control)
       ctrl = buffer.read_seq<float>();
+    culled_partials = buffer.read_seq<int>();
   }
   std::vector<uintptr_t> voice;
   std::vector<float>     velocity;
   std::vector<float>     control[MorphPlan::N_CONTROL_INPUTS];
+  std::vector<int>       culled_partials; // empty if partial culling is disabled
+};
+
+struct DspProfileEvent : public SynthNotifyEvent
+{
+  DspProfileEvent (NotifyBuffer& buffer) :
+    audio_time (buffer.read_float()),
+    synth_time (buffer.read_float()),
+    ops (buffer.read_seq<uintptr_t>())
+  {
+    for (auto& time : op_time)
+      time = buffer.read_seq<float>();
+    voices = buffer.read_seq<uintptr_t>();
+    voice_time = buffer.read_seq<float>();
+  }
+  float                  audio_time;   // seconds of audio rendered
+  float                  synth_time;   // seconds spent in MidiSynth::process
+  std::vector<uintptr_t> ops;          // MorphOperator::PtrID
+  std::vector<float>     op_time[DspProfile::N_CATEGORIES]; // seconds per operator and category
+  std::vector<uintptr_t> voices;       // MorphPlanVoice
+  std::vector<float>     voice_time;   // seconds per voice
 };
 
 }
@@ -30,6 +30,9 @@ ModulationList::main_control_op() const
 void
 ModulationList::set_main_control_type_and_op (MorphOperator::ControlType type, MorphOperator *op)
 {
+  if (type == data.main_control_type && op == data.main_control_op.get())
+    return;
+
   data.main_control_type = type;
   data.main_control_op.set (op);
 
@@ -55,6 +58,11 @@ ModulationList::add_entry()
 void
 ModulationList::update_entry (size_t index, ModulationData::Entry& new_entry)
 {
+  const auto& entry = data.entries[index];
+  if (entry.control_type == new_entry.control_type && entry.control_op.get() == new_entry.control_op.get() &&
+      entry.bipolar == new_entry.bipolar && entry.amount == new_entry.amount)
+    return;
+
   data.entries[index] = new_entry;
   signal_modulation_changed();
 }
@@ -25,11 +25,13 @@ public:
 
   MorphOperator::ControlType    main_control_type = MorphOperator::CONTROL_GUI;
   MorphOperatorPtr              main_control_op;
+  int                           main_control_slot = -1; // index of main_control_op in the voice control slots (synthesis)
 
   struct Entry
   {
     MorphOperator::ControlType  control_type = MorphOperator::CONTROL_SIGNAL_1;
     MorphOperatorPtr            control_op;
+    int                         control_slot = -1;      // index of control_op in the voice control slots (synthesis)
 
     bool                        bipolar = false;
     double                      amount = 0;
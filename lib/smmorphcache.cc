@@ -0,0 +1,111 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmorphcache.hh"
+
+using namespace SpectMorph;
+
+bool
+MorphCache::Key::add_source (LiveDecoderSource *source)
+{
+  g_return_val_if_fail (n_sources < MAX_SOURCES, false);
+
+  const void *id = nullptr;
+  if (source)
+    {
+      id = source->block_cache_id();
+      if (!id) // source output depends on more than the block index
+        return false;
+    }
+  sources[n_sources++] = id;
+  return true;
+}
+
+bool
+MorphCache::Key::operator== (const Key& other) const
+{
+  return op == other.op && index == other.index && mode == other.mode && morphing == other.morphing &&
+         n_sources == other.n_sources && sources == other.sources;
+}
+
+MorphCache::MorphCache()
+{
+  entries.reserve (MAX_ENTRIES);
+}
+
+void
+MorphCache::new_block (bool enabled)
+{
+  entries.clear();
+  memory_area.free_all();
+
+  m_enabled = enabled;
+}
+
+bool
+MorphCache::enabled() const
+{
+  return m_enabled;
+}
+
+bool
+MorphCache::lookup (const Key& key, RTAudioBlock& out_block, bool& have_block)
+{
+  for (const auto& entry : entries)
+    {
+      if (entry.key == key)
+        {
+          have_block = entry.have_block;
+          if (have_block)
+            {
+              out_block.freqs.borrow (entry.freqs, entry.n_partials);
+              out_block.mags.borrow (entry.mags, entry.n_partials);
+              out_block.noise.borrow (entry.noise, entry.n_noise);
+            }
+          m_hits++;
+          return true;
+        }
+    }
+  m_misses++;
+  return false;
+}
+
+const uint16_t *
+MorphCache::copy_data (const RTVector<uint16_t>& vec)
+{
+  uint16_t *data = (uint16_t *) memory_area.alloc (sizeof (uint16_t) * vec.size());
+  std::copy (vec.data(), vec.data() + vec.size(), data);
+  return data;
+}
+
+void
+MorphCache::store (const Key& key, bool have_block, const RTAudioBlock& block)
+{
+  if (entries.size() == MAX_ENTRIES)
+    return;
+
+  Entry& entry = entries.emplace_back();
+  entry.key = key;
+  entry.have_block = have_block;
+  if (have_block)
+    {
+      assert (block.freqs.size() == block.mags.size());
+
+      entry.freqs = copy_data (block.freqs);
+      entry.mags = copy_data (block.mags);
+      entry.noise = copy_data (block.noise);
+      entry.n_partials = block.freqs.size();
+      entry.n_noise = block.noise.size();
+    }
+}
+
+uint64_t
+MorphCache::hits() const
+{
+  return m_hits;
+}
+
+uint64_t
+MorphCache::misses() const
+{
+  return m_misses;
+}
@@ -0,0 +1,74 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smrtmemory.hh"
+#include "smlivedecodersource.hh"
+
+#include <array>
+
+namespace SpectMorph
+{
+
+/*
+ * MorphCache allows voices to share morph results: if several voices morph the
+ * same source frames with the same morphing parameters (for instance a chord
+ * played with a GUI controlled morph), only the first voice computes the morph,
+ * and the other voices borrow the result read-only.
+ *
+ * The cache only lives for one synth block: the synth calls new_block() before
+ * processing the voices, which drops all entries. It must only be used if all
+ * voices are rendered by the synthesis thread.
+ */
+class MorphCache
+{
+  SPECTMORPH_CLASS_NON_COPYABLE (MorphCache);
+public:
+  static constexpr size_t MAX_SOURCES = 4;
+
+  struct Key
+  {
+    const void                           *op = nullptr;   // operator config
+    std::array<const void *, MAX_SOURCES> sources {};     // LiveDecoderSource::block_cache_id() of the inputs
+    size_t                                n_sources = 0;
+    size_t                                index = 0;
+    std::array<double, 2>                 morphing {};
+    int                                   mode = 0;
+
+    bool add_source (LiveDecoderSource *source);
+    bool operator== (const Key& other) const;
+  };
+private:
+  static constexpr size_t MAX_ENTRIES = 256;
+
+  struct Entry
+  {
+    Key             key;
+    bool            have_block = false;
+    const uint16_t *freqs = nullptr;
+    const uint16_t *mags = nullptr;
+    const uint16_t *noise = nullptr;
+    size_t          n_partials = 0;
+    size_t          n_noise = 0;
+  };
+  std::vector<Entry> entries;
+  RTMemoryArea       memory_area;
+  bool               m_enabled = false;
+  uint64_t           m_hits = 0;
+  uint64_t           m_misses = 0;
+
+  const uint16_t *copy_data (const RTVector<uint16_t>& vec);
+public:
+  MorphCache();
+
+  void new_block (bool enabled);
+  bool enabled() const;
+
+  bool lookup (const Key& key, RTAudioBlock& out_block, bool& have_block);
+  void store (const Key& key, bool have_block, const RTAudioBlock& block);
+
+  uint64_t hits() const;
+  uint64_t misses() const;
+};
+
+}
@@ -174,6 +174,9 @@ MorphGrid::output_type()
 void
 MorphGrid::set_width (int width)
 {
+  if (m_config.width == width)
+    return;
+
   m_config.width = width;
   update_size();
 
@@ -189,6 +192,9 @@ MorphGrid::width()
 void
 MorphGrid::set_height (int height)
 {
+  if (m_config.height == height)
+    return;
+
   m_config.height = height;
   update_size();
 
@@ -204,6 +210,9 @@ MorphGrid::height()
 void
 MorphGrid::set_selected_x (int x)
 {
+  if (m_selected_x == x)
+    return;
+
   m_selected_x = x;
 
   m_morph_plan->emit_plan_changed();
@@ -218,6 +227,9 @@ MorphGrid::selected_x()
 void
 MorphGrid::set_selected_y (int y)
 {
+  if (m_selected_y == y)
+    return;
+
   m_selected_y = y;
 
   m_morph_plan->emit_plan_changed();
@@ -259,6 +271,10 @@ MorphGrid::set_input_node (int x, int y, const MorphGridNode& node)
   g_return_if_fail (y >= 0 && y < m_config.height);
   g_return_if_fail (node.smset == "" || !node.op);  // should not set both
 
+  const auto& old_node = m_config.input_node[x][y];
+  if (old_node.op.get() == node.op.get() && old_node.smset == node.smset && old_node.delta_db == node.delta_db)
+    return;
+
   m_config.input_node[x][y] = node;
   m_morph_plan->emit_plan_changed();
 }
@@ -266,6 +282,9 @@ MorphGrid::set_input_node (int x, int y, const MorphGridNode& node)
 void
 MorphGrid::set_zoom (int z)
 {
+  if (m_zoom == z)
+    return;
+
   m_zoom = z;
   m_morph_plan->emit_plan_changed();
 }
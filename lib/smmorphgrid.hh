@@ -36,6 +36,13 @@ public:
     ModulationData    y_morphing_mod;
 
     std::vector< std::vector<MorphGridNode> > input_node;
+
+    void
+    get_modulation_data (std::vector<ModulationData *>& mod_data) override
+    {
+      mod_data.push_back (&x_morphing_mod);
+      mod_data.push_back (&y_morphing_mod);
+    }
   };
   static constexpr auto P_X_MORPHING = "x_morphing";
   static constexpr auto P_Y_MORPHING = "y_morphing";
@@ -6,6 +6,7 @@
 #include "smmath.hh"
 #include "smlivedecoder.hh"
 #include "smmorphutils.hh"
+#include "smdspprofile.hh"
 
 #include <assert.h>
 
@@ -28,6 +29,11 @@ MorphGridModule::MorphGridModule (MorphPlanVoice *voice) :
   audio.frame_step_ms        = 1;
   audio.zeropad              = 4;
   audio.loop_type            = Audio::LOOP_NONE;
+
+  // reserve memory here, so that storing the last result doesn't allocate memory
+  last_result.freqs.reserve (LastResult::MAX_PARTIALS);
+  last_result.mags.reserve (LastResult::MAX_PARTIALS);
+  last_result.noise.reserve (Audio::N_NOISE_BANDS);
 }
 
 void
@@ -36,6 +42,8 @@ MorphGridModule::set_config (const MorphOperatorConfig *op_cfg)
   cfg = dynamic_cast<const MorphGrid::Config *> (op_cfg);
   g_return_if_fail (cfg != NULL);
 
+  last_result.valid = false;
+
   for (int x = 0; x < cfg->width; x++)
     {
       for (int y = 0; y < cfg->height; y++)
@@ -62,6 +70,8 @@ MorphGridModule::set_config (const MorphOperatorConfig *op_cfg)
 void
 MorphGridModule::MySource::retrigger (int channel, float freq, int midi_velocity)
 {
+  module->last_result.valid = false;
+
   for (int x = 0; x < module->cfg->width; x++)
     {
       for (int y = 0; y < module->cfg->height; y++)
@@ -107,8 +117,8 @@ MorphGridModule::MySource::audio()
   return &module->audio;
 }
 
-static bool
-get_normalized_block (MorphGridModule::InputNode& input_node, size_t index, RTAudioBlock& out_audio_block)
+static LiveDecoderSource *
+node_source (MorphGridModule::InputNode& input_node)
 {
   LiveDecoderSource *source = NULL;
 
@@ -120,9 +130,15 @@ get_normalized_block (MorphGridModule::InputNode& input_node, size_t index, RTAu
     {
       source = &input_node.source;
     }
+  return source;
+}
+
+static bool
+get_normalized_block (MorphGridModule::InputNode& input_node, size_t index, RTAudioBlock& out_audio_block)
+{
   const double time_ms = index; // 1ms frame step
 
-  return MorphUtils::get_normalized_block (source, time_ms, out_audio_block);
+  return MorphUtils::get_normalized_block (node_source (input_node), time_ms, out_audio_block);
 }
 
 namespace
@@ -165,21 +181,147 @@ apply_delta_db (RTAudioBlock& block, double delta_db)
   const double factor = db_to_factor (delta_db);
   const int    ddb    = sm_factor2delta_idb (factor);
 
+  if (ddb == 0) // avoid copying borrowed (read-only) block data
+    return;
+
   // apply delta db volume to partials & noise
+  uint16_t *mags = block.mags.data_writable();
   for (size_t i = 0; i < block.mags.size(); i++)
-    block.mags[i] = std::clamp (block.mags[i] + ddb, 0, 65535);
+    mags[i] = std::clamp (mags[i] + ddb, 0, 65535);
 
+  uint16_t *noise = block.noise.data_writable();
   for (size_t i = 0; i < block.noise.size(); i++)
-    block.noise[i] = std::clamp (block.noise[i] + ddb, 0, 65535);
+    noise[i] = std::clamp (noise[i] + ddb, 0, 65535);
+}
+
+}
+
+bool
+MorphGridModule::LastResult::Key::operator== (const Key& other) const
+{
+  return x_morphing == other.x_morphing && y_morphing == other.y_morphing &&
+         sources == other.sources && frame_index == other.frame_index;
+}
+
+/* the output only depends on the key if all inputs are plain sources (see LiveDecoderSource::block_cache_id) */
+bool
+MorphGridModule::last_result_key (size_t index, double x_morphing, double y_morphing, LastResult::Key& key)
+{
+  const LocalMorphParams x_morph_params = global_to_local_params (x_morphing, cfg->width);
+  const LocalMorphParams y_morph_params = global_to_local_params (y_morphing, cfg->height);
+
+  key.x_morphing = x_morphing;
+  key.y_morphing = y_morphing;
+
+  size_t n = 0;
+  for (int x : { x_morph_params.start, x_morph_params.end })
+    {
+      for (int y : { y_morph_params.start, y_morph_params.end })
+        {
+          LiveDecoderSource *source = node_source (input_nodes (x, y));
+          Audio *source_audio = nullptr;
+          if (source)
+            {
+              key.sources[n] = source->block_cache_id();
+              if (!key.sources[n])
+                return false;
+
+              source_audio = source->audio();
+            }
+          const double time_ms = index; // 1ms frame step
+          key.frame_index[n] = source_audio ? MorphUtils::get_normalized_block_index (source_audio, time_ms) : -1;
+          n++;
+        }
+    }
+  return true;
 }
 
+void
+MorphGridModule::store_last_result (const LastResult::Key& key, bool have_block, const RTAudioBlock& block)
+{
+  if (have_block && (block.freqs.size() > LastResult::MAX_PARTIALS || block.noise.size() > Audio::N_NOISE_BANDS))
+    {
+      last_result.valid = false;
+      return;
+    }
+  last_result.valid = true;
+  last_result.key = key;
+  last_result.have_block = have_block;
+  if (have_block)
+    {
+      last_result.freqs.assign (block.freqs.data(), block.freqs.data() + block.freqs.size());
+      last_result.mags.assign (block.mags.data(), block.mags.data() + block.mags.size());
+      last_result.noise.assign (block.noise.data(), block.noise.data() + block.noise.size());
+    }
 }
 
 bool
 MorphGridModule::MySource::rt_audio_block (size_t index, RTAudioBlock& out_block)
 {
+  DspProfile::Scope profile_scope (DspProfile::OPERATOR, module->m_ptr_id);
+
   const double x_morphing = module->apply_modulation (module->cfg->x_morphing_mod);
   const double y_morphing = module->apply_modulation (module->cfg->y_morphing_mod);
+
+  /* sustained notes (for instance frame loops) often need exactly the same output as last time */
+  LastResult::Key last_key;
+  const bool use_last_result = module->last_result_key (index, x_morphing, y_morphing, last_key);
+  if (use_last_result && module->last_result.valid && module->last_result.key == last_key)
+    {
+      if (module->last_result.have_block)
+        {
+          out_block.freqs.borrow (module->last_result.freqs);
+          out_block.mags.borrow (module->last_result.mags);
+          out_block.noise.borrow (module->last_result.noise);
+        }
+      return module->last_result.have_block;
+    }
+  const bool have_block = cached_morph_nodes (index, x_morphing, y_morphing, out_block);
+
+  if (use_last_result)
+    module->store_last_result (last_key, have_block, out_block);
+  else
+    module->last_result.valid = false;
+
+  return have_block;
+}
+
+bool
+MorphGridModule::MySource::cached_morph_nodes (size_t index, double x_morphing, double y_morphing, RTAudioBlock& out_block)
+{
+  /* other voices may have computed the same morph during this block */
+  MorphCache *morph_cache = module->morph_cache();
+  MorphCache::Key cache_key;
+  bool use_cache = morph_cache->enabled();
+  if (use_cache)
+    {
+      const LocalMorphParams x_morph_params = global_to_local_params (x_morphing, module->cfg->width);
+      const LocalMorphParams y_morph_params = global_to_local_params (y_morphing, module->cfg->height);
+
+      cache_key.op = module->cfg;
+      cache_key.index = index;
+      cache_key.morphing = { x_morphing, y_morphing };
+
+      for (int x : { x_morph_params.start, x_morph_params.end })
+        for (int y : { y_morph_params.start, y_morph_params.end })
+          use_cache = use_cache && cache_key.add_source (node_source (module->input_nodes (x, y)));
+    }
+  if (use_cache)
+    {
+      bool have_block;
+      if (morph_cache->lookup (cache_key, out_block, have_block))
+        return have_block;
+
+      have_block = morph_nodes (index, x_morphing, y_morphing, out_block);
+      morph_cache->store (cache_key, have_block, out_block);
+      return have_block;
+    }
+  return morph_nodes (index, x_morphing, y_morphing, out_block);
+}
+
+bool
+MorphGridModule::MySource::morph_nodes (size_t index, double x_morphing, double y_morphing, RTAudioBlock& out_block)
+{
   const MorphUtils::MorphMode morph_mode = MorphUtils::MorphMode::DB_LINEAR;
 
   const LocalMorphParams x_morph_params = global_to_local_params (x_morphing, module->cfg->width);
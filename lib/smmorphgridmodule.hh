@@ -44,6 +44,31 @@ private:
   // output
   Audio               audio;
 
+  /* last output, which can be reused as long as controls and input frames don't change */
+  struct LastResult
+  {
+    static constexpr size_t MAX_PARTIALS = 1024;
+
+    struct Key
+    {
+      double                      x_morphing = 0;
+      double                      y_morphing = 0;
+      std::array<const void *, 4> sources {};
+      std::array<int, 4>          frame_index {};
+
+      bool operator== (const Key& other) const;
+    };
+    bool                  valid = false;
+    Key                   key;
+    bool                  have_block = false;
+    std::vector<uint16_t> freqs;
+    std::vector<uint16_t> mags;
+    std::vector<uint16_t> noise;
+  } last_result;
+
+  bool last_result_key (size_t index, double x_morphing, double y_morphing, LastResult::Key& key);
+  void store_last_result (const LastResult::Key& key, bool have_block, const RTAudioBlock& block);
+
   struct MySource : public LiveDecoderSource
   {
     MorphGridModule  *module;
@@ -52,6 +77,8 @@ private:
     void set_portamento_freq (float freq) override;
     Audio* audio() override;
     bool rt_audio_block (size_t index, RTAudioBlock& out_block) override;
+    bool cached_morph_nodes (size_t index, double x_morphing, double y_morphing, RTAudioBlock& out_block);
+    bool morph_nodes (size_t index, double x_morphing, double y_morphing, RTAudioBlock& out_block);
   } my_source;
 
 public:
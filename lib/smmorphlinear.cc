@@ -152,6 +152,9 @@ MorphLinear::right_op()
 void
 MorphLinear::set_left_op (MorphOperator *op)
 {
+  if (m_config.left_op.get() == op)
+    return;
+
   m_config.left_op.set (op);
 
   m_morph_plan->emit_plan_changed();
@@ -160,6 +163,9 @@ MorphLinear::set_left_op (MorphOperator *op)
 void
 MorphLinear::set_right_op (MorphOperator *op)
 {
+  if (m_config.right_op.get() == op)
+    return;
+
   m_config.right_op.set (op);
 
   m_morph_plan->emit_plan_changed();
@@ -180,6 +186,9 @@ MorphLinear::right_smset()
 void
 MorphLinear::set_left_smset (const string& smset)
 {
+  if (m_left_smset == smset)
+    return;
+
   m_left_smset = smset;
 
   m_morph_plan->emit_plan_changed();
@@ -188,6 +197,9 @@ MorphLinear::set_left_smset (const string& smset)
 void
 MorphLinear::set_right_smset (const string& smset)
 {
+  if (m_right_smset == smset)
+    return;
+
   m_right_smset = smset;
 
   m_morph_plan->emit_plan_changed();
@@ -209,6 +221,9 @@ MorphLinear::db_linear()
 void
 MorphLinear::set_db_linear (bool dbl)
 {
+  if (m_config.db_linear == dbl)
+    return;
+
   m_config.db_linear = dbl;
 
   m_morph_plan->emit_plan_changed();
@@ -25,6 +25,12 @@ public:
 
     ModulationData   morphing_mod;
     bool             db_linear;
+
+    void
+    get_modulation_data (std::vector<ModulationData *>& mod_data) override
+    {
+      mod_data.push_back (&morphing_mod);
+    }
   };
   static constexpr auto P_MORPHING = "morphing";
 protected:
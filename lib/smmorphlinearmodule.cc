@@ -9,6 +9,7 @@
 #include "smmorphutils.hh"
 #include "smutils.hh"
 #include "smrtmemory.hh"
+#include "smdspprofile.hh"
 #include <glib.h>
 #include <assert.h>
 
@@ -102,36 +103,56 @@ MorphLinearModule::MySource::audio()
 bool
 MorphLinearModule::MySource::rt_audio_block (size_t index, RTAudioBlock& out_audio_block)
 {
+  DspProfile::Scope profile_scope (DspProfile::OPERATOR, module->m_ptr_id);
+
   bool have_left = false, have_right = false;
 
   const double morphing = module->apply_modulation (module->cfg->morphing_mod);
   const double time_ms = index; // 1ms frame step
   const auto   morph_mode = module->cfg->db_linear ? MorphUtils::MorphMode::DB_LINEAR : MorphUtils::MorphMode::LINEAR;
 
-  RTAudioBlock left_block (module->rt_memory_area()), right_block (module->rt_memory_area());
-
-  if (module->left_mod && module->left_mod->source())
-    {
-      have_left = MorphUtils::get_normalized_block (module->left_mod->source(), time_ms, left_block);
-    }
-
-  if (module->right_mod && module->right_mod->source())
-    {
-      have_right = MorphUtils::get_normalized_block (module->right_mod->source(), time_ms, right_block);
-    }
+  LiveDecoderSource *left_source = nullptr;
+  LiveDecoderSource *right_source = nullptr;
 
+  if (module->left_mod)
+    left_source = module->left_mod->source();
   if (module->have_left_source)
-    {
-      have_left = MorphUtils::get_normalized_block (&module->left_source, time_ms, left_block);
-    }
+    left_source = &module->left_source;
 
+  if (module->right_mod)
+    right_source = module->right_mod->source();
   if (module->have_right_source)
+    right_source = &module->right_source;
+
+  /* other voices may have computed the same morph during this block */
+  MorphCache *morph_cache = module->morph_cache();
+  MorphCache::Key cache_key;
+  bool use_cache = morph_cache->enabled() && cache_key.add_source (left_source) && cache_key.add_source (right_source);
+  if (use_cache)
     {
-      have_right = MorphUtils::get_normalized_block (&module->right_source, time_ms, right_block);
+      cache_key.op = module->cfg;
+      cache_key.index = index;
+      cache_key.morphing[0] = morphing;
+      cache_key.mode = int (morph_mode);
+
+      bool have_block;
+      if (morph_cache->lookup (cache_key, out_audio_block, have_block))
+        return have_block;
     }
 
-  return MorphUtils::morph (out_audio_block, have_left, left_block, have_right, right_block, morphing, morph_mode);
+  RTAudioBlock left_block (module->rt_memory_area()), right_block (module->rt_memory_area());
+
+  if (left_source)
+    have_left = MorphUtils::get_normalized_block (left_source, time_ms, left_block);
+
+  if (right_source)
+    have_right = MorphUtils::get_normalized_block (right_source, time_ms, right_block);
+
+  bool have_block = MorphUtils::morph (out_audio_block, have_left, left_block, have_right, right_block, morphing, morph_mode);
+  if (use_cache)
+    morph_cache->store (cache_key, have_block, out_audio_block);
 
+  return have_block;
 }
 
 LiveDecoderSource *
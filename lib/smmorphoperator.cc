@@ -269,6 +269,11 @@ MorphOperatorConfig::~MorphOperatorConfig()
 {
 }
 
+void
+MorphOperatorConfig::get_modulation_data (vector<ModulationData *>& mod_data)
+{
+}
+
 #include "smmorphoutput.hh"
 #include "smmorphlinear.hh"
 #include "smmorphgrid.hh"
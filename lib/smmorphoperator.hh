@@ -14,9 +14,14 @@
 namespace SpectMorph
 {
 
+class ModulationData;
+
 struct MorphOperatorConfig
 {
   virtual ~MorphOperatorConfig();
+
+  /* modulation inputs of the operator (used to resolve control operators to control slots) */
+  virtual void get_modulation_data (std::vector<ModulationData *>& mod_data);
 };
 
 class MorphOperatorView;
@@ -97,6 +97,12 @@ MorphOperatorModule::rt_memory_area() const
   return output->rt_memory_area();
 }
 
+MorphCache *
+MorphOperatorModule::morph_cache() const
+{
+  return morph_plan_voice->morph_plan_synth()->morph_cache();
+}
+
 TimeInfo
 MorphOperatorModule::time_info() const
 {
@@ -136,7 +142,7 @@ MorphOperatorModule::apply_modulation (const ModulationData& mod_data) const
 
       if (mod_data.main_control_type == MorphOperator::CONTROL_OP)
         {
-          value = (morph_plan_voice->module (mod_data.main_control_op)->value() + 1) * 0.5;
+          value = (morph_plan_voice->control_op_value (mod_data.main_control_slot) + 1) * 0.5;
         }
       else
         {
@@ -150,7 +156,7 @@ MorphOperatorModule::apply_modulation (const ModulationData& mod_data) const
       double mod_value = 0;
 
       if (entry.control_type == MorphOperator::CONTROL_OP)
-        mod_value = morph_plan_voice->module (entry.control_op)->value();
+        mod_value = morph_plan_voice->control_op_value (entry.control_slot);
       else
         mod_value = morph_plan_voice->control_input (/* gui (not used) */ 0, entry.control_type, /* mod (not used) */ nullptr);
 
@@ -15,6 +15,7 @@ namespace SpectMorph
 {
 
 class MorphPlanVoice;
+class MorphCache;
 
 class MorphModuleSharedState
 {
@@ -35,6 +36,7 @@ protected:
 
   Random *random_gen() const;
   RTMemoryArea *rt_memory_area() const;
+  MorphCache *morph_cache() const;
   TimeInfo time_info() const;
   float apply_modulation (const ModulationData& mod_data) const;
   void set_notify_value (uint pos, float value);
@@ -93,6 +93,13 @@ MorphOutput::MorphOutput (MorphPlan *morph_plan) :
   add_property (&m_config.vibrato_depth, P_VIBRATO_DEPTH, "Depth", "%.2f Cent", 10, 0, 50);
   add_property_log (&m_config.vibrato_frequency, P_VIBRATO_FREQUENCY, "Frequency", "%.3f Hz", 4, 1, 15);
   add_property (&m_config.vibrato_attack, P_VIBRATO_ATTACK, "Attack", "%.2f ms", 0, 0, 1000);
+
+  add_property (&m_config.partial_culling, P_PARTIAL_CULLING, "Enable Partial Culling", false);
+  add_property (&m_config.partial_budget, P_PARTIAL_BUDGET, "Max Partials", "%d", 2000, 100, 10000);
+
+  add_property (&m_config.early_termination, P_EARLY_TERMINATION, "Enable Early Voice Termination", false);
+  add_property (&m_config.early_termination_threshold, P_EARLY_TERMINATION_THRESHOLD, "Threshold", "%.1f dB", -90, -144, -40);
+  add_property (&m_config.early_termination_hold, P_EARLY_TERMINATION_HOLD, "Hold", "%.1f ms", 50, 1, 1000);
 }
 
 const char *
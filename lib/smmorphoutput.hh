@@ -92,6 +92,21 @@ public:
     float                         vibrato_depth;
     float                         vibrato_frequency;
     float                         vibrato_attack;
+
+    bool                          partial_culling;
+    int                           partial_budget;
+
+    bool                          early_termination;
+    float                         early_termination_threshold;
+    float                         early_termination_hold;
+
+    void
+    get_modulation_data (std::vector<ModulationData *>& mod_data) override
+    {
+      mod_data.push_back (&filter_cutoff_mod);
+      mod_data.push_back (&filter_resonance_mod);
+      mod_data.push_back (&filter_drive_mod);
+    }
   };
   Config                       m_config;
 
@@ -134,6 +149,13 @@ public:
   static constexpr auto P_VIBRATO_FREQUENCY = "vibrato_frequency";
   static constexpr auto P_VIBRATO_ATTACK    = "vibrato_attack";
 
+  static constexpr auto P_PARTIAL_CULLING   = "partial_culling";
+  static constexpr auto P_PARTIAL_BUDGET    = "partial_budget";
+
+  static constexpr auto P_EARLY_TERMINATION           = "early_termination";
+  static constexpr auto P_EARLY_TERMINATION_THRESHOLD = "early_termination_threshold";
+  static constexpr auto P_EARLY_TERMINATION_HOLD      = "early_termination_hold";
+
 protected:
   std::vector<std::string>     load_channel_op_names;
 
@@ -3,6 +3,7 @@
 #include "smmorphoutputmodule.hh"
 #include "smmorphoutput.hh"
 #include "smmorphplan.hh"
+#include "smdspprofile.hh"
 #include <glib.h>
 #include <assert.h>
 
@@ -15,6 +16,7 @@ MorphOutputModule::MorphOutputModule (MorphPlanVoice *voice) :
   MorphOperatorModule (voice),
   decoder (this,  morph_plan_voice->mix_freq())
 {
+  m_split_positions.reserve (MorphPlanVoice::MAX_SPLIT_POSITIONS);
 }
 
 void
@@ -27,9 +29,9 @@ MorphOutputModule::set_config (const MorphOperatorConfig *op_cfg)
   LiveDecoderSource *source = mod ? mod->source() : nullptr;
 
   int random_seed = morph_plan_voice->morph_plan_synth()->random_seed();
-  /* since the source is part of a module (and modules get newly created in
-   * main thread and then replaced in audio thread), comparing the pointer to
-   * the source in the LiveDecoder is enough to see if the source changed
+  /* since the source is part of a module (and modules are only reused for
+   * the same operator across plan updates), comparing the pointer to the
+   * source in the LiveDecoder is enough to see if the source changed
    */
   decoder.set_config (cfg, source, morph_plan_voice->mix_freq(), random_seed);
 }
@@ -58,6 +60,19 @@ MorphOutputModule::pitch_bend_range() const
   return cfg->pitch_bend_range;
 }
 
+/* total number of partials the synth should render per block, 0 if unlimited */
+size_t
+MorphOutputModule::partial_budget() const
+{
+  return cfg->partial_culling ? cfg->partial_budget : 0;
+}
+
+size_t
+MorphOutputModule::culled_partials() const
+{
+  return decoder.culled_partials();
+}
+
 float
 MorphOutputModule::filter_cutoff_mod() const
 {
@@ -79,15 +94,27 @@ MorphOutputModule::filter_drive_mod() const
 void
 MorphOutputModule::process (const TimeInfoGenerator& time_info_gen, RTMemoryArea& rt_memory_area, size_t n_samples, float **values, size_t n_ports, const float *freq_in)
 {
+  DspProfile::Scope profile_scope (DspProfile::OPERATOR, m_ptr_id);
+
   const bool have_cycle = morph_plan_voice->morph_plan_synth()->have_cycle();
 
   this->time_info_gen = &time_info_gen;
   m_rt_memory_area = &rt_memory_area;
 
   if (!have_cycle)
-    decoder.process (rt_memory_area, n_samples, freq_in, values[0]);
+    {
+      /* control input changes: split decoder blocks, so that control values are constant in each part */
+      morph_plan_voice->control_change_positions (time_info_gen.time_info (0).time_ms, n_samples, m_split_positions);
+      decoder.set_split_positions (m_split_positions.empty() ? nullptr : &m_split_positions);
+
+      decoder.process (rt_memory_area, n_samples, freq_in, values[0]);
+
+      decoder.set_split_positions (nullptr);
+    }
   else
-    zero_float_block (n_samples, values[0]);
+    {
+      zero_float_block (n_samples, values[0]);
+    }
 
   this->time_info_gen = nullptr;
   m_rt_memory_area = nullptr;
@@ -99,6 +126,12 @@ MorphOutputModule::rt_memory_area() const
   return m_rt_memory_area;
 }
 
+void
+MorphOutputModule::update_control_values()
+{
+  morph_plan_voice->update_control_values();
+}
+
 TimeInfo
 MorphOutputModule::compute_time_info() const
 {
@@ -106,6 +139,14 @@ MorphOutputModule::compute_time_info() const
   return time_info_gen->time_info (decoder.time_offset_ms());
 }
 
+/* time for control inputs: start of the part of the block the decoder is processing */
+double
+MorphOutputModule::control_time_ms() const
+{
+  assert (time_info_gen);
+  return time_info_gen->time_info (decoder.process_offset_ms()).time_ms;
+}
+
 void
 MorphOutputModule::retrigger (const TimeInfo& time_info, int channel, float freq, int midi_velocity)
 {
@@ -124,6 +165,18 @@ MorphOutputModule::release()
   morph_plan_voice->note_off();
 }
 
+void
+MorphOutputModule::set_spectral_mixer (SpectralMixer *mixer, float gain)
+{
+  decoder.set_spectral_mixer (mixer, gain);
+}
+
+void
+MorphOutputModule::set_partial_budget (size_t max_partials)
+{
+  decoder.set_partial_budget (max_partials);
+}
+
 bool
 MorphOutputModule::done()
 {
@@ -19,6 +19,7 @@ class MorphOutputModule : public MorphOperatorModule
   const TimeInfoGenerator           *time_info_gen = nullptr;
   RTMemoryArea                      *m_rt_memory_area = nullptr;
   EffectDecoder                      decoder;
+  std::vector<uint>                  m_split_positions;
 
 public:
   MorphOutputModule (MorphPlanVoice *voice);
@@ -27,16 +28,22 @@ public:
   void process (const TimeInfoGenerator& time_info, RTMemoryArea& rt_memory_area, size_t n_samples, float **values, size_t n_ports, const float *freq_in = nullptr);
   void retrigger (const TimeInfo& time_info, int channel, float freq, int midi_velocity);
   void release();
+  void set_spectral_mixer (SpectralMixer *mixer, float gain);
+  void set_partial_budget (size_t max_partials);
   bool done();
 
   bool  portamento() const;
   float portamento_glide() const;
   float velocity_sensitivity() const;
   int   pitch_bend_range() const;
+  size_t partial_budget() const;
+  size_t culled_partials() const;
   float filter_cutoff_mod() const;
   float filter_resonance_mod() const;
   float filter_drive_mod() const;
+  void  update_control_values();
   TimeInfo compute_time_info() const;
+  double control_time_ms() const;
   RTMemoryArea *rt_memory_area() const;
 };
 
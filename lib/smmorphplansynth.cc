@@ -3,6 +3,7 @@
 #include "smmorphplansynth.hh"
 #include "smmorphplanvoice.hh"
 #include "smmorphoutputmodule.hh"
+#include "smmodulationlist.hh"
 
 using namespace SpectMorph;
 
@@ -10,11 +11,17 @@ using std::map;
 using std::vector;
 using std::string;
 
-MorphPlanSynth::MorphPlanSynth (float mix_freq, size_t n_voices) :
+/* n_voices:  total number of voices
+ * pool_size: number of voices that have modules initially (0: all voices)
+ */
+MorphPlanSynth::MorphPlanSynth (float mix_freq, size_t n_voices, size_t pool_size) :
   m_mix_freq (mix_freq)
 {
   for (size_t i = 0; i < n_voices; i++)
     voices.push_back (new MorphPlanVoice (m_mix_freq, this));
+
+  m_pool_size = pool_size ? std::clamp<size_t> (pool_size, 1, n_voices) : n_voices;
+  m_prepared_pool_size = m_pool_size;
 }
 
 MorphPlanSynth::~MorphPlanSynth()
@@ -33,6 +40,26 @@ MorphPlanSynth::voice (size_t i) const
   return voices[i];
 }
 
+/* shared state for a module that was created by the audio thread (see MorphPlanVoice::full_update) */
+MorphModuleSharedState *
+MorphPlanSynth::shared_state (MorphOperatorModule *module, MorphOperator::PtrID ptr_id) /* audio thread */
+{
+  auto it = std::lower_bound (voices_shared_state_ids.begin(), voices_shared_state_ids.end(), ptr_id);
+  g_return_val_if_fail (it != voices_shared_state_ids.end() && *it == ptr_id, nullptr);
+
+  auto& state = voices_shared_states[it - voices_shared_state_ids.begin()];
+  if (!state)
+    state.reset (module->create_shared_state());
+
+  return state.get();
+}
+
+size_t
+MorphPlanSynth::pool_size() const
+{
+  return m_pool_size;
+}
+
 static vector<string>
 sorted_id_list (const MorphPlan& plan)
 {
@@ -82,6 +109,8 @@ MorphPlanSynth::prepare_update (const MorphPlan& plan) /* main thread */
       Update::Op op = {
         .ptr_id = o->ptr_id(),
         .type   = o->type(),
+        .id     = o->id(),
+        .output_type = o->output_type(),
         .config = config
       };
       update->ops.push_back (op);
@@ -90,6 +119,8 @@ MorphPlanSynth::prepare_update (const MorphPlan& plan) /* main thread */
   sort (update->ops.begin(), update->ops.end(),
         [](const Update::Op& a, const Update::Op& b) { return a.ptr_id < b.ptr_id; });
 
+  resolve_control_slots (update->ops);
+
   vector<string> update_ids = sorted_id_list (plan);
 
   update->cheap = (update_ids == m_last_update_ids) && (plan.id() == m_last_plan_id);
@@ -97,10 +128,28 @@ MorphPlanSynth::prepare_update (const MorphPlan& plan) /* main thread */
   m_last_plan_id = plan.id();
   if (!update->cheap)
     {
-      update->voice_full_updates.resize (voices.size());
+      /* modules of operators that survive the update (same ptr_id, type and id) are
+       * not recreated: the voices keep the modules they have (including their state)
+       * so that adding or removing an operator only needs to construct new modules
+       */
+      map<MorphOperator::PtrID, string> module_keys;
+      update->shared_state_ids.resize (update->ops.size());
+      for (size_t i = 0; i < update->ops.size(); i++)
+        {
+          auto& op = update->ops[i];
+          update->shared_state_ids[i] = op.ptr_id;
+
+          const string key = op.type + "/" + op.id;
+          auto it = m_module_keys.find (op.ptr_id);
+
+          op.reuse_module = (it != m_module_keys.end() && it->second == key);
+          module_keys[op.ptr_id] = key;
+        }
+      update->voice_full_updates.resize (m_prepared_pool_size);
       update->new_shared_states.resize (update->ops.size());
 
-      for (size_t voice = 0; voice < voices.size(); voice++)
+      m_pool_ops.clear();
+      for (size_t voice = 0; voice < m_prepared_pool_size; voice++)
         {
           for (size_t mod_index = 0; mod_index < update->ops.size(); mod_index++)
             {
@@ -108,8 +157,10 @@ MorphPlanSynth::prepare_update (const MorphPlan& plan) /* main thread */
               OpModule op_module;
 
               // avoid creating modules in audio thread by doing it here
-              op_module.module.reset (MorphOperatorModule::create (op.type, voices[voice]));
+              if (!op.reuse_module)
+                op_module.module.reset (MorphOperatorModule::create (op.type, voices[voice]));
               op_module.ptr_id = op.ptr_id;
+              op_module.type = op.type;
               op_module.config = op.config;
 
               if (op_module.module)
@@ -121,21 +172,162 @@ MorphPlanSynth::prepare_update (const MorphPlan& plan) /* main thread */
                     update->new_shared_states[mod_index].reset (op_module.module->create_shared_state());
                   if (update->new_shared_states[mod_index])
                     op_module.module->set_shared_state (update->new_shared_states[mod_index].get());
+                }
+              else if (!op.reuse_module)
+                {
+                  g_warning ("operator type %s lacks MorphOperatorModule\n", op.type.c_str());
+                  module_keys.erase (op.ptr_id);
+                  continue;
+                }
+
+              if (voice == 0)
+                m_pool_ops.push_back ({ op.ptr_id, op.type, op.output_type });
 
-                  if (op.type == "SpectMorph::MorphOutput")
-                    update->voice_full_updates[voice].output_module = dynamic_cast<MorphOutputModule *> (op_module.module.get());
+              if (op.type == "SpectMorph::MorphOutput")
+                update->voice_full_updates[voice].output_index = update->voice_full_updates[voice].new_modules.size();
 
-                  update->voice_full_updates[voice].new_modules.push_back (std::move (op_module));
+              /* control operators don't have modulation inputs themselves, so
+               * evaluating them in any order is a valid evaluation order
+               *
+               * the module pointer is filled in by the voice (modules may be reused)
+               */
+              if (op.output_type == MorphOperator::OUTPUT_CONTROL)
+                {
+                  ControlSlot slot;
+                  slot.ptr_id = op.ptr_id;
+                  update->voice_full_updates[voice].new_control_slots.push_back (slot);
                 }
-              else
-                g_warning ("operator type %s lacks MorphOperatorModule\n", op.type.c_str());
+
+              update->voice_full_updates[voice].new_modules.push_back (std::move (op_module));
             }
         }
+      m_module_keys.swap (module_keys);
     }
 
   return update;
 }
 
+/* Each voice has one control slot for each control operator (sorted by ptr_id),
+ * so the modulation inputs of the configs can refer to control operators by
+ * slot index, which is the same for all voices.
+ */
+void
+MorphPlanSynth::resolve_control_slots (const vector<Update::Op>& ops) /* main thread */
+{
+  vector<MorphOperator::PtrID> control_ops;
+  for (const auto& op : ops)
+    {
+      if (op.output_type == MorphOperator::OUTPUT_CONTROL)
+        control_ops.push_back (op.ptr_id);
+    }
+  auto slot_index = [&] (const MorphOperatorPtr& ptr)
+    {
+      auto it = std::lower_bound (control_ops.begin(), control_ops.end(), ptr.ptr_id());
+      if (it != control_ops.end() && *it == ptr.ptr_id())
+        return int (it - control_ops.begin());
+      return -1;
+    };
+
+  vector<ModulationData *> mod_data;
+  for (const auto& op : ops)
+    {
+      mod_data.clear();
+      op.config->get_modulation_data (mod_data);
+
+      for (auto data : mod_data)
+        {
+          data->main_control_slot = slot_index (data->main_control_op);
+
+          for (auto& entry : data->entries)
+            entry.control_slot = slot_index (entry.control_op);
+        }
+    }
+}
+
+/* change the number of voices that have modules (voice pool thread)
+ *
+ * modules for new voices are created here, configs and shared states are
+ * taken from the first voice when the update is applied; removing voices
+ * from the pool is only allowed for voices that are not playing
+ */
+MorphPlanSynth::UpdateP
+MorphPlanSynth::prepare_pool_update (size_t pool_size)
+{
+  UpdateP update = std::make_shared<Update>();
+
+  update->pool = true;
+  update->pool_size = std::clamp<size_t> (pool_size, 1, voices.size());
+
+  for (size_t voice = m_prepared_pool_size; voice < update->pool_size; voice++)
+    {
+      FullUpdateVoice full_update_voice;
+
+      for (const auto& op : m_pool_ops)
+        {
+          OpModule op_module;
+
+          op_module.module.reset (MorphOperatorModule::create (op.type, voices[voice]));
+          op_module.module->set_ptr_id (op.ptr_id);
+          op_module.ptr_id = op.ptr_id;
+          op_module.type = op.type;
+
+          if (op.type == "SpectMorph::MorphOutput")
+            full_update_voice.output_index = full_update_voice.new_modules.size();
+
+          if (op.output_type == MorphOperator::OUTPUT_CONTROL)
+            {
+              ControlSlot slot;
+              slot.ptr_id = op.ptr_id;
+              full_update_voice.new_control_slots.push_back (slot);
+            }
+          full_update_voice.new_modules.push_back (std::move (op_module));
+        }
+      update->voice_full_updates.push_back (std::move (full_update_voice));
+    }
+  if (update->pool_size < m_prepared_pool_size)
+    update->removed_modules.resize (m_prepared_pool_size - update->pool_size);
+
+  m_prepared_pool_size = update->pool_size;
+  return update;
+}
+
+void
+MorphPlanSynth::apply_pool_update (UpdateP update) /* audio thread */
+{
+  if (update->pool_size > m_pool_size)
+    {
+      const auto& first_modules = voices[0]->op_modules();
+
+      for (size_t i = 0; i < update->voice_full_updates.size(); i++)
+        {
+          auto& new_modules = update->voice_full_updates[i].new_modules;
+
+          g_return_if_fail (new_modules.size() == first_modules.size());
+
+          /* use configs and shared states of the voices that are already in the pool */
+          size_t state_index = 0;
+          for (size_t m = 0; m < new_modules.size(); m++)
+            {
+              g_return_if_fail (new_modules[m].ptr_id == first_modules[m].ptr_id);
+              new_modules[m].config = first_modules[m].config;
+
+              while (state_index < voices_shared_state_ids.size() && voices_shared_state_ids[state_index] < new_modules[m].ptr_id)
+                state_index++;
+              if (state_index < voices_shared_state_ids.size() && voices_shared_state_ids[state_index] == new_modules[m].ptr_id &&
+                  voices_shared_states[state_index])
+                new_modules[m].module->set_shared_state (voices_shared_states[state_index].get());
+            }
+          voices[m_pool_size + i]->full_update (update->voice_full_updates[i]);
+        }
+    }
+  else
+    {
+      for (size_t i = update->pool_size; i < m_pool_size; i++)
+        voices[i]->remove_modules (update->removed_modules[i - update->pool_size]);
+    }
+  m_pool_size = update->pool_size;
+}
+
 void
 MorphPlanSynth::apply_update (MorphPlanSynth::UpdateP update) /* audio thread */
 {
@@ -143,19 +335,39 @@ MorphPlanSynth::apply_update (MorphPlanSynth::UpdateP update) /* audio thread */
    *  - configs required for current update should be kept alive (m_active_configs)
    *  - configs no longer needed should be freed, but not in audio thread
    */
+  if (update->pool)
+    {
+      apply_pool_update (update);
+      return;
+    }
   m_active_configs.swap (update->new_configs);
   m_have_cycle = update->have_cycle;
 
   if (update->cheap)
     {
-      for (size_t i = 0; i < voices.size(); i++)
+      for (size_t i = 0; i < m_pool_size; i++)
         voices[i]->cheap_update (update);
     }
   else
     {
+      /* keep shared state of reused modules (both lists are sorted by ptr_id) */
+      size_t old_index = 0;
+      for (size_t i = 0; i < update->ops.size(); i++)
+        {
+          if (!update->ops[i].reuse_module)
+            continue;
+
+          while (old_index < voices_shared_state_ids.size() && voices_shared_state_ids[old_index] < update->ops[i].ptr_id)
+            old_index++;
+          if (old_index < voices_shared_state_ids.size() && voices_shared_state_ids[old_index] == update->ops[i].ptr_id)
+            update->new_shared_states[i] = std::move (voices_shared_states[old_index]);
+        }
       voices_shared_states.swap (update->new_shared_states);
+      voices_shared_state_ids.swap (update->shared_state_ids);
 
-      for (size_t i = 0; i < voices.size(); i++)
+      g_return_if_fail (update->voice_full_updates.size() == m_pool_size);
+
+      for (size_t i = 0; i < m_pool_size; i++)
         voices[i]->full_update (update->voice_full_updates[i]);
     }
 }
@@ -180,6 +392,12 @@ MorphPlanSynth::random_gen()
   return &m_random_gen;
 }
 
+MorphCache *
+MorphPlanSynth::morph_cache()
+{
+  return &m_morph_cache;
+}
+
 void
 MorphPlanSynth::set_random_seed (int seed)
 {
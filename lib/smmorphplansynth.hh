@@ -7,6 +7,7 @@
 #include "smmorphoperator.hh"
 #include "smrandom.hh"
 #include "smtimeinfo.hh"
+#include "smmorphcache.hh"
 #include <map>
 #include <memory>
 
@@ -22,7 +23,21 @@ class MorphPlanSynth {
 
 protected:
   std::vector<MorphPlanVoice *> voices;
+  size_t                        m_pool_size = 0;          // audio thread: voices [0, m_pool_size) have modules
+  size_t                        m_prepared_pool_size = 0; // preparing thread: pool size once all prepared updates are applied
   std::vector<std::unique_ptr<MorphModuleSharedState>> voices_shared_states;
+  std::vector<MorphOperator::PtrID>                     voices_shared_state_ids;
+
+  /* ptr_id -> type/id of the modules the voices own once all prepared updates are applied */
+  std::map<MorphOperator::PtrID, std::string>           m_module_keys;
+
+  struct PoolOp
+  {
+    MorphOperator::PtrID      ptr_id;
+    std::string               type;
+    MorphOperator::OutputType output_type;
+  };
+  std::vector<PoolOp>                                   m_pool_ops; // modules required for a voice (sorted by ptr_id)
 
   std::vector<std::string>                          m_last_update_ids;
   std::string                                       m_last_plan_id;
@@ -32,17 +47,26 @@ protected:
   Random          m_random_gen;
   int             m_random_seed = -1;
   bool            m_have_cycle = false;
+  MorphCache      m_morph_cache;
 
 public:
   struct OpModule {
-    std::unique_ptr<MorphOperatorModule> module;
+    std::unique_ptr<MorphOperatorModule> module; // nullptr: reuse the module the voice already has
     MorphOperator::PtrID ptr_id;
+    std::string          type;                   // for creating the module if it can't be reused
     MorphOperatorConfig *config = nullptr;
   };
+  /* value of a control operator, evaluated once per frame (see MorphPlanVoice::update_control_values) */
+  struct ControlSlot {
+    MorphOperator::PtrID ptr_id;
+    MorphOperatorModule *module = nullptr;
+    float                value = 0;
+  };
   struct FullUpdateVoice
   {
-    MorphOutputModule    *output_module = nullptr;
-    std::vector<OpModule> new_modules;
+    int                      output_index = -1; // index of output module in new_modules
+    std::vector<OpModule>    new_modules;
+    std::vector<ControlSlot> new_control_slots; // sorted by ptr_id
   };
   struct Update
   {
@@ -50,30 +74,46 @@ public:
     {
       MorphOperator::PtrID ptr_id;
       std::string          type;
+      std::string          id;
+      MorphOperator::OutputType output_type = MorphOperator::OUTPUT_NONE;
       MorphOperatorConfig *config = nullptr;
+      bool                 reuse_module = false; // full updates only: keep module + shared state
     };
     bool            cheap = false; // cheap update: same set of operators
+    bool            pool = false;  // pool update: only change the number of voices with modules
+    size_t          pool_size = 0; // pool updates only: number of voices with modules
     bool            have_cycle = false; // plan contains cycles?
     std::vector<Op> ops;
     std::vector<std::unique_ptr<MorphOperatorConfig>>    new_configs;
     std::vector<FullUpdateVoice>                         voice_full_updates;
     std::vector<std::unique_ptr<MorphModuleSharedState>> new_shared_states; // full updates only
+    std::vector<MorphOperator::PtrID>                     shared_state_ids;  // full updates only
+    std::vector<std::vector<OpModule>>                    removed_modules;   // pool updates only: freed with update
   };
   typedef std::shared_ptr<Update> UpdateP;
 
-  MorphPlanSynth (float mix_freq, size_t n_voices);
+private:
+  void apply_pool_update (UpdateP update);
+  void resolve_control_slots (const std::vector<Update::Op>& ops);
+
+public:
+  MorphPlanSynth (float mix_freq, size_t n_voices, size_t pool_size = 0);
   ~MorphPlanSynth();
 
   UpdateP prepare_update (const MorphPlan& new_plan);
+  UpdateP prepare_pool_update (size_t pool_size);
   void apply_update (UpdateP update);
 
   void update_shared_state (const TimeInfo& time_info);
 
   MorphPlanVoice *voice (size_t i) const;
+  MorphModuleSharedState *shared_state (MorphOperatorModule *module, MorphOperator::PtrID ptr_id);
+  size_t          pool_size() const;
 
   float   mix_freq() const;
   bool    have_output() const;
   Random *random_gen();
+  MorphCache *morph_cache();
   bool    have_cycle() const;
   void    set_random_seed (int seed);
   int     random_seed() const;
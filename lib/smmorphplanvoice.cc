@@ -15,9 +15,13 @@ using std::max;
 
 MorphPlanVoice::MorphPlanVoice (float mix_freq, MorphPlanSynth *synth) :
   m_control_input (MorphPlan::N_CONTROL_INPUTS),
+  m_control_changes (MorphPlan::N_CONTROL_INPUTS),
   m_mix_freq (mix_freq),
   m_morph_plan_synth (synth)
 {
+  /* control changes are added by the synthesis thread, so we must not allocate memory there */
+  for (auto& changes : m_control_changes)
+    changes.reserve (MAX_CONTROL_CHANGES);
 }
 
 void
@@ -48,21 +52,82 @@ MorphPlanVoice::module (const MorphOperatorPtr& ptr)
 void
 MorphPlanVoice::full_update (MorphPlanSynth::FullUpdateVoice& full_update_voice)
 {
-  /* This will loose the original state information which means the audio
-   * will not transition smoothely. However, this should only occur for plan
-   * changes, not parameter updates.
+  /* Modules of operators that are still part of the plan are reused and keep
+   * their state, newly added operators get fresh modules. So the audio will
+   * not transition smoothely if the path from the sources to the output has
+   * changed. However, this should only occur for plan changes, not parameter
+   * updates.
    */
 
+  // move modules that are reused from the old module list to the new module list
+  //  - both lists are sorted by ptr_id
+  //  - if a module that should be reused is missing (the main thread predicts which
+  //    modules the voice has), we create a new one, so the voice always gets a complete
+  //    module list; this is not supposed to happen, as it allocates memory in the audio thread
+  size_t old_index = 0;
+  for (auto& new_module : full_update_voice.new_modules)
+    {
+      if (new_module.module)
+        continue;
+
+      while (old_index < modules.size() && modules[old_index].ptr_id < new_module.ptr_id)
+        old_index++;
+
+      if (old_index < modules.size() && modules[old_index].ptr_id == new_module.ptr_id && modules[old_index].module)
+        {
+          new_module.module = std::move (modules[old_index].module);
+        }
+      else
+        {
+          new_module.module.reset (MorphOperatorModule::create (new_module.type, this));
+          assert (new_module.module);
+
+          new_module.module->set_ptr_id (new_module.ptr_id);
+
+          if (auto state = m_morph_plan_synth->shared_state (new_module.module.get(), new_module.ptr_id))
+            new_module.module->set_shared_state (state);
+        }
+    }
+
   // exchange old modules with new modules
   //  - avoids allocating any memory here (in audio thread)
   //  - avoids freeing any memory here (in audio thread), this is done later when the update structure is freed
   modules.swap (full_update_voice.new_modules);
-  m_output = full_update_voice.output_module;
+  m_control_slots.swap (full_update_voice.new_control_slots);
+
+  if (full_update_voice.output_index >= 0)
+    m_output = static_cast<MorphOutputModule *> (modules[full_update_voice.output_index].module.get());
+  else
+    m_output = nullptr;
+
+  // resolve control slots (sorted by ptr_id, like modules)
+  size_t module_index = 0;
+  for (auto& slot : m_control_slots)
+    {
+      while (modules[module_index].ptr_id != slot.ptr_id)
+        module_index++;
+      slot.module = modules[module_index].module.get();
+    }
 
   // reconfigure modules
   configure_modules();
 }
 
+/* voice is removed from the pool: modules will be freed later (not in audio thread) */
+void
+MorphPlanVoice::remove_modules (vector<MorphPlanSynth::OpModule>& removed_modules)
+{
+  modules.swap (removed_modules);
+  m_control_slots.clear();
+  m_output = nullptr;
+}
+
+const vector<MorphPlanSynth::OpModule>&
+MorphPlanVoice::op_modules() const
+{
+  return modules;
+}
+
 void
 MorphPlanVoice::cheap_update (MorphPlanSynth::UpdateP update)
 {
@@ -86,16 +151,45 @@ MorphPlanVoice::control_input (double value, MorphOperator::ControlType ctype, M
   switch (ctype)
     {
       case MorphOperator::CONTROL_GUI:      return value;
-      case MorphOperator::CONTROL_SIGNAL_1: return m_control_input[0];
-      case MorphOperator::CONTROL_SIGNAL_2: return m_control_input[1];
-      case MorphOperator::CONTROL_SIGNAL_3: return m_control_input[2];
-      case MorphOperator::CONTROL_SIGNAL_4: return m_control_input[3];
+      case MorphOperator::CONTROL_SIGNAL_1: return control_signal (0);
+      case MorphOperator::CONTROL_SIGNAL_2: return control_signal (1);
+      case MorphOperator::CONTROL_SIGNAL_3: return control_signal (2);
+      case MorphOperator::CONTROL_SIGNAL_4: return control_signal (3);
       case MorphOperator::CONTROL_VELOCITY: return m_velocity * 2 - 1; // for modulation, this has to be signed
       case MorphOperator::CONTROL_OP:       return module->value();
       default:                              g_assert_not_reached();
     }
 }
 
+/* Value of a control operator (LFO, envelope, ...) for the current frame
+ *
+ * The slot index is resolved when the plan update is prepared (see
+ * MorphPlanSynth::resolve_control_slots), -1 if there is no such operator.
+ */
+float
+MorphPlanVoice::control_op_value (int slot) const
+{
+  if (slot < 0 || size_t (slot) >= m_control_slots.size())
+    return 0;
+
+  return m_control_slots[slot].value;
+}
+
+/* Evaluate all control operators for the current time
+ *
+ * This is called once per voice whenever the time advances: by the decoder
+ * before it requests the next frame from the source (see
+ * LiveDecoder::set_output_module), and by the filter for each part of the block
+ * it processes. Modules only read the slot values, so each control operator is
+ * evaluated once, regardless of how many modules and properties it modulates.
+ */
+void
+MorphPlanVoice::update_control_values()
+{
+  for (auto& slot : m_control_slots)
+    slot.value = slot.module->value();
+}
+
 void
 MorphPlanVoice::set_control_input (int i, double value)
 {
@@ -104,6 +198,105 @@ MorphPlanVoice::set_control_input (int i, double value)
   m_control_input[i] = value;
 }
 
+/* Control input changes during a block
+ *
+ * Automation doesn't split the block that MidiSynth renders: instead each voice
+ * gets a list of changes. The output module splits the blocks of its decoder at
+ * the change positions (see control_change_positions), and modules see the value
+ * that is active at the start of the part that is being processed. So control
+ * values are constant within each part, like with block splitting.
+ */
+void
+MorphPlanVoice::add_control_change (int i, double time_ms, double old_value, double new_value)
+{
+  assert (i >= 0 && i < MorphPlan::N_CONTROL_INPUTS);
+
+  auto& changes = m_control_changes[i];
+  if (changes.empty())
+    m_control_input[i] = old_value;
+
+  if (!changes.empty() && (changes.size() == MAX_CONTROL_CHANGES || changes.back().time_ms >= time_ms))
+    {
+      /* no space left (or same time): replace last change, so that at least the final value is correct */
+      changes.back().time_ms = std::max (changes.back().time_ms, time_ms);
+      changes.back().value = new_value;
+    }
+  else
+    {
+      changes.push_back ({ time_ms, new_value });
+    }
+}
+
+bool
+MorphPlanVoice::have_control_changes (int i) const
+{
+  return !m_control_changes[i].empty();
+}
+
+/* apply all control changes before time_ms (called after rendering) */
+void
+MorphPlanVoice::advance_control_changes (double time_ms)
+{
+  for (int i = 0; i < MorphPlan::N_CONTROL_INPUTS; i++)
+    {
+      auto& changes = m_control_changes[i];
+
+      size_t n = 0;
+      while (n < changes.size() && changes[n].time_ms < time_ms)
+        m_control_input[i] = changes[n++].value;
+
+      if (n)
+        changes.erase (changes.begin(), changes.begin() + n);
+    }
+}
+
+/* sample positions of the control changes inside the block [start_ms, start_ms + n_samples) */
+void
+MorphPlanVoice::control_change_positions (double start_ms, size_t n_samples, std::vector<uint>& positions) const
+{
+  positions.clear();
+
+  for (const auto& changes : m_control_changes)
+    {
+      for (const auto& change : changes)
+        {
+          const double pos = std::round ((change.time_ms - start_ms) * m_mix_freq / 1000);
+
+          if (pos > 0 && pos < n_samples && positions.size() < positions.capacity())
+            positions.push_back (pos);
+        }
+    }
+  std::sort (positions.begin(), positions.end());
+  positions.erase (std::unique (positions.begin(), positions.end()), positions.end());
+}
+
+void
+MorphPlanVoice::clear_control_changes()
+{
+  for (auto& changes : m_control_changes)
+    changes.clear();
+}
+
+double
+MorphPlanVoice::control_signal (int i)
+{
+  const auto& changes = m_control_changes[i];
+  if (changes.empty() || !m_output)
+    return m_control_input[i];
+
+  /* allow half a sample tolerance for rounding errors of time computations */
+  const double time_ms = m_output->control_time_ms() + 500 / m_mix_freq;
+
+  double value = m_control_input[i];
+  for (const auto& change : changes)
+    {
+      if (change.time_ms > time_ms)
+        break;
+      value = change.value;
+    }
+  return value;
+}
+
 void
 MorphPlanVoice::set_velocity (float velocity)
 {
@@ -18,8 +18,18 @@ class MorphPlanVoice {
 
 protected:
   std::vector<MorphPlanSynth::OpModule> modules;
+  std::vector<MorphPlanSynth::ControlSlot> m_control_slots;
 
   std::vector<double>           m_control_input;
+
+  /* sample accurate control input changes (automation) inside the block that is rendered next */
+  struct ControlChange
+  {
+    double time_ms = 0;
+    double value = 0;
+  };
+  std::vector<std::vector<ControlChange>> m_control_changes;
+
   MorphOutputModule            *m_output = nullptr;
   float                         m_mix_freq = 0;
   float                         m_current_freq = 0;
@@ -27,17 +37,31 @@ protected:
   MorphPlanSynth               *m_morph_plan_synth = nullptr;
 
   void configure_modules();
+  double control_signal (int i);
 
 public:
+  static constexpr size_t MAX_CONTROL_CHANGES = 64;
+  static constexpr size_t MAX_SPLIT_POSITIONS = MAX_CONTROL_CHANGES * MorphPlan::N_CONTROL_INPUTS;
+
   MorphPlanVoice (float mix_freq, MorphPlanSynth *synth);
 
   void cheap_update (MorphPlanSynth::UpdateP update);
   void full_update (MorphPlanSynth::FullUpdateVoice& full_update_voice);
+  void remove_modules (std::vector<MorphPlanSynth::OpModule>& removed_modules);
+
+  const std::vector<MorphPlanSynth::OpModule>& op_modules() const;
 
   MorphOperatorModule *module (const MorphOperatorPtr& ptr);
 
   double control_input (double value, MorphOperator::ControlType ctype, MorphOperatorModule *module);
+  float  control_op_value (int slot) const;
+  void   update_control_values();
   void   set_control_input (int i, double value);
+  void   add_control_change (int i, double time_ms, double old_value, double new_value);
+  bool   have_control_changes (int i) const;
+  void   advance_control_changes (double time_ms);
+  void   control_change_positions (double start_ms, size_t n_samples, std::vector<uint>& positions) const;
+  void   clear_control_changes();
   void   set_velocity (float velocity);
   void   set_current_freq (float freq);
   void   note_off();
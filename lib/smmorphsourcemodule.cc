@@ -67,7 +67,7 @@ SimpleWavSetSource::rt_audio_block (size_t index, RTAudioBlock& out_block)
 {
   if (active_audio && index < active_audio->contents.size())
     {
-      out_block.assign (active_audio->contents[index]);
+      out_block.borrow (active_audio->contents[index]);
       return true;
     }
   else
@@ -76,6 +76,12 @@ SimpleWavSetSource::rt_audio_block (size_t index, RTAudioBlock& out_block)
     }
 }
 
+const void *
+SimpleWavSetSource::block_cache_id()
+{
+  return active_audio;
+}
+
 void
 SimpleWavSetSource::set_portamento_freq (float freq)
 {
@@ -24,6 +24,7 @@ public:
   Audio      *audio() override;
   bool        rt_audio_block (size_t index, RTAudioBlock& out_block) override;
   void        set_portamento_freq (float freq) override;
+  const void *block_cache_id() override;
 };
 
 class MorphSourceModule : public MorphOperatorModule
@@ -2,6 +2,7 @@
 
 #include "smmorphutils.hh"
 #include "smmath.hh"
+#include "smdspprofile.hh"
 
 #include <algorithm>
 
@@ -34,8 +35,10 @@ md_cmp (const MagData& m1, const MagData& m2)
 
 struct FreqState
 {
-  float freq_f;
-  int   used;
+  float    freq_f;
+  int      used;
+  uint16_t freq;
+  uint16_t mag;
 };
 
 static bool
@@ -53,7 +56,7 @@ find_match (float freq, const FreqState *freq_state, size_t freq_state_size, siz
   float min_diff = 1e20;
   size_t best_index = 0; // initialized to avoid compiler warning
 
-  FreqState start_freq_state = {freq_start, 0};
+  FreqState start_freq_state = {freq_start, 0, 0, 0};
   const FreqState *start_ptr = std::lower_bound (freq_state, freq_state + freq_state_size, start_freq_state, fs_cmp);
   size_t i = start_ptr - freq_state;
 
@@ -78,41 +81,36 @@ find_match (float freq, const FreqState *freq_state, size_t freq_state_size, siz
   return false;
 }
 
-static size_t
-init_mag_data (MagData *mds, const RTAudioBlock& left_block, const RTAudioBlock& right_block)
+static void
+init_freq_state (const RTAudioBlock& block, FreqState *freq_state)
 {
-  size_t mds_size = 0;
-  for (size_t i = 0; i < left_block.freqs.size(); i++)
-    {
-      MagData& md = mds[mds_size];
-
-      md.block = MagData::BLOCK_LEFT;
-      md.index = i;
-      md.mag   = left_block.mags[i];
-      mds_size++;
-    }
-  for (size_t i = 0; i < right_block.freqs.size(); i++)
+  bool sorted = true;
+  for (size_t i = 0; i < block.freqs.size(); i++)
     {
-      MagData& md = mds[mds_size];
+      freq_state[i].freq_f = sm_ifreq2freq (block.freqs[i]);
+      freq_state[i].used   = 0;
+      freq_state[i].freq   = block.freqs[i];
+      freq_state[i].mag    = block.mags[i];
 
-      md.block = MagData::BLOCK_RIGHT;
-      md.index = i;
-      md.mag   = right_block.mags[i];
-      mds_size++;
+      if (i > 0 && block.freqs[i - 1] > block.freqs[i])
+        sorted = false;
     }
-  sort (mds, mds + mds_size, md_cmp);
-  return mds_size;
+  /* matching needs partials sorted by frequency, which they usually are already */
+  if (!sorted)
+    std::sort (freq_state, freq_state + block.freqs.size(), fs_cmp);
 }
 
+struct OutPartial
+{
+  uint16_t freq;
+  uint16_t mag;
+  float    mag_f; // only used for MorphMode::LINEAR
+};
 
-static void
-init_freq_state (const RTVector<uint16_t>& fint, FreqState *freq_state)
+static bool
+op_cmp (const OutPartial& op1, const OutPartial& op2)
 {
-  for (size_t i = 0; i < fint.size(); i++)
-    {
-      freq_state[i].freq_f = sm_ifreq2freq (fint[i]);
-      freq_state[i].used   = 0;
-    }
+  return op1.freq < op2.freq;
 }
 
 static void
@@ -145,23 +143,18 @@ morph_scale (RTAudioBlock& out_block, const RTAudioBlock& in_block, double facto
   const int ddb = sm_factor2delta_idb (factor);
 
   out_block.assign (in_block);
+  uint16_t *noise = out_block.noise.data_writable();
   for (size_t i = 0; i < out_block.noise.size(); i++)
-    out_block.noise[i] = std::clamp (out_block.noise[i] + ddb, 0, 65535);
+    noise[i] = std::clamp (noise[i] + ddb, 0, 65535);
 
+  uint16_t *mags = out_block.mags.data_writable();
   for (size_t i = 0; i < out_block.freqs.size(); i++)
-    interp_mag_one (factor, NULL, &out_block.mags[i], mode);
+    interp_mag_one (factor, NULL, &mags[i], mode);
 }
 
-bool
-get_normalized_block (LiveDecoderSource *source, double time_ms, RTAudioBlock& out_audio_block)
+int
+get_normalized_block_index (Audio *audio, double time_ms)
 {
-  if (!source)
-    return false;
-
-  Audio *audio = source->audio();
-  if (!audio)
-    return false;
-
   if (audio->loop_type == Audio::LOOP_TIME_FORWARD)
     {
       const double loop_start_ms = audio->loop_start * 1000.0 / audio->mix_freq;
@@ -186,8 +179,20 @@ get_normalized_block (LiveDecoderSource *source, double time_ms, RTAudioBlock& o
     {
       source_index = LiveDecoder::compute_loop_frame_index (source_index, audio);
     }
+  return source_index;
+}
+
+bool
+get_normalized_block (LiveDecoderSource *source, double time_ms, RTAudioBlock& out_audio_block)
+{
+  if (!source)
+    return false;
 
-  return source->rt_audio_block (source_index, out_audio_block);
+  Audio *audio = source->audio();
+  if (!audio)
+    return false;
+
+  return source->rt_audio_block (get_normalized_block_index (audio, time_ms), out_audio_block);
 }
 
 bool
@@ -196,6 +201,8 @@ morph (RTAudioBlock& out_block,
        bool have_right, const RTAudioBlock& right_block,
        double morphing, MorphUtils::MorphMode morph_mode)
 {
+  DspProfile::Scope profile_scope (DspProfile::MORPH);
+
   const float interp = (morphing + 1) / 2; /* examples => 0: only left; 0.5 both equally; 1: only right */
 
   if (!have_left && !have_right) // nothing + nothing = nothing
@@ -212,116 +219,202 @@ morph (RTAudioBlock& out_block,
       return true;
     }
 
-  // set out_block capacity
-  const size_t max_partials = left_block.freqs.size() + right_block.freqs.size();
-  out_block.freqs.set_capacity (max_partials);
-  out_block.mags.set_capacity (max_partials);
+  const size_t left_size  = left_block.freqs.size();
+  const size_t right_size = right_block.freqs.size();
 
-  MagData mds[max_partials + AVOID_ARRAY_UB];
+  FreqState left_freqs[left_size + AVOID_ARRAY_UB];
+  FreqState right_freqs[right_size + AVOID_ARRAY_UB];
 
-  size_t mds_size = MorphUtils::init_mag_data (mds, left_block, right_block);
-  size_t left_freqs_size = left_block.freqs.size();
-  size_t right_freqs_size = right_block.freqs.size();
+  init_freq_state (left_block, left_freqs);
+  init_freq_state (right_block, right_freqs);
 
-  MorphUtils::FreqState   left_freqs[left_freqs_size + AVOID_ARRAY_UB];
-  MorphUtils::FreqState   right_freqs[right_freqs_size + AVOID_ARRAY_UB];
+  OutPartial out_partials[left_size + right_size + AVOID_ARRAY_UB];
+  size_t     out_size = 0;
 
-  init_freq_state (left_block.freqs, left_freqs);
-  init_freq_state (right_block.freqs, right_freqs);
-
-  for (size_t m = 0; m < mds_size; m++)
+  auto add_matched = [&] (const FreqState& left, const FreqState& right)
     {
-      size_t i, j;
-      bool match = false;
-      if (mds[m].block == MagData::BLOCK_LEFT)
+      /* prefer frequency of louder partial:
+       *
+       * if the magnitudes are similar, mfact will be close to 1, and freq will become approx.
+       *
+       *   freq = (1 - interp) * lfreq + interp * rfreq
+       *
+       * if the magnitudes are very different, mfact will be close to 0, and freq will become
+       *
+       *   freq ~= lfreq         // if left partial is louder
+       *   freq ~= rfreq         // if right partial is louder
+       */
+      const float lfreq = left.freq;
+      const float rfreq = right.freq;
+      const float lmag  = sm_idb2factor (left.mag);
+      const float rmag  = sm_idb2factor (right.mag);
+      float freq;
+
+      if (left.mag > right.mag)
         {
-          i = mds[m].index;
+          const float mfact = rmag / lmag;
 
-          if (!left_freqs[i].used)
-            match = MorphUtils::find_match (left_freqs[i].freq_f, right_freqs, right_freqs_size, &j);
+          freq = lfreq + mfact * interp * (rfreq - lfreq);
         }
-      else // (mds[m].block == MagData::BLOCK_RIGHT)
+      else
         {
-          j = mds[m].index;
-          if (!right_freqs[j].used)
-            match = MorphUtils::find_match (right_freqs[j].freq_f, left_freqs, left_freqs_size, &i);
+          const float mfact = lmag / rmag;
+
+          freq = rfreq + mfact * (1 - interp) * (lfreq - rfreq);
         }
-      if (match)
+
+      OutPartial& out = out_partials[out_size++];
+      out.freq = freq;
+      if (morph_mode == MorphUtils::MorphMode::DB_LINEAR)
         {
-          /* prefer frequency of louder partial:
-           *
-           * if the magnitudes are similar, mfact will be close to 1, and freq will become approx.
-           *
-           *   freq = (1 - interp) * lfreq + interp * rfreq
-           *
-           * if the magnitudes are very different, mfact will be close to 0, and freq will become
-           *
-           *   freq ~= lfreq         // if left partial is louder
-           *   freq ~= rfreq         // if right partial is louder
-           */
-          const float lfreq = left_block.freqs[i];
-          const float rfreq = right_block.freqs[j];
-          float freq;
+          const uint16_t lmag_idb = max (left.mag, SM_IDB_CONST_M96);
+          const uint16_t rmag_idb = max (right.mag, SM_IDB_CONST_M96);
 
-          if (left_block.mags[i] > right_block.mags[j])
-            {
-              const float mfact = right_block.mags_f (j) / left_block.mags_f (i);
+          out.mag = sm_round_positive ((1 - interp) * lmag_idb + interp * rmag_idb);
+        }
+      else
+        {
+          out.mag_f = (1 - interp) * lmag + interp * rmag;
+        }
+    };
+  auto add_unmatched = [&] (const FreqState& fs, bool left)
+    {
+      OutPartial& out = out_partials[out_size++];
+      out.freq = fs.freq;
+      if (morph_mode == MorphUtils::MorphMode::DB_LINEAR)
+        {
+          out.mag = fs.mag;
+          interp_mag_one (interp, left ? &out.mag : NULL, left ? NULL : &out.mag, morph_mode);
+        }
+      else
+        {
+          out.mag_f = (left ? 1 - interp : interp) * sm_idb2factor (fs.mag);
+        }
+    };
+
+  /* partials can only be matched if their frequencies are close (see find_match), so we
+   * split the frequency sorted partials into groups that can't interact with each other
+   *
+   * within each group, partials are matched loudest first, so the result is the same as
+   * sorting all partials by magnitude; but groups are usually tiny, so this is linear time
+   */
+  MagData mds[left_size + right_size + AVOID_ARRAY_UB];
+
+  size_t i = 0, j = 0;
+  while (i < left_size || j < right_size)
+    {
+      size_t i_end = i, j_end = j;
+      while (i_end < left_size || j_end < right_size)
+        {
+          const bool have_left_partial  = i_end < left_size;
+          const bool have_right_partial = j_end < right_size;
 
-              freq = lfreq + mfact * interp * (rfreq - lfreq);
-            }
-          else
+          if (i_end > i || j_end > j)
             {
-              const float mfact = left_block.mags_f (i) / right_block.mags_f (j);
-
-              freq = rfreq + mfact * (1 - interp) * (lfreq - rfreq);
+              /* the closest pairs across the group boundary are (last right, next left) and (last left, next right) */
+              bool connected = false;
+              if (have_left_partial && j_end > j && left_freqs[i_end].freq_f - right_freqs[j_end - 1].freq_f < 0.5)
+                connected = true;
+              if (have_right_partial && i_end > i && right_freqs[j_end].freq_f - left_freqs[i_end - 1].freq_f < 0.5)
+                connected = true;
+              if (!connected)
+                break;
             }
+          if (have_left_partial && (!have_right_partial || left_freqs[i_end].freq_f <= right_freqs[j_end].freq_f))
+            i_end++;
+          else
+            j_end++;
+        }
+      const size_t group_start = out_size;
+      if (i_end > i && j_end > j)
+        {
+          size_t mds_size = 0;
+          for (size_t k = i; k < i_end; k++)
+            mds[mds_size++] = { MagData::BLOCK_LEFT, k, left_freqs[k].mag };
+          for (size_t k = j; k < j_end; k++)
+            mds[mds_size++] = { MagData::BLOCK_RIGHT, k, right_freqs[k].mag };
 
-          uint16_t mag_idb;
-          if (morph_mode == MorphUtils::MorphMode::DB_LINEAR)
-            {
-              const uint16_t lmag_idb = max (left_block.mags[i], SM_IDB_CONST_M96);
-              const uint16_t rmag_idb = max (right_block.mags[j], SM_IDB_CONST_M96);
+          sort (mds, mds + mds_size, md_cmp);
 
-              mag_idb = sm_round_positive ((1 - interp) * lmag_idb + interp * rmag_idb);
-            }
-          else
+          for (size_t m = 0; m < mds_size; m++)
             {
-              mag_idb = sm_factor2idb ((1 - interp) * left_block.mags_f (i) + interp * right_block.mags_f (j));
+              size_t li, ri;
+              bool match = false;
+              if (mds[m].block == MagData::BLOCK_LEFT)
+                {
+                  li = mds[m].index;
+                  if (!left_freqs[li].used && MorphUtils::find_match (left_freqs[li].freq_f, right_freqs + j, j_end - j, &ri))
+                    {
+                      ri += j;
+                      match = true;
+                    }
+                }
+              else // (mds[m].block == MagData::BLOCK_RIGHT)
+                {
+                  ri = mds[m].index;
+                  if (!right_freqs[ri].used && MorphUtils::find_match (right_freqs[ri].freq_f, left_freqs + i, i_end - i, &li))
+                    {
+                      li += i;
+                      match = true;
+                    }
+                }
+              if (match)
+                {
+                  add_matched (left_freqs[li], right_freqs[ri]);
+
+                  left_freqs[li].used = 1;
+                  right_freqs[ri].used = 1;
+                }
             }
-          out_block.freqs.push_back (freq);
-          out_block.mags.push_back (mag_idb);
-
-          left_freqs[i].used = 1;
-          right_freqs[j].used = 1;
         }
+      for (size_t k = i; k < i_end; k++)
+        if (!left_freqs[k].used)
+          add_unmatched (left_freqs[k], true);
+
+      for (size_t k = j; k < j_end; k++)
+        if (!right_freqs[k].used)
+          add_unmatched (right_freqs[k], false);
+
+      /* output of different groups doesn't overlap, so we only need to sort within each group */
+      if (out_size - group_start > 1)
+        sort (out_partials + group_start, out_partials + out_size, op_cmp);
+
+      i = i_end;
+      j = j_end;
     }
-  for (size_t i = 0; i < left_block.freqs.size(); i++)
-    {
-      if (!left_freqs[i].used)
-        {
-          out_block.freqs.push_back (left_block.freqs[i]);
-          out_block.mags.push_back (left_block.mags[i]);
 
-          interp_mag_one (interp, &out_block.mags.back(), NULL, morph_mode);
-        }
+  out_block.freqs.set_capacity (out_size);
+  for (size_t p = 0; p < out_size; p++)
+    out_block.freqs.push_back (out_partials[p].freq);
+
+  if (morph_mode == MorphUtils::MorphMode::DB_LINEAR)
+    {
+      out_block.mags.set_capacity (out_size);
+      for (size_t p = 0; p < out_size; p++)
+        out_block.mags.push_back (out_partials[p].mag);
     }
-  for (size_t i = 0; i < right_block.freqs.size(); i++)
+  else
     {
-      if (!right_freqs[i].used)
-        {
-          out_block.freqs.push_back (right_block.freqs[i]);
-          out_block.mags.push_back (right_block.mags[i]);
+      float    mags_f[out_size + AVOID_ARRAY_UB];
+      uint16_t mags_idb[out_size + AVOID_ARRAY_UB];
 
-          interp_mag_one (interp, NULL, &out_block.mags.back(), morph_mode);
-        }
+      for (size_t p = 0; p < out_size; p++)
+        mags_f[p] = out_partials[p].mag_f;
+
+      sm_factor2idbs (mags_f, out_size, mags_idb);
+      out_block.mags.assign (mags_idb, mags_idb + out_size);
     }
   assert (left_block.noise.size() == right_block.noise.size());
 
-  out_block.noise.set_capacity (left_block.noise.size());
-  for (size_t i = 0; i < left_block.noise.size(); i++)
-    out_block.noise.push_back (sm_factor2idb ((1 - interp) * left_block.noise_f (i) + interp * right_block.noise_f (i)));
+  const size_t noise_size = left_block.noise.size();
+  float    noise_f[noise_size + AVOID_ARRAY_UB];
+  uint16_t noise_idb[noise_size + AVOID_ARRAY_UB];
+
+  for (size_t n = 0; n < noise_size; n++)
+    noise_f[n] = (1 - interp) * left_block.noise_f (n) + interp * right_block.noise_f (n);
 
-  out_block.sort_freqs();
+  sm_factor2idbs (noise_f, noise_size, noise_idb);
+  out_block.noise.assign (noise_idb, noise_idb + noise_size);
 
   return true;
 }
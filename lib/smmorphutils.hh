@@ -28,6 +28,7 @@ bool morph (RTAudioBlock& out_block,
             double morphing, MorphUtils::MorphMode morph_mode);
 
 bool get_normalized_block (LiveDecoderSource *source, double time_ms, RTAudioBlock& out_audio_block);
+int  get_normalized_block_index (Audio *audio, double time_ms);
 
 }
 
@@ -34,6 +34,12 @@ public:
     ModulationData          position_mod;
     FormantCorrection::Mode formant_correct = FormantCorrection::MODE_REPITCH;
     float                   fuzzy_resynth;
+
+    void
+    get_modulation_data (std::vector<ModulationData *>& mod_data) override
+    {
+      mod_data.push_back (&position_mod);
+    }
   };
   static constexpr auto P_PLAY_MODE          = "play_mode";
   static constexpr auto P_POSITION           = "position";
@@ -98,6 +98,20 @@ MorphWavSourceModule::InstrumentSource::rt_audio_block (size_t index, RTAudioBlo
     }
 }
 
+const void *
+MorphWavSourceModule::InstrumentSource::block_cache_id()
+{
+  /* formant correction and custom position depend on voice state, only plain playback can be shared */
+  if (module->cfg->formant_correct != FormantCorrection::MODE_REPITCH ||
+      module->cfg->play_mode == MorphWavSource::PLAY_MODE_CUSTOM_POSITION)
+    return nullptr;
+
+  if (!project->get_wav_set (object_id))
+    return nullptr;
+
+  return active_audio;
+}
+
 void
 MorphWavSourceModule::InstrumentSource::update_voice_source (const MorphWavSource::Config *config)
 {
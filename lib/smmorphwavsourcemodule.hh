@@ -41,6 +41,7 @@ class MorphWavSourceModule : public MorphOperatorModule
     void retrigger (int channel, float freq, int midi_velocity) override;
     Audio *audio() override;
     bool rt_audio_block (size_t index, RTAudioBlock& out_block) override;
+    const void *block_cache_id() override;
 
     void update_project_and_object_id (Project *project, int object_id);
   };
@@ -79,19 +79,42 @@ NoiseBandPartition::n_spectrum_bins()
   return spectrum_size;
 }
 
-void
-NoiseBandPartition::noise_envelope_to_spectrum (Random& random_gen, const uint16_t *envelope, float *spectrum, double scale)
+/*
+ * bands with an envelope value below min_idb are not rendered (left zero); returns the end of
+ * the non-zero part of the spectrum, which is smaller than n_spectrum_bins() if the highest
+ * bands were not rendered
+ */
+size_t
+NoiseBandPartition::noise_envelope_to_spectrum (Random& random_gen, const uint16_t *envelope, float *spectrum, double scale, uint16_t min_idb)
 {
+  size_t n_bands_used = n_bands();
+  while (n_bands_used > 0 && envelope[n_bands_used - 1] < min_idb)
+    n_bands_used--;
+
+  size_t end = spectrum_size;
+  if (n_bands_used < n_bands())
+    {
+      /* we don't need random data for the bands we don't render */
+      end = 0;
+      for (size_t b = 0; b < n_bands_used; b++)
+        {
+          if (band_count[b])
+            end = std::max<size_t> (end, band_start[b] + band_count[b] * 2);
+        }
+    }
   guint32 random_data[(spectrum_size + 7) / 8];
 
-  random_gen.random_block ((spectrum_size + 7) / 8, random_data);
+  random_gen.random_block ((end + 7) / 8, random_data);
 
   zero_float_block (spectrum_size, spectrum);
 
   const guint8 *random_data_byte = reinterpret_cast<guint8 *> (random_data);
 
-  for (size_t b = 0; b < n_bands(); b++)
+  for (size_t b = 0; b < n_bands_used; b++)
     {
+      if (envelope[b] < min_idb)
+        continue;
+
       const float value = sm_idb2factor (envelope[b]) * scale;
 
       size_t start = band_start[b];
@@ -108,4 +131,5 @@ NoiseBandPartition::noise_envelope_to_spectrum (Random& random_gen, const uint16
           spectrum[d+1] = int_sinf (r) * value;
         }
     }
+  return end;
 }
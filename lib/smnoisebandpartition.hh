@@ -21,7 +21,7 @@ class NoiseBandPartition
 
 public:
   NoiseBandPartition (size_t n_bands, size_t n_spectrum_bins, double mix_freq);
-  void noise_envelope_to_spectrum (SpectMorph::Random& random_gen, const uint16_t *envelope, float *spectrum, double scale);
+  size_t noise_envelope_to_spectrum (SpectMorph::Random& random_gen, const uint16_t *envelope, float *spectrum, double scale, uint16_t min_idb = 0);
 
   size_t n_bands();
   size_t n_spectrum_bins();
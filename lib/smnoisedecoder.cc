@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <map>
 #include <mutex>
+#include <algorithm>
 
 using std::vector;
 using std::map;
@@ -102,14 +103,27 @@ void
 NoiseDecoder::process (const uint16_t     *noise_envelope,
                        float              *samples,
                        OutputMode          output_mode,
-                       float               portamento_stretch)
+                       float               portamento_stretch,
+                       float               gain,
+                       Detail              detail)
 {
   assert (noise_band_partition.n_spectrum_bins() == block_size + 2);
 
   const double Eww = 0.375; // expected value of the energy of the window
   const double norm = mix_freq / (Eww * block_size);
 
-  noise_band_partition.noise_envelope_to_spectrum (random_gen, noise_envelope, interpolated_spectrum, sqrt (norm) / 2);
+  /* low detail: only render bands that are not much quieter than the loudest band */
+  uint16_t min_idb = 0;
+  if (detail != Detail::FULL)
+    {
+      const uint16_t peak_idb = *std::max_element (noise_envelope, noise_envelope + Audio::N_NOISE_BANDS);
+      const uint16_t low_detail_range_idb = 40 * 64;
+
+      if (peak_idb > low_detail_range_idb)
+        min_idb = peak_idb - low_detail_range_idb;
+    }
+  const size_t spectrum_end = noise_band_partition.noise_envelope_to_spectrum (random_gen, noise_envelope, interpolated_spectrum,
+                                                                               sqrt (norm) / 2 * gain, min_idb);
 
   if (portamento_stretch > 1.01) // avoid aliasing during portamento
     {
@@ -121,11 +135,11 @@ NoiseDecoder::process (const uint16_t     *noise_envelope,
   interpolated_spectrum[1] = interpolated_spectrum[block_size];
   if (output_mode == ADD_SPECTRUM_BH92)
     {
-      apply_window_bh92 (interpolated_spectrum, samples);
+      apply_window_bh92 (interpolated_spectrum, samples, spectrum_end);
     }
   else if (output_mode == SET_SPECTRUM_HANN)
     {
-      apply_window_hann_overwrite (interpolated_spectrum, samples);
+      apply_window_hann_overwrite (interpolated_spectrum, samples, spectrum_end);
     }
   else if (output_mode == DEBUG_UNWINDOWED)
     {
@@ -185,6 +199,24 @@ NoiseDecoder::precompute_tables()
   FFT::free_array_float (out);
 }
 
+/*
+ * noise envelope values are spectral densities: for 48 kHz, an envelope with all bands at -X dB
+ * produces noise with an rms level of about -(X - 45) dB, so
+ *  - SILENT (below -150 dB) noise doesn't need to be synthesized at all
+ *  - LOW detail (below -110 dB) noise can skip bands that are much quieter than the loudest band
+ */
+NoiseDecoder::Detail
+NoiseDecoder::envelope_detail (const uint16_t *noise_envelope)
+{
+  const uint16_t peak_idb = *std::max_element (noise_envelope, noise_envelope + Audio::N_NOISE_BANDS);
+
+  if (peak_idb < uint16_t ((512 - 150) * 64))
+    return Detail::SILENT;
+  if (peak_idb < uint16_t ((512 - 110) * 64))
+    return Detail::LOW;
+  return Detail::FULL;
+}
+
 size_t
 NoiseDecoder::preferred_block_size (double mix_freq)
 {
@@ -230,7 +262,7 @@ NoiseDecoder::make_k_array()
 }
 
 void
-NoiseDecoder::apply_window_bh92 (float *spectrum, float *fft_buffer)
+NoiseDecoder::apply_window_bh92 (float *spectrum, float *fft_buffer, size_t spectrum_end)
 {
   float *expand_in = spectrum - 8;
 
@@ -303,13 +335,16 @@ NoiseDecoder::apply_window_bh92 (float *spectrum, float *fft_buffer)
         const __m128 lo = _mm_shuffle_ps (f, s, _MM_SHUFFLE (1,0,1,0)); \
         OUT = _mm_add_ps (OUT, _mm_add_ps (hi, lo)); \
       }
+      /* if the spectrum ends early, we only need to compute the bins it affects (window width: 3 bins) */
+      const size_t conv_end = std::min (block_size, (spectrum_end + 6 + 3) & ~size_t (3));
+
       size_t i = 0;
       __m128 i0 = in[0];
       __m128 i1 = in[1];
       __m128 i2 = in[2];
       __m128 i3 = in[3];
       __m128 i4;
-      while (i < block_size - 20)
+      while (i + 20 < conv_end)
         {
           i4 = in[4];
           CONV(i0,i1,i2,i3,i4,*(__m128 *)(fft_buffer + i));
@@ -329,7 +364,7 @@ NoiseDecoder::apply_window_bh92 (float *spectrum, float *fft_buffer)
           in += 5;
           i += 20;
         }
-      while (i < block_size)
+      while (i < conv_end)
         {
           const __m128 i0 = in[0];
           const __m128 i1 = in[1];
@@ -342,6 +377,7 @@ NoiseDecoder::apply_window_bh92 (float *spectrum, float *fft_buffer)
           in++;
           i += 4;
         }
+      if (conv_end == block_size)
         {
           const __m128 i0 = in[0];
           const __m128 i1 = in[1];
@@ -379,7 +415,7 @@ NoiseDecoder::apply_window_bh92 (float *spectrum, float *fft_buffer)
 }
 
 void
-NoiseDecoder::apply_window_hann_overwrite (float *spectrum, float *fft_buffer)
+NoiseDecoder::apply_window_hann_overwrite (float *spectrum, float *fft_buffer, size_t spectrum_end)
 {
   float *expand_in = spectrum - 8;
 
@@ -400,7 +436,9 @@ NoiseDecoder::apply_window_hann_overwrite (float *spectrum, float *fft_buffer)
   const float K0 = 0.5;   // a0
   const float K1 = 0.25;  // a1 / 2
 
-  for (size_t i = 8; i < block_size + 2 + 8; i += 2)
+  /* if the spectrum ends early, we only need to compute the bins it affects (window width: 1 bin) */
+  const size_t conv_end = std::min (block_size + 2, spectrum_end + 2);
+  for (size_t i = 8; i < conv_end + 8; i += 2)
     {
       float out_re = K0 * expand_in[i];
       float out_im = K0 * expand_in[i + 1];
@@ -410,5 +448,6 @@ NoiseDecoder::apply_window_hann_overwrite (float *spectrum, float *fft_buffer)
       fft_buffer[i-8] = out_re;
       fft_buffer[i-7] = out_im;
     }
+  zero_float_block (block_size + 2 - conv_end, fft_buffer + conv_end);
   fft_buffer[1] = fft_buffer[block_size];
 }
@@ -24,8 +24,8 @@ class NoiseDecoder
   Random random_gen;
   NoiseBandPartition noise_band_partition;
 
-  void apply_window_bh92 (float *spectrum, float *fft_buffer);
-  void apply_window_hann_overwrite (float *spectrum, float *fft_buffer);
+  void apply_window_bh92 (float *spectrum, float *fft_buffer, size_t spectrum_end);
+  void apply_window_hann_overwrite (float *spectrum, float *fft_buffer, size_t spectrum_end);
   static float *make_k_array();
 
 public:
@@ -35,13 +35,20 @@ public:
 
   enum OutputMode { REPLACE, ADD, ADD_SPECTRUM_BH92, SET_SPECTRUM_HANN, DEBUG_UNWINDOWED, DEBUG_NO_OUTPUT };
 
+  /* level of detail for noise synthesis, see envelope_detail() */
+  enum class Detail { SILENT, LOW, FULL };
+
   void set_seed (int seed);
   void process (const uint16_t *noise_envelope,
                 float *samples,
                 OutputMode output_mode = REPLACE,
-                float portamento_stretch = 1.0);
+                float portamento_stretch = 1.0,
+                float gain = 1.0,
+                Detail detail = Detail::FULL);
   void precompute_tables();
 
+  static Detail envelope_detail (const uint16_t *noise_envelope);
+
   static size_t preferred_block_size (double mix_freq);
 };
 
@@ -0,0 +1,138 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smoscbank.hh"
+#include "smifftsynth.hh"
+#include "smmath.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+OscBank::OscBank (size_t block_size, double mix_freq) :
+  block_size (block_size),
+  mix_freq (mix_freq),
+  acc (block_size)
+{
+  assert (block_size % 4 == 0);
+
+  for (size_t i = 0; i < block_size; i++)
+    window.push_back (window_cos (2.0 * i / block_size - 1.0));
+}
+
+/* rough cost model: true if synthesizing n_partials with the oscillator bank is faster than
+ * rendering them into a spectrum and running one IFFT (including windowing / overlap-add)
+ *
+ * the constants are approximate, testifftsynthperf prints the actual timings for both
+ */
+bool
+OscBank::cheaper_than_ifft (size_t n_partials, size_t block_size)
+{
+  const double osc_cost = 1;      // per sample, for a group of four partials
+  const double ifft_cost = 0.25;  // per sample and log2 (block_size)
+
+  const size_t n_groups = (n_partials + 3) / 4;
+  return n_groups * osc_cost < ifft_cost * log2 (block_size);
+}
+
+/*
+ * add hann windowed sines to samples[0..block_size-1]
+ *
+ * phases are the phases at the start of the block, freqs should be quantized using
+ * IFFTSynth::quantized_freq() to get the same output (and phase progression) as IFFTSynth
+ */
+void
+OscBank::render_partials (size_t n_partials, const float *freqs, const float *mags, const uint *phases, float *samples)
+{
+  if (!n_partials)
+    return;
+
+  /* the recursion within one block is split into four independent chains (one for each quarter
+   * of the block), which avoids a long dependency chain and keeps the float error small
+   *
+   * SIMD lanes correspond to chains, so acc[t * 4 + c] contains sample c * chain_len + t
+   */
+  const size_t CHAINS = 4;
+  const size_t chain_len = block_size / CHAINS;
+
+  for (size_t start = 0; start < n_partials; start += 4)
+    {
+      float state_re[4][CHAINS], state_im[4][CHAINS];
+      float inc_re[4], inc_im[4];
+
+      for (size_t k = 0; k < 4; k++)
+        {
+          double phase_inc = 0, phase = 0, mag = 0;
+
+          if (start + k < n_partials)
+            {
+              phase_inc = freqs[start + k] / mix_freq * 2 * M_PI;
+              phase     = phases[start + k] / IFFTSynth::phase_to_uint_factor();
+              mag       = mags[start + k];
+            }
+          inc_re[k] = cos (phase_inc);
+          inc_im[k] = sin (phase_inc);
+
+          for (size_t c = 0; c < CHAINS; c++)
+            {
+              double s, co;
+              sm_sincos (phase + phase_inc * c * chain_len, &s, &co);
+
+              state_re[k][c] = co * mag;
+              state_im[k][c] = s * mag;
+            }
+        }
+      const bool first = (start == 0);
+
+#if defined(__SSE__) || defined(SM_ARM_SSE)
+      __m128 sre[4], sim[4], vinc_re[4], vinc_im[4];
+      for (size_t k = 0; k < 4; k++)
+        {
+          sre[k] = _mm_set_ps (state_re[k][3], state_re[k][2], state_re[k][1], state_re[k][0]);
+          sim[k] = _mm_set_ps (state_im[k][3], state_im[k][2], state_im[k][1], state_im[k][0]);
+          vinc_re[k] = _mm_set_ps (inc_re[k], inc_re[k], inc_re[k], inc_re[k]);
+          vinc_im[k] = _mm_set_ps (inc_im[k], inc_im[k], inc_im[k], inc_im[k]);
+        }
+
+      F4Vector *acc4 = reinterpret_cast<F4Vector *> (&acc[0]);
+      for (size_t t = 0; t < chain_len; t++)
+        {
+          const __m128 sum = _mm_add_ps (_mm_add_ps (sim[0], sim[1]), _mm_add_ps (sim[2], sim[3]));
+          acc4[t].v = first ? sum : _mm_add_ps (acc4[t].v, sum);
+
+          for (size_t k = 0; k < 4; k++)
+            {
+              /* (re + i * im) * (inc_re + i * inc_im) */
+              const __m128 re = _mm_sub_ps (_mm_mul_ps (sre[k], vinc_re[k]), _mm_mul_ps (sim[k], vinc_im[k]));
+              sim[k] = _mm_add_ps (_mm_mul_ps (sre[k], vinc_im[k]), _mm_mul_ps (sim[k], vinc_re[k]));
+              sre[k] = re;
+            }
+        }
+#else
+      for (size_t t = 0; t < chain_len; t++)
+        {
+          for (size_t c = 0; c < CHAINS; c++)
+            {
+              float sum = 0;
+              for (size_t k = 0; k < 4; k++)
+                {
+                  sum += state_im[k][c];
+
+                  const float re = state_re[k][c] * inc_re[k] - state_im[k][c] * inc_im[k];
+                  state_im[k][c] = state_re[k][c] * inc_im[k] + state_im[k][c] * inc_re[k];
+                  state_re[k][c] = re;
+                }
+              acc[t * 4 + c] = first ? sum : acc[t * 4 + c] + sum;
+            }
+        }
+#endif
+    }
+
+  for (size_t c = 0; c < CHAINS; c++)
+    {
+      float *out = samples + c * chain_len;
+      const float *win = &window[c * chain_len];
+
+      for (size_t t = 0; t < chain_len; t++)
+        out[t] += win[t] * acc[t * 4 + c];
+    }
+}
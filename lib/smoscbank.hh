@@ -0,0 +1,37 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smalignedarray.hh"
+
+#include <vector>
+
+namespace SpectMorph
+{
+
+/*
+ * OscBank is a time domain alternative to IFFTSynth for frames with only a few
+ * partials: it uses recursive (complex rotation) oscillators, four partials per
+ * SIMD vector, to compute the same hann windowed block that IFFTSynth (WIN_HANN)
+ * would produce for the partials.
+ *
+ * Since both produce the same output for the same (freq, mag, phase) input,
+ * a decoder can switch between them from one block to the next, and overlap-add
+ * of the windowed blocks crossfades between the two.
+ */
+class OscBank
+{
+  size_t                  block_size;
+  double                  mix_freq;
+  std::vector<float>      window;
+  AlignedArray<float,16>  acc;
+
+public:
+  OscBank (size_t block_size, double mix_freq);
+
+  static bool cheaper_than_ifft (size_t n_partials, size_t block_size);
+
+  void render_partials (size_t n_partials, const float *freqs, const float *mags, const uint *phases, float *samples);
+};
+
+}
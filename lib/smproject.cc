@@ -10,6 +10,7 @@
 #include "smuserinstrumentindex.hh"
 #include "smproject.hh"
 #include "smhexstring.hh"
+#include "smconfig.hh"
 
 #include <unistd.h>
 
@@ -141,7 +142,9 @@ Project::rebuild (MorphWavSource *wav_source)
   // trigger configuration update, this will ensure that the modules pick up
   // the nullptr from the project, so that they will stop playing and not
   // access the old WavSet anymore
-  m_morph_plan.emit_plan_changed();
+  //
+  // the plan itself doesn't change, so this doesn't mark the state as changed
+  update_synth_plan();
   m_builder_thread.add_job (builder, object_id,
     [this, object_id] (WavSet *wav_set)
       {
@@ -251,6 +254,8 @@ Project::Project() :
 void
 Project::set_mix_freq (double mix_freq)
 {
+  std::lock_guard<std::mutex> lg (m_voice_pool.mutex());
+
   /* We are creating a new MidiSynth instance here, which means that old
    * APPLY_UPDATE events can't be executed anymore (because they refer
    * to the old MidiSynth instance).
@@ -263,19 +268,38 @@ Project::set_mix_freq (double mix_freq)
   m_control_events.destroy_events (SynthControlEvent::Type::APPLY_UPDATE);
   m_control_events.unlock();
 
+  Config cfg;
+
+  /* with voice pool, voices get modules on demand (up to max_voices) */
+  const size_t max_voices = cfg.max_voices();
+  const size_t pool_size = m_voice_pool.running() ? std::min (VoicePool::INITIAL_VOICES, max_voices) : max_voices;
+
   // not rt safe, needs to be called when synthesis thread is not running
-  m_midi_synth.reset (new MidiSynth (mix_freq, 64));
+  m_midi_synth.reset (new MidiSynth (mix_freq, max_voices, pool_size, cfg.fixed_internal_rate()));
+  m_voice_pool.reset (pool_size);
+  if (m_voice_pool.running())
+    m_midi_synth->set_voice_pool (&m_voice_pool);
   m_mix_freq = mix_freq;
   m_midi_synth->set_random_seed (m_random_seed);
 
+  m_midi_synth->set_render_threads (cfg.render_threads());
+  m_midi_synth->set_spectral_mixing (cfg.spectral_mixing());
+
   // not rt safe either
-  LiveDecoder::precompute_tables (mix_freq);
+  LiveDecoder::precompute_tables (m_midi_synth->mix_freq());
 
   auto update = m_midi_synth->prepare_update (m_morph_plan);
   m_midi_synth->apply_update (update);
   m_midi_synth->set_gain (db_to_factor (m_volume));
 }
 
+/* start adapting the number of voices to the demand (before set_mix_freq) */
+void
+Project::enable_voice_pool()
+{
+  m_voice_pool.start();
+}
+
 void
 Project::set_storage_model (StorageModel model)
 {
@@ -296,28 +320,28 @@ Project::state_changed()
 }
 
 void
-Project::on_plan_changed()
+Project::update_synth_plan()
 {
-  /* FIXME: CONFIG
-   *
-   * we used to save here anyway, so state changed check could be done easily
-   * however now with fast config updates, we just save for state changed
-   * checks which is a waste of time
-   */
-  // create a deep copy (by saving/loading)
-  vector<unsigned char> plan_data;
-  m_morph_plan.save (MemOut::open (&plan_data));
-
-  if (plan_data != m_last_plan_data)
-    {
-      m_last_plan_data = plan_data;
-      state_changed();
-    }
+  /* VoicePool updates and plan updates need to be applied in the order they were prepared */
+  std::lock_guard<std::mutex> lg (m_voice_pool.mutex());
 
   MorphPlanSynth::UpdateP update = m_midi_synth->prepare_update (m_morph_plan);
   m_synth_interface->emit_apply_update (update);
 }
 
+void
+Project::on_plan_changed()
+{
+  /* plan_changed is emitted for edits (operator setters, properties, adding,
+   * removing and moving operators) and after loading a plan, but not during
+   * restore. Properties only notify if their value actually changes, so we
+   * don't need to save the plan to find out whether the state changed.
+   */
+  state_changed();
+
+  update_synth_plan();
+}
+
 void
 Project::on_operator_added (MorphOperator *op)
 {
@@ -10,6 +10,7 @@
 #include "smmorphplan.hh"
 #include "smuserinstrumentindex.hh"
 #include "smnotifybuffer.hh"
+#include "smvoicepool.hh"
 
 namespace SpectMorph
 {
@@ -100,7 +101,6 @@ private:
   double                      m_volume = -6;
   int                         m_random_seed = -1;
   MorphPlan                   m_morph_plan;
-  std::vector<unsigned char>  m_last_plan_data;
   bool                        m_state_changed_notify = false;
   StorageModel                m_storage_model = StorageModel::COPY;
 
@@ -120,11 +120,14 @@ private:
   typedef std::map<int, InstrumentMapEntry> InstrumentMap;
   InstrumentMap               m_instrument_map;
 
+  VoicePool                   m_voice_pool { this };
+
   std::vector<MorphWavSource *> list_wav_sources();
 
   Error load_internal (ZipReader& zip_reader, MorphPlan::ExtraParameters *params, bool load_wav_sources);
   void  post_load();
 
+  void update_synth_plan();
   void on_plan_changed();
   void on_operator_added (MorphOperator *op);
   void on_operator_removed (MorphOperator *op);
@@ -146,6 +149,7 @@ public:
 
   bool try_update_synth() noexcept SM_CLANG_NONBLOCKING;
   void set_mix_freq (double mix_freq);
+  void enable_voice_pool();
   void set_storage_model (StorageModel model);
   void set_state_changed_notify (bool notify);
   void state_changed();
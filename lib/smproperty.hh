@@ -28,6 +28,17 @@ protected:
   MorphOperator                  *m_op;
   std::string                     m_identifier;
   double                          m_modulation_range_ui = 1;
+
+  /* notify only if the value actually changes (every notification is a plan change, which marks the project as modified) */
+  template<class T, class V> void
+  set_value (T *value, V new_value)
+  {
+    if (*value != T (new_value))
+      {
+        *value = T (new_value);
+        signal_value_changed();
+      }
+  }
 public:
   Property (MorphOperator *op, const std::string& identifier);
   virtual ~Property();
@@ -143,14 +154,12 @@ public:
   void
   set (int v) override
   {
-    *m_value = std::clamp (v, min(), max());
-    signal_value_changed();
+    set_value (m_value, std::clamp (v, min(), max()));
   }
   void
   reset_to_default() override
   {
-    *m_value = m_default;
-    signal_value_changed();
+    set_value (m_value, m_default);
   }
   void
   save (OutFile& out_file) override
@@ -196,14 +205,12 @@ public:
   void
   set (int v) override
   {
-    *m_value = m_valid_values[std::clamp (v, min(), max())];
-    signal_value_changed();
+    set_value (m_value, m_valid_values[std::clamp (v, min(), max())]);
   }
   void
   reset_to_default() override
   {
-    *m_value = m_default;
-    signal_value_changed();
+    set_value (m_value, m_default);
   }
   std::string label() override { return m_label; }
 
@@ -290,14 +297,12 @@ public:
   void
   set (int v) override
   {
-    *m_value = v ? true : false;
-    signal_value_changed();
+    set_value (m_value, v ? true : false);
   }
   void
   reset_to_default() override
   {
-    *m_value = m_default;
-    signal_value_changed();
+    set_value (m_value, m_default);
   }
   void
   save (OutFile& out_file) override
@@ -383,14 +388,16 @@ public:
   void
   set (int v) override
   {
+    const int old_value = m_read_func();
+
     m_write_func (v);
-    signal_value_changed();
+    if (m_read_func() != old_value)
+      signal_value_changed();
   }
   void
   reset_to_default() override
   {
-    m_write_func (m_default);
-    signal_value_changed();
+    set (m_default);
   }
   std::string label() override { return m_label; }
   std::string value_label() override { return "-"; }
@@ -452,14 +459,12 @@ public:
   void
   set (int v) override
   {
-    *m_value = m_range.clamp (ui2value (v / 1000.));
-    signal_value_changed();
+    set_value (m_value, m_range.clamp (ui2value (v / 1000.)));
   }
   void
   reset_to_default () override
   {
-    *m_value = m_default;
-    signal_value_changed();
+    set_value (m_value, m_default);
   }
   float
   get_float() const override
@@ -469,8 +474,7 @@ public:
   void
   set_float (float f) override
   {
-    *m_value = m_range.clamp (f);
-    signal_value_changed();
+    set_value (m_value, m_range.clamp (f));
   }
   std::string
   get_edit_str() override
@@ -38,9 +38,11 @@ RTAudioBlock::sort_freqs()
   std::sort (pvec, pvec + N, pd_cmp);
 
   // replace partial data with sorted partial data
+  uint16_t *freqs_w = freqs.data_writable();
+  uint16_t *mags_w = mags.data_writable();
   for (size_t p = 0; p < N; p++)
     {
-      freqs[p] = pvec[p].freq;
-      mags[p] = pvec[p].mag;
+      freqs_w[p] = pvec[p].freq;
+      mags_w[p] = pvec[p].mag;
     }
 }
@@ -67,6 +67,14 @@ public:
   }
 };
 
+/*
+ * RTVector can either own its data (allocated from the RTMemoryArea) or borrow
+ * read-only data from somewhere else (typically AudioBlock storage), which avoids
+ * copying frames that are only read by the decoder
+ *
+ * reading never copies; borrowed data is copied on write: data_writable() makes a
+ * private copy first, so code that modifies a block must use it instead of data()
+ */
 template<class T>
 class RTVector
 {
@@ -76,6 +84,21 @@ class RTVector
   T            *m_start = nullptr;
   size_t        m_size = 0;
   size_t        m_capacity = 0;
+  bool          m_borrowed = false;
+
+  void
+  make_writable()
+  {
+    if (m_borrowed)
+      {
+        T *start = (T *) m_memory_area->alloc (sizeof (T) * m_size);
+        std::copy (m_start, m_start + m_size, start);
+
+        m_start = start;
+        m_capacity = m_size;
+        m_borrowed = false;
+      }
+  }
 public:
   RTVector (RTMemoryArea *memory_area) :
     m_memory_area (memory_area)
@@ -89,53 +112,88 @@ public:
   void
   assign (const RTVector<T>& vec)
   {
-    assign (vec.m_start, vec.m_start + vec.m_size);
+    if (vec.m_borrowed)
+      borrow (vec.m_start, vec.m_size);
+    else
+      assign (vec.m_start, vec.m_start + vec.m_size);
   }
   template<class It>
   void
   assign (It start_it, It end_it)
   {
-    assert (m_size == 0 && m_capacity == 0);
+    assert (m_borrowed || (m_size == 0 && m_capacity == 0));
 
     size_t size = end_it - start_it;
     set_capacity (size);
     std::copy (start_it, end_it, m_start);
     m_size = size;
   }
+  /* the borrowed data must stay valid and unmodified until the memory area is freed
+   *
+   * borrow(), assign() and set_capacity() may replace a borrowed view, but not data we own
+   */
+  void
+  borrow (const std::vector<T>& vec)
+  {
+    borrow (vec.data(), vec.size());
+  }
+  void
+  borrow (const T *start, size_t size)
+  {
+    assert (m_borrowed || (m_size == 0 && m_capacity == 0));
+
+    m_start = const_cast<T *> (start);
+    m_size = size;
+    m_capacity = 0;
+    m_borrowed = true;
+  }
+  bool
+  borrowed() const
+  {
+    return m_borrowed;
+  }
   size_t
   size() const
   {
     return m_size;
   }
-  T *
+  const T *
   data() const
   {
     return m_start;
   }
+  T *
+  data_writable()
+  {
+    make_writable();
+    return m_start;
+  }
+  void
+  set (size_t idx, const T& t)
+  {
+    data_writable()[idx] = t;
+  }
   void
   set_capacity (size_t capacity)
   {
-    assert (m_size == 0 && m_capacity == 0);
+    assert (m_borrowed || (m_size == 0 && m_capacity == 0));
 
     m_start = (T *) m_memory_area->alloc (sizeof (T) * capacity);
+    m_size = 0;
     m_capacity = capacity;
+    m_borrowed = false;
   }
   void
   push_back (const T& t)
   {
-    assert (m_size < m_capacity);
+    assert (!m_borrowed && m_size < m_capacity);
     m_start[m_size++] = t;
   }
-  T&
-  back()
+  const T&
+  back() const
   {
     return m_start[m_size - 1];
   }
-  T&
-  operator[] (size_t idx)
-  {
-    return m_start[idx];
-  }
   const T&
   operator[] (size_t idx) const
   {
@@ -166,6 +224,13 @@ public:
     mags.assign (audio_block.mags);
     noise.assign (audio_block.noise);
   }
+  void
+  borrow (const AudioBlock& audio_block)
+  {
+    freqs.borrow (audio_block.freqs);
+    mags.borrow (audio_block.mags);
+    noise.borrow (audio_block.noise);
+  }
   RTVector<uint16_t> freqs;
   RTVector<uint16_t> mags;
   RTVector<uint16_t> noise;
@@ -0,0 +1,129 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smrtworkerpool.hh"
+
+#include <assert.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+using namespace SpectMorph;
+
+static inline void
+cpu_relax()
+{
+#ifdef __SSE__
+  _mm_pause();
+#elif defined (__aarch64__)
+  __asm__ __volatile__ ("yield");
+#endif
+}
+
+RTWorkerPool::RTWorkerPool (int n_threads, double spin_time_ms) :
+  spin_time_ms (spin_time_ms)
+{
+  /* thread_index 0 is the calling thread, so we only start n_threads - 1 workers */
+  for (int t = 1; t < n_threads; t++)
+    threads.emplace_back (&RTWorkerPool::worker_thread, this, t);
+}
+
+RTWorkerPool::~RTWorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lg (mutex);
+    quit = true;
+  }
+  cond.notify_all();
+
+  for (auto& t : threads)
+    t.join();
+}
+
+int
+RTWorkerPool::n_threads() const
+{
+  return threads.size() + 1;
+}
+
+void
+RTWorkerPool::run_jobs (uint64 generation, int thread_index)
+{
+  uint64 s = state.load();
+  while (state_generation (s) == generation && state_next_job (s) < state_n_jobs (s))
+    {
+      /* claim next job; this fails (and reloads s) if another thread was faster */
+      if (state.compare_exchange_weak (s, s + 1))
+        {
+          job_func (job_data, state_next_job (s), thread_index);
+          jobs_done.fetch_add (1);
+
+          s = state.load();
+        }
+    }
+}
+
+void
+RTWorkerPool::run_internal (size_t n_jobs, JobFunc func, void *data)
+{
+  assert (n_jobs <= MAX_JOBS);
+
+  if (threads.empty())
+    {
+      for (size_t job = 0; job < n_jobs; job++)
+        func (data, job, 0);
+      return;
+    }
+
+  job_func = func;
+  job_data = data;
+  jobs_done.store (0);
+
+  const uint64 generation = (state_generation (state.load()) + 1) & 0xffffffff;
+  state.store ((generation << 32) | (n_jobs << 16));
+
+  if (n_parked.load() > 0)
+    {
+      /* never block the synthesis thread: if we can't get the lock, parked
+       * workers will be woken up for the next batch of jobs
+       */
+      if (mutex.try_lock())
+        {
+          mutex.unlock();
+          cond.notify_all();
+        }
+    }
+  run_jobs (generation, 0);
+
+  /* wait for jobs that are still running in worker threads */
+  while (jobs_done.load() < n_jobs)
+    cpu_relax();
+}
+
+void
+RTWorkerPool::worker_thread (int thread_index)
+{
+  uint64 generation = state_generation (state.load());
+
+  while (!quit.load())
+    {
+      double spin_start = get_time();
+      while (state_generation (state.load()) == generation && !quit.load())
+        {
+          if ((get_time() - spin_start) * 1000 < spin_time_ms)
+            {
+              cpu_relax();
+            }
+          else
+            {
+              std::unique_lock<std::mutex> lock (mutex);
+
+              n_parked++;
+              cond.wait (lock, [&] { return state_generation (state.load()) != generation || quit.load(); });
+              n_parked--;
+            }
+        }
+      generation = state_generation (state.load());
+      run_jobs (generation, thread_index);
+    }
+}
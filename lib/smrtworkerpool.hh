@@ -0,0 +1,76 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smutils.hh"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+namespace SpectMorph
+{
+
+/*
+ * RTWorkerPool distributes a number of independent jobs over a set of worker
+ * threads, to be used from the synthesis thread.
+ *
+ * The synthesis thread publishes the jobs using a single atomic (generation,
+ * job count, next job), so handing off work doesn't require locks or memory
+ * allocations. The calling thread always participates in running the jobs,
+ * so even if the workers are not available (sleeping, preempted), run() will
+ * finish all jobs by itself.
+ *
+ * After finishing their work, workers spin for a short time waiting for the
+ * next batch of jobs. If no jobs arrive, they park on a condition variable.
+ * The synthesis thread will only wake parked workers if this doesn't block
+ * (try_lock), otherwise the workers miss one batch of jobs.
+ */
+class RTWorkerPool
+{
+  SPECTMORPH_CLASS_NON_COPYABLE (RTWorkerPool);
+
+  typedef void (*JobFunc) (void *data, size_t job, int thread_index);
+
+  std::vector<std::thread>  threads;
+  std::mutex                mutex;
+  std::condition_variable   cond;
+  std::atomic<bool>         quit { false };
+  std::atomic<int>          n_parked { 0 };
+  std::atomic<uint64>       state { 0 };  // generation (32 bits) | job count (16 bits) | next job (16 bits)
+  std::atomic<size_t>       jobs_done { 0 };
+  double                    spin_time_ms;
+
+  JobFunc                   job_func = nullptr;
+  void                     *job_data = nullptr;
+
+  static uint64 state_generation (uint64 s) { return s >> 32; }
+  static uint64 state_n_jobs (uint64 s)     { return (s >> 16) & 0xffff; }
+  static uint64 state_next_job (uint64 s)   { return s & 0xffff; }
+
+  void run_jobs (uint64 generation, int thread_index);
+  void run_internal (size_t n_jobs, JobFunc func, void *data);
+  void worker_thread (int thread_index);
+public:
+  static constexpr size_t MAX_JOBS = 0xffff;
+
+  RTWorkerPool (int n_threads, double spin_time_ms = 1);
+  ~RTWorkerPool();
+
+  /* number of threads that may run jobs: calling thread (thread_index 0) + workers */
+  int n_threads() const;
+
+  /* run func (job, thread_index) for each job in [0, n_jobs) and wait until all jobs are done */
+  template<class Func> void
+  run (size_t n_jobs, Func& func)
+  {
+    auto trampoline = [] (void *data, size_t job, int thread_index) {
+      (*static_cast<Func *> (data)) (job, thread_index);
+    };
+    run_internal (n_jobs, trampoline, &func);
+  }
+};
+
+}
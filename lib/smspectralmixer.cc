@@ -0,0 +1,159 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smspectralmixer.hh"
+#include "smnoisedecoder.hh"
+#include "smblockutils.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::min;
+
+SpectralMixer::Lane::Lane (size_t block_size, float mix_freq) :
+  ifft_synth (block_size, mix_freq, IFFTSynth::WIN_HANN),
+  samples (block_size)
+{
+  ifft_synth.clear_partials();
+}
+
+SpectralMixer::SpectralMixer (float mix_freq) :
+  m_block_size (NoiseDecoder::preferred_block_size (mix_freq))
+{
+  /* not rt safe: allocate everything here */
+  for (size_t l = 0; l < MAX_LANES; l++)
+    lanes.emplace_back (new Lane (m_block_size, mix_freq));
+}
+
+size_t
+SpectralMixer::block_size() const
+{
+  return m_block_size;
+}
+
+size_t
+SpectralMixer::max_n_values() const
+{
+  /* with larger blocks, one lane could need two IFFTs during one block */
+  return m_block_size / 2;
+}
+
+/* return spectrum for the next block of a voice that starts at offset (relative to the
+ * start of the current block), or nullptr if all lanes are in use
+ */
+IFFTSynth *
+SpectralMixer::ifft_synth (size_t offset)
+{
+  const size_t half_block = m_block_size / 2;
+  assert (offset < half_block);
+
+  Lane *free_lane = nullptr;
+  for (auto& lane : lanes)
+    {
+      if (lane->active)
+        {
+          if (lane->pos + offset == half_block)
+            {
+              lane->have_spectrum = true;
+              return &lane->ifft_synth;
+            }
+        }
+      else if (!free_lane)
+        {
+          free_lane = lane.get();
+        }
+    }
+  if (free_lane)
+    {
+      zero_float_block (m_block_size, &free_lane->samples[0]);
+
+      free_lane->active = true;
+      free_lane->pos = half_block - offset;
+      free_lane->idle_blocks = 0;
+      free_lane->have_spectrum = true;
+      return &free_lane->ifft_synth;
+    }
+  return nullptr;
+}
+
+/* remove gain * samples from the output of the lane that belongs to lane_ifft_synth, starting
+ * at the start of the current block (the samples before the current position are already played)
+ */
+void
+SpectralMixer::subtract (const IFFTSynth *lane_ifft_synth, size_t n_values, const float *samples, float gain)
+{
+  assert (n_values <= m_block_size);
+
+  for (auto& lane : lanes)
+    {
+      if (&lane->ifft_synth == lane_ifft_synth)
+        {
+          assert (lane->active);
+
+          for (size_t i = lane->pos; i < n_values; i++)
+            lane->samples[i] -= samples[i] * gain;
+          return;
+        }
+    }
+  assert (false);
+}
+
+size_t
+SpectralMixer::active_lanes() const
+{
+  size_t n = 0;
+  for (auto& lane : lanes)
+    if (lane->active)
+      n++;
+  return n;
+}
+
+void
+SpectralMixer::next_block (Lane& lane)
+{
+  const size_t half_block = m_block_size / 2;
+
+  std::copy_n (&lane.samples[half_block], half_block, &lane.samples[0]);
+  zero_float_block (half_block, &lane.samples[half_block]);
+
+  if (lane.have_spectrum)
+    {
+      lane.ifft_synth.get_samples (&lane.samples[0], IFFTSynth::ADD);
+      lane.ifft_synth.clear_partials();
+
+      lane.have_spectrum = false;
+      lane.idle_blocks = 0;
+    }
+  else
+    {
+      /* free lane if the output of the last spectrum is complete */
+      lane.idle_blocks++;
+      if (lane.idle_blocks >= 2)
+        lane.active = false;
+    }
+  lane.pos = 0;
+}
+
+void
+SpectralMixer::process (float *output, size_t n_values)
+{
+  const size_t half_block = m_block_size / 2;
+
+  for (auto& lane : lanes)
+    {
+      size_t i = 0;
+      while (lane->active && i < n_values)
+        {
+          if (lane->pos == half_block)
+            {
+              next_block (*lane);
+              continue;
+            }
+          size_t todo = min (n_values - i, half_block - lane->pos);
+          Block::add (todo, output + i, &lane->samples[lane->pos]);
+
+          lane->pos += todo;
+          i += todo;
+        }
+    }
+}
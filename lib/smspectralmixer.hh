@@ -0,0 +1,63 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smifftsynth.hh"
+#include "smalignedarray.hh"
+
+#include <memory>
+
+namespace SpectMorph
+{
+
+/*
+ * SpectralMixer allows voices to share IFFT synthesis: instead of running
+ * their own IFFTs, LiveDecoder instances can add the spectrum of their next
+ * (sine + noise) block to a shared spectrum, which gets transformed once for
+ * all voices.
+ *
+ * Voices can only share a spectrum if their block grids are aligned, so there
+ * are a number of lanes, one for each block grid position (offset) in use.
+ * Each lane runs one IFFT and overlap-add per half block, and the output of
+ * all lanes is added to the synth output by process().
+ *
+ * Usage (synthesis thread, blocks must not be larger than half the block size):
+ *  - voices call ifft_synth (offset) during voice processing for the block
+ *  - after all voices have been processed, process() adds the mixed output
+ *  - voices can take back the output of blocks they have mixed using subtract()
+ */
+class SpectralMixer
+{
+  SPECTMORPH_CLASS_NON_COPYABLE (SpectralMixer);
+
+  static constexpr size_t MAX_LANES = 16;
+
+  struct Lane
+  {
+    IFFTSynth               ifft_synth;
+    AlignedArray<float,16>  samples;
+    size_t                  pos = 0;      // position within current half block
+    bool                    active = false;
+    bool                    have_spectrum = false;
+    int                     idle_blocks = 0;
+
+    Lane (size_t block_size, float mix_freq);
+  };
+  std::vector<std::unique_ptr<Lane>> lanes;
+
+  size_t        m_block_size;
+
+  void next_block (Lane& lane);
+public:
+  SpectralMixer (float mix_freq);
+
+  size_t block_size() const;
+  size_t max_n_values() const;
+
+  IFFTSynth *ifft_synth (size_t offset);
+  void       subtract (const IFFTSynth *lane_ifft_synth, size_t n_values, const float *samples, float gain);
+  size_t     active_lanes() const;
+  void       process (float *output, size_t n_values);
+};
+
+}
@@ -111,6 +111,16 @@ public:
       SynthControlEvent::Type::APPLY_UPDATE);
   }
   void
+  emit_voice_limit (size_t limit, uint serial)
+  {
+    send_control_event (
+      [=] (Project *project)
+        {
+          project->midi_synth()->set_voice_limit (limit, serial);
+        },
+      SynthControlEvent::Type::APPLY_UPDATE);
+  }
+  void
   emit_update_gain (double gain)
   {
     send_control_event (
@@ -121,6 +131,16 @@ public:
       SynthControlEvent::Type::GENERIC);
   }
   void
+  emit_dsp_profile (bool dsp_profile)
+  {
+    send_control_event (
+      [=] (Project *project)
+        {
+          project->midi_synth()->set_dsp_profile (dsp_profile);
+        },
+      SynthControlEvent::Type::GENERIC);
+  }
+  void
   emit_add_rebuild_result (int object_id, WavSet *take_wav_set)
   {
 
@@ -14,6 +14,10 @@
 #include <sys/stat.h>
 #include <glib.h>
 
+#ifndef SM_OS_WINDOWS
+#include <unistd.h>
+#endif
+
 #ifdef SM_OS_MACOS
 #include <xlocale.h>
 #include <CoreFoundation/CoreFoundation.h>
@@ -519,6 +523,23 @@ get_time()
   return tv.tv_sec + tv.tv_usec / 1000000.0;
 }
 
+size_t
+sm_physical_memory()
+{
+#ifdef SM_OS_WINDOWS
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof (status);
+  if (GlobalMemoryStatusEx (&status))
+    return status.ullTotalPhys;
+#else
+  long pages = sysconf (_SC_PHYS_PAGES);
+  long page_size = sysconf (_SC_PAGE_SIZE);
+  if (pages > 0 && page_size > 0)
+    return size_t (pages) * size_t (page_size);
+#endif
+  return 0;
+}
+
 string
 note_to_text (int midi_note)
 {
@@ -195,6 +195,7 @@ std::string sha1_hash (const unsigned char *data, size_t len);
 std::string sha1_hash (const std::string& str);
 
 double get_time();
+size_t sm_physical_memory();  // bytes of RAM, 0 if unknown
 
 std::string note_to_text (int midi_note);
 std::string note_to_text_verbose (int midi_note);
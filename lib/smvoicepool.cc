@@ -0,0 +1,139 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smvoicepool.hh"
+#include "smproject.hh"
+#include "smmidisynth.hh"
+#include "smsynthinterface.hh"
+
+using namespace SpectMorph;
+
+using std::max;
+using std::min;
+
+VoicePool::VoicePool (Project *project) :
+  m_project (project)
+{
+}
+
+VoicePool::~VoicePool()
+{
+  if (m_thread.joinable())
+    {
+      m_mutex.lock();
+      m_thread_quit = true;
+      m_cond.notify_all();
+      m_mutex.unlock();
+
+      m_thread.join();
+    }
+}
+
+std::mutex&
+VoicePool::mutex()
+{
+  return m_mutex;
+}
+
+void
+VoicePool::start()
+{
+  if (!m_thread.joinable())
+    m_thread = std::thread (&VoicePool::run, this);
+}
+
+bool
+VoicePool::running() const
+{
+  return m_thread.joinable();
+}
+
+/* called with mutex locked after the MidiSynth was replaced */
+void
+VoicePool::reset (size_t pool_size)
+{
+  m_pool_size = pool_size;
+  m_voice_limit = pool_size;
+  m_window_voices = 0;
+  m_window_start = get_time();
+}
+
+void
+VoicePool::run()
+{
+  std::unique_lock<std::mutex> lock (m_mutex);
+
+  while (!m_thread_quit)
+    {
+      m_cond.wait_for (lock, std::chrono::milliseconds (UPDATE_MS), [this] { return m_thread_quit || m_update_requested.load(); });
+      m_update_requested.store (false);
+
+      if (!m_thread_quit)
+        update();
+    }
+}
+
+/* wake up voice pool thread, because notes are waiting for voices (synthesis thread)
+ *
+ * like RTWorkerPool, this never blocks: if the mutex is busy, the thread will see
+ * the request once it waits again, or MidiSynth repeats the request in the next block
+ */
+void
+VoicePool::request_update()
+{
+  m_update_requested.store (true);
+  if (m_mutex.try_lock())
+    {
+      m_mutex.unlock();
+      m_cond.notify_all();
+    }
+}
+
+void
+VoicePool::update()
+{
+  MidiSynth *midi_synth = m_project->midi_synth();
+  if (!midi_synth)
+    return;
+
+  const double now = get_time();
+  const size_t max_voices = midi_synth->max_voices();
+  const size_t want = min (max (midi_synth->take_peak_voice_count() + HEADROOM, MIN_VOICES), max_voices);
+
+  m_window_voices = max (m_window_voices, want);
+  if (want > m_voice_limit)
+    {
+      if (want > m_pool_size)
+        {
+          /* grow: at least double the pool size to react quickly to large chords */
+          const size_t new_pool_size = max (want, min (m_pool_size * 2, max_voices));
+
+          m_project->synth_interface()->emit_apply_update (midi_synth->prepare_pool_update (new_pool_size));
+          m_pool_size = new_pool_size;
+        }
+      else
+        {
+          /* shrinking was not finished: allow all voices in pool again */
+          m_project->synth_interface()->emit_voice_limit (m_pool_size, ++m_limit_serial);
+        }
+      m_voice_limit = m_pool_size;
+      m_window_voices = 0;
+      m_window_start = now;
+    }
+  else if (now - m_window_start > SHRINK_DELAY)
+    {
+      if (m_window_voices < m_voice_limit)
+        {
+          /* shrink (step 1): don't allocate voices above the limit anymore */
+          m_voice_limit = m_window_voices;
+          m_project->synth_interface()->emit_voice_limit (m_voice_limit, ++m_limit_serial);
+        }
+      m_window_voices = 0;
+      m_window_start = now;
+    }
+  if (m_voice_limit < m_pool_size && midi_synth->voices_above_limit_idle (m_limit_serial))
+    {
+      /* shrink (step 2): voices above the limit are idle, remove their modules */
+      m_project->synth_interface()->emit_apply_update (midi_synth->prepare_pool_update (m_voice_limit));
+      m_pool_size = m_voice_limit;
+    }
+}
@@ -0,0 +1,69 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smutils.hh"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+namespace SpectMorph
+{
+
+class Project;
+
+/* VoicePool: adapts the number of MidiSynth voices that have modules to the demand
+ *
+ *  - grow: modules for new voices are created in the voice pool thread and handed
+ *    over to the synthesis thread as control event (like plan updates)
+ *  - shrink: if fewer voices were used for some time, voice allocation is limited
+ *    first; once the voices above the limit are idle, their modules are removed
+ *
+ * the pool starts with INITIAL_VOICES; notes that don't fit into the pool wait until
+ * it has grown, only if the number of voices reaches the maximum (Config::max_voices),
+ * MidiSynth steals voices
+ *
+ * MIN_VOICES and HEADROOM are large enough that normal chords don't have to wait;
+ * if notes do have to wait, MidiSynth wakes up the voice pool thread immediately
+ */
+class VoicePool
+{
+  Project                  *m_project = nullptr;
+
+  std::mutex                m_mutex;
+  std::thread               m_thread;
+  std::condition_variable   m_cond;
+  bool                      m_thread_quit = false;
+  std::atomic<bool>         m_update_requested { false };
+
+  size_t                    m_pool_size = 0;
+  size_t                    m_voice_limit = 0;
+  uint                      m_limit_serial = 0;
+  size_t                    m_window_voices = 0;
+  double                    m_window_start = 0;
+
+  void run();
+  void update();
+
+public:
+  static constexpr size_t INITIAL_VOICES = 64;
+  static constexpr size_t MIN_VOICES     = 32;
+  static constexpr size_t HEADROOM       = 16;    // free voices to keep available
+  static constexpr double SHRINK_DELAY   = 10;    // seconds of lower demand before shrinking
+  static constexpr int    UPDATE_MS      = 50;
+
+  VoicePool (Project *project);
+  ~VoicePool();
+
+  /* needs to be locked while preparing and sending plan updates, or replacing the MidiSynth */
+  std::mutex& mutex();
+
+  void start();
+  bool running() const;
+  void reset (size_t pool_size);
+  void request_update();
+};
+
+}
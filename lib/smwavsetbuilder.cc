@@ -7,6 +7,8 @@
 #include "smaudiotool.hh"
 
 #include <mutex>
+#include <thread>
+#include <condition_variable>
 
 using namespace SpectMorph;
 
@@ -68,41 +70,129 @@ WavSetBuilder::add_sample (const Sample *sample)
 bool
 WavSetBuilder::killed()
 {
+  // the kill function may be called from several encoder threads
+  std::lock_guard<std::mutex> lg (kill_mutex);
+
   return kill_function && kill_function();
 }
 
+void
+WavSetBuilder::clip_range (const SampleData& sd, int& iclipstart, int& iclipend)
+{
+  const WavData& wav_data = sd.shared->wav_data();
+
+  /* if we have a loop, the loop end determines the real end of the recording */
+  iclipend = wav_data.n_values();
+  if (sd.loop == Sample::Loop::NONE)
+    iclipend = std::clamp<int> (sm_round_positive (sd.clip_end_ms * wav_data.mix_freq() / 1000.0), 0, wav_data.n_values());
+
+  iclipstart = std::clamp (sm_round_positive (sd.clip_start_ms * wav_data.mix_freq() / 1000.0), 0, iclipend);
+}
+
 WavSet *
 WavSetBuilder::run()
 {
+  const size_t n_samples = sample_data_vec.size();
+
+  /* use one thread per cpu core; if there are fewer samples than cores, the
+   * remaining cores are used by the encoder for frame-parallel analysis
+   */
+  const int n_cores = n_threads > 0 ? n_threads : std::max<int> (std::thread::hardware_concurrency(), 1);
+  const int n_workers = std::clamp<int> (n_samples, 1, n_cores);
+  const int encoder_threads = std::max (n_cores / n_workers, 1);
+
+  /* during encoding, memory usage is dominated by the STFT data of the clipped sample
+   *  - per frame: original_fft + noise spectrum (block_size * zeropad each) + debug_samples (frame_size)
+   *  - frame_step is frame_size / 4, zeropad is 4 and block_size is up to 2 * frame_size
+   * which results in up to 68 floats per input sample
+   */
+  vector<size_t> memory_estimate;
   for (auto& sd : sample_data_vec)
     {
-      /* clipping */
-      const WavData& wav_data = sd.shared->wav_data();
-      assert (wav_data.n_channels() == 1);
+      assert (sd.shared->wav_data().n_channels() == 1);
+
+      int iclipstart, iclipend;
+      clip_range (sd, iclipstart, iclipend);
+      memory_estimate.push_back ((iclipend - iclipstart) * ENCODER_BYTES_PER_SAMPLE);
+    }
+
+  auto locked_kill_function = [this]() { return killed(); };
+
+  vector<Audio *> audio_vec (n_samples);
+
+  std::mutex              mutex;
+  std::condition_variable cond;
+  size_t                  next_sample = 0;
+  size_t                  memory_used = 0;
+  int                     n_running = 0;
+  bool                    failed = false;
+
+  auto worker = [&]()
+    {
+      std::unique_lock<std::mutex> lock (mutex);
+      for (;;)
+        {
+          /* start the next encode if it fits into the memory budget (a single encode is always allowed) */
+          cond.wait (lock, [&]() {
+            return failed || next_sample == n_samples || n_running == 0 || memory_used + memory_estimate[next_sample] <= memory_budget;
+          });
+          if (failed || next_sample == n_samples)
+            return;
+
+          const size_t s = next_sample++;
+          memory_used += memory_estimate[s];
+          n_running++;
+          lock.unlock();
+
+          const SampleData& sd = sample_data_vec[s];
+          const WavData& wav_data = sd.shared->wav_data();
+
+          int iclipstart, iclipend;
+          clip_range (sd, iclipstart, iclipend);
+
+          Audio *audio = InstEncCache::the()->encode (cache_group, wav_data, sd.shared->wav_data_hash(), sd.midi_note, iclipstart, iclipend,
+                                                      encoder_config, locked_kill_function, encoder_threads);
+          if (audio && keep_samples)
+            audio->original_samples = wav_data.samples(); // FIXME: clipping?
+
+          lock.lock();
+          memory_used -= memory_estimate[s];
+          n_running--;
+          audio_vec[s] = audio;
+          if (!audio) // killed? -> other encoders will also see the kill function
+            failed = true;
+          cond.notify_all();
+        }
+    };
+
+  InstEncCache::the(); // create singleton before starting threads
 
-      /* if we have a loop, the loop end determines the real end of the recording */
-      int iclipend = wav_data.n_values();
-      if (sd.loop == Sample::Loop::NONE)
-        iclipend = std::clamp<int> (sm_round_positive (sd.clip_end_ms * wav_data.mix_freq() / 1000.0), 0, wav_data.n_values());
+  vector<std::thread> threads;
+  for (int t = 1; t < n_workers; t++)
+    threads.emplace_back (worker);
 
-      int iclipstart = std::clamp (sm_round_positive (sd.clip_start_ms * wav_data.mix_freq() / 1000.0), 0, iclipend);
+  worker();
 
+  for (auto& thread : threads)
+    thread.join();
+
+  for (size_t s = 0; s < n_samples; s++)
+    {
+      if (!audio_vec[s])
+        continue;
 
       WavSetWave new_wave;
-      new_wave.midi_note = sd.midi_note;
+      new_wave.midi_note = sample_data_vec[s].midi_note;
       new_wave.channel = 0;
       new_wave.velocity_range_min = 0;
       new_wave.velocity_range_max = 127;
-      new_wave.audio = InstEncCache::the()->encode (cache_group, wav_data, sd.shared->wav_data_hash(), sd.midi_note, iclipstart, iclipend, encoder_config, kill_function);
-
-      if (!new_wave.audio) // killed?
-        return nullptr;
-
-      if (keep_samples)
-        new_wave.audio->original_samples = wav_data.samples(); // FIXME: clipping?
+      new_wave.audio = audio_vec[s];
 
       wav_set->waves.push_back (new_wave);
     }
+  if (failed)
+    return nullptr;
+
   apply_loop_settings();
   apply_volume_settings();
   apply_auto_volume();
@@ -120,6 +210,30 @@ WavSetBuilder::set_kill_function (const std::function<bool()>& new_kill_function
   kill_function = new_kill_function;
 }
 
+/* by default, encoders may use a quarter of the physical memory (1 GiB if unknown) */
+size_t
+WavSetBuilder::default_memory_budget()
+{
+  const size_t physical_memory = sm_physical_memory();
+  if (physical_memory)
+    return physical_memory / 4;
+
+  return size_t (1024) * 1024 * 1024;
+}
+
+void
+WavSetBuilder::set_memory_budget (size_t bytes)
+{
+  memory_budget = bytes;
+}
+
+/* number of threads used for encoding (0: one per cpu core) */
+void
+WavSetBuilder::set_threads (int new_n_threads)
+{
+  n_threads = new_n_threads;
+}
+
 void
 WavSetBuilder::apply_volume_settings()
 {
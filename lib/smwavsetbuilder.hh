@@ -7,6 +7,8 @@
 #include "smwavset.hh"
 #include "sminstenccache.hh"
 
+#include <mutex>
+
 namespace SpectMorph
 {
 
@@ -29,8 +31,12 @@ class WavSetBuilder
   InstEncCache::Group       *cache_group = nullptr;
 
   std::function<bool()>      kill_function;
+  std::mutex                 kill_mutex;
   bool killed();
 
+  size_t                     memory_budget = default_memory_budget();
+  int                        n_threads = 0;
+
   double                     global_volume = 0;
   Instrument::AutoVolume     auto_volume;
   Instrument::AutoTune       auto_tune;
@@ -43,11 +49,18 @@ class WavSetBuilder
   void apply_auto_tune();
 
   void add_sample (const Sample *sample);
+  void clip_range (const SampleData& sd, int& iclipstart, int& iclipend);
 public:
+  /* samples are encoded in parallel, as long as the estimated encoder memory fits into the budget */
+  static constexpr size_t ENCODER_BYTES_PER_SAMPLE = 300;
+  static size_t default_memory_budget();
+
   WavSetBuilder (const Instrument *instrument, bool keep_samples);
   ~WavSetBuilder();
 
   void set_kill_function (const std::function<bool()>& kill_function);
+  void set_memory_budget (size_t bytes);
+  void set_threads (int n_threads);
   void set_cache_group (InstEncCache::Group *group);
   WavSet *run();
 };
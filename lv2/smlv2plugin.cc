@@ -46,6 +46,7 @@ LV2Plugin::LV2Plugin (double mix_freq) :
   notify_port (NULL),
   log (NULL)
 {
+  project.enable_voice_pool();
   project.set_mix_freq (mix_freq);
   project.set_storage_model (Project::StorageModel::REFERENCE);
   project.set_state_changed_notify (true);
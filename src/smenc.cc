@@ -77,6 +77,7 @@ struct Options
   bool          fundamental_freq_detect_freq = false;
   int           fundamental_args = 0;
   int           optimization_level;
+  int           n_threads = 0;
   double        loop_start;
   double        loop_end;
   Audio::LoopType loop_type;
@@ -188,6 +189,14 @@ Options::parse (int   *argc_p,
               exit (1);
             }
         }
+      else if (check_arg (argc, argv, &i, "-j", &opt_arg))
+        {
+          if (!sm_try_atoi (opt_arg, n_threads) || n_threads < 1)
+            {
+              fprintf (stderr, "%s: invalid number of threads '%s', should be integer >= 1\n", options.program_name.c_str(), opt_arg);
+              exit (1);
+            }
+        }
       else if (check_arg (argc, argv, &i, "-s"))
         {
           strip_models = true;
@@ -273,6 +282,7 @@ Options::print_usage ()
   sm_printf (" -F                          automatically detect fundamental frequency\n");
   sm_printf (" -M                          automatically detect midi note\n");
   sm_printf (" -O <level>                  set optimization level\n");
+  sm_printf (" -j <threads>                use <threads> threads for analysis (default: one per cpu core)\n");
   sm_printf (" -s                          produced stripped models\n");
   sm_printf (" --no-attack                 skip attack time optimization\n");
   sm_printf (" --no-sines                  skip partial tracking\n");
@@ -496,6 +506,7 @@ main (int argc, char **argv)
         window[i] = 0;
     }
   enc_params.window = window;
+  enc_params.n_threads = options.n_threads;
 
   int n_channels = wav_data.n_channels();
 
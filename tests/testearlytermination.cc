@@ -0,0 +1,134 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smeffectdecoder.hh"
+#include "smmorphoutput.hh"
+#include "smmain.hh"
+#include "smfft.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+/* EffectDecoder early termination: a released voice is done once its output stayed below
+ * the threshold for the hold time, voices that are still audible must continue
+ */
+
+class SineSource : public LiveDecoderSource
+{
+  Audio      my_audio;
+  AudioBlock my_audio_block;
+public:
+  SineSource (float mag, float mix_freq)
+  {
+    my_audio.frame_size_ms = 40;
+    my_audio.frame_step_ms = 10;
+    my_audio.attack_start_ms = 0;
+    my_audio.attack_end_ms = 0;
+    my_audio.zeropad = 4;
+    my_audio.loop_type = Audio::LOOP_NONE;
+    my_audio.mix_freq = mix_freq;
+
+    my_audio_block.freqs.push_back (sm_freq2ifreq (1));
+    my_audio_block.mags.push_back (sm_factor2idb (mag));
+    my_audio_block.phases.push_back (0);
+    my_audio_block.noise.resize (32); // all 0, no noise
+  }
+  void
+  retrigger (int channel, float freq, int midi_velocity) override
+  {
+    my_audio.fundamental_freq = freq;
+  }
+  Audio *
+  audio() override
+  {
+    return &my_audio;
+  }
+  bool
+  rt_audio_block (size_t index, RTAudioBlock& out_block) override
+  {
+    out_block.assign (my_audio_block);
+    return true;
+  }
+  void
+  set_portamento_freq (float freq) override
+  {
+  }
+};
+
+/* returns the number of samples between release and the end of the voice (or 0 if the voice didn't end) */
+static size_t
+release_samples (float mag_db, bool early_termination, float threshold_db, float hold_ms)
+{
+  const float  mix_freq = 48000;
+  const size_t block_size = 64;
+
+  MorphOutput::Config cfg;
+  cfg.sines = true;
+  cfg.noise = false;
+  cfg.unison = false;
+  cfg.unison_voices = 1;
+  cfg.unison_detune = 0;
+  cfg.adsr = false;
+  cfg.filter = false;
+  cfg.vibrato = false;
+  cfg.vibrato_depth = 0;
+  cfg.vibrato_frequency = 0;
+  cfg.vibrato_attack = 0;
+  cfg.early_termination = early_termination;
+  cfg.early_termination_threshold = threshold_db;
+  cfg.early_termination_hold = hold_ms;
+
+  SineSource source (db_to_factor (mag_db), mix_freq);
+  EffectDecoder decoder (nullptr, mix_freq);
+  RTMemoryArea rt_memory_area;
+
+  decoder.set_config (&cfg, &source, mix_freq, 1);
+  decoder.retrigger (0, 440, 100);
+
+  float samples[block_size];
+
+  /* voices are only terminated early after release */
+  for (size_t pos = 0; pos < mix_freq / 2; pos += block_size)
+    {
+      decoder.process (rt_memory_area, block_size, nullptr, samples);
+      rt_memory_area.free_all();
+      assert (!decoder.done());
+    }
+
+  decoder.release();
+  for (size_t pos = 0; pos < mix_freq; pos += block_size)
+    {
+      decoder.process (rt_memory_area, block_size, nullptr, samples);
+      rt_memory_area.free_all();
+      if (decoder.done())
+        return pos + block_size;
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  FFT::debug_in_test_program (true);
+
+  const size_t hold_samples = 20 * 48;   // 20 ms
+  const size_t release_len = 150 * 48;   // release of the envelope without adsr: 150 ms
+
+  /* quiet voice: terminated after the hold time */
+  size_t quiet = release_samples (-80, true, -60, 20);
+  sm_printf ("quiet voice: done %zd samples after release\n", quiet);
+  assert (quiet >= hold_samples && quiet <= hold_samples + 64);
+
+  /* without early termination, the voice ends with the envelope */
+  size_t quiet_no_et = release_samples (-80, false, -60, 20);
+  sm_printf ("quiet voice, no early termination: done %zd samples after release\n", quiet_no_et);
+  assert (quiet_no_et >= release_len);
+
+  /* audible voice: not terminated before the envelope is (almost) done */
+  size_t loud = release_samples (-6, true, -60, 20);
+  sm_printf ("loud voice: done %zd samples after release\n", loud);
+  assert (loud >= release_len - 64);
+}
@@ -0,0 +1,127 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smmorphoutput.hh"
+#include "smmodulationlist.hh"
+#include "smmorphwavsource.hh"
+#include "smfft.hh"
+#include "testplan.hh"
+
+#include <unistd.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+/* Control input automation doesn't split the block MidiSynth renders. This test
+ * checks that the result (for a plan with the output filter controlled by a
+ * control input) is the same as with splitting the block at each control change.
+ */
+
+static constexpr size_t BLOCK_SIZE = 512;
+
+/* control changes within each block: (offset, value)
+ *
+ * offsets are multiples of 4: the filter uses SIMD code, so with other offsets the
+ * results would differ slightly due to the different alignment of the buffers
+ */
+static const vector<std::pair<uint, float>> changes = { { 36, -0.8 }, { 100, 0.6 }, { 104, -0.2 }, { 332, 0.9 }, { 480, -0.5 } };
+
+static float
+change_value (float value, int block)
+{
+  return (block & 1) ? -value : value;
+}
+
+static vector<float>
+render (MorphPlan& plan, bool split_blocks, int n_blocks)
+{
+  MidiSynth midi_synth (48000, 64);
+  midi_synth.set_random_seed (42);
+  midi_synth.apply_update (midi_synth.prepare_update (plan));
+
+  unsigned char note_on[3] = { 0x90, 60, 100 };
+  midi_synth.add_midi_event (0, note_on);
+
+  vector<float> output (BLOCK_SIZE * n_blocks);
+  for (int block = 0; block < n_blocks; block++)
+    {
+      float *block_output = &output[block * BLOCK_SIZE];
+
+      if (split_blocks)
+        {
+          uint offset = 0;
+          for (auto [change_offset, value] : changes)
+            {
+              midi_synth.process (block_output + offset, change_offset - offset);
+              midi_synth.set_control_input (0, change_value (value, block));
+              offset = change_offset;
+            }
+          midi_synth.process (block_output + offset, BLOCK_SIZE - offset);
+        }
+      else
+        {
+          for (auto [change_offset, value] : changes)
+            midi_synth.add_control_input_event (change_offset, 0, change_value (value, block));
+
+          midi_synth.process (block_output, BLOCK_SIZE);
+        }
+    }
+  return output;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  FFT::debug_in_test_program (true);
+  if (argc > 2)
+    {
+      printf ("usage: %s [ <plan> ]\n", argv[0]);
+      exit (1);
+    }
+
+  Project project;
+  project.set_mix_freq (48000);
+
+  Error error = load_test_plan (project, argc, argv);
+  assert (!error);
+
+  MorphPlan& plan = *project.morph_plan();
+  MorphOutput *output = nullptr;
+  for (auto op : plan.operators())
+    {
+      if (auto out = dynamic_cast<MorphOutput *> (op))
+        output = out;
+
+      // instruments of wav sources are built in the background
+      if (auto wav_source = dynamic_cast<MorphWavSource *> (op))
+        {
+          while (project.rebuild_active (wav_source->object_id()))
+            usleep (10 * 1000);
+        }
+    }
+  assert (output);
+  project.try_update_synth(); // make instruments available to MidiSynth
+
+  output->property (MorphOutput::P_FILTER)->set_bool (true);
+  output->property (MorphOutput::P_FILTER_CUTOFF)->modulation_list()->set_main_control_type_and_op (MorphOperator::CONTROL_SIGNAL_1, nullptr);
+  output->property (MorphOutput::P_FILTER_RESONANCE)->set_float (80);
+
+  const int n_blocks = 50;
+  vector<float> split = render (plan, true, n_blocks);
+  vector<float> automation = render (plan, false, n_blocks);
+
+  double max_diff = 0, energy = 0;
+  for (size_t i = 0; i < split.size(); i++)
+    {
+      max_diff = std::max<double> (max_diff, std::abs (split[i] - automation[i]));
+      energy += split[i] * split[i];
+    }
+  printf ("energy %f, max diff %g\n", energy, max_diff);
+  assert (energy > 1);
+  assert (max_diff == 0);
+}
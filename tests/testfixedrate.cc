@@ -0,0 +1,154 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smmorphwavsource.hh"
+#include "smfft.hh"
+#include "testplan.hh"
+
+#include <unistd.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+/* With fixed_internal_rate, MidiSynth synthesizes at 48 kHz for a host rate of
+ * 96 kHz and upsamples the mix. This test checks that the output doesn't depend
+ * on the host block size (which needs consistent event offset mapping and
+ * blocks that are rendered in parts), and compares it with the output at 96 kHz.
+ */
+
+static constexpr double MIX_FREQ = 96000;
+
+struct NoteEvent
+{
+  size_t pos;
+  bool   on;
+  int    note;
+};
+
+static const vector<NoteEvent> note_events = { { 1001, true, 60 }, { 8193, true, 64 }, { 30001, false, 60 }, { 30002, false, 64 } };
+
+static vector<float>
+render (MorphPlan& plan, bool fixed_internal_rate, size_t block_size, size_t n_values, uint *latency = nullptr)
+{
+  MidiSynth midi_synth (MIX_FREQ, 64, 0, fixed_internal_rate);
+  midi_synth.set_random_seed (42);
+  midi_synth.apply_update (midi_synth.prepare_update (plan));
+
+  if (latency)
+    *latency = midi_synth.latency();
+
+  vector<float> output (n_values);
+  for (size_t pos = 0; pos < n_values; pos += block_size)
+    {
+      const size_t todo = std::min (block_size, n_values - pos);
+
+      for (const auto& event : note_events)
+        {
+          if (event.pos >= pos && event.pos < pos + todo)
+            {
+              unsigned char midi_data[3] = { (unsigned char) (event.on ? 0x90 : 0x80), (unsigned char) event.note, 100 };
+              midi_synth.add_midi_event (event.pos - pos, midi_data);
+            }
+        }
+      midi_synth.process (&output[pos], todo);
+    }
+  return output;
+}
+
+static double
+energy (const vector<float>& samples)
+{
+  double e = 0;
+  for (auto s : samples)
+    e += s * s;
+  return e;
+}
+
+static double
+max_diff (const vector<float>& a, const vector<float>& b)
+{
+  double diff = 0;
+  for (size_t i = 0; i < a.size(); i++)
+    diff = std::max<double> (diff, std::abs (a[i] - b[i]));
+  return diff;
+}
+
+/* delay of signal a compared to signal b (maximum of cross correlation) */
+static int
+best_lag (const vector<float>& a, const vector<float>& b, int max_lag)
+{
+  int    best = 0;
+  double best_corr = 0;
+  for (int lag = -max_lag; lag <= max_lag; lag++)
+    {
+      double corr = 0;
+      for (int i = max_lag; i < int (b.size()) - max_lag; i++)
+        corr += a[i + lag] * b[i];
+
+      if (corr > best_corr)
+        {
+          best_corr = corr;
+          best = lag;
+        }
+    }
+  return best;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  FFT::debug_in_test_program (true);
+  if (argc > 2)
+    {
+      printf ("usage: %s [ <plan> ]\n", argv[0]);
+      exit (1);
+    }
+
+  Project project;
+  project.set_mix_freq (MIX_FREQ);
+
+  Error error = load_test_plan (project, argc, argv);
+  assert (!error);
+
+  MorphPlan& plan = *project.morph_plan();
+  for (auto op : plan.operators())
+    {
+      // instruments of wav sources are built in the background
+      if (auto wav_source = dynamic_cast<MorphWavSource *> (op))
+        {
+          while (project.rebuild_active (wav_source->object_id()))
+            usleep (10 * 1000);
+        }
+    }
+  project.try_update_synth(); // make instruments available to MidiSynth
+
+  const size_t n_values = 48000;
+
+  uint latency = 0, latency_off = 0;
+  vector<float> fixed_512 = render (plan, true, 512, n_values, &latency);
+  vector<float> fixed_1 = render (plan, true, 1, n_values);
+  vector<float> fixed_large = render (plan, true, 20000, n_values); // larger than MidiSynth::MAX_RENDER_VALUES internal samples
+  vector<float> host_rate = render (plan, false, 512, n_values, &latency_off);
+
+  const int lag = best_lag (fixed_512, host_rate, 64);
+
+  printf ("latency %u, lag %d, energy %f (host rate %f)\n", latency, lag, energy (fixed_512), energy (host_rate));
+  printf ("max diff: block size 1 %g, large blocks %g\n", max_diff (fixed_512, fixed_1), max_diff (fixed_512, fixed_large));
+
+  assert (latency > 0 && latency_off == 0);
+  /* not bit identical: SIMD code gives slightly different results for other buffer alignments */
+  assert (max_diff (fixed_512, fixed_1) < 1e-5);
+  assert (max_diff (fixed_512, fixed_large) < 1e-5);
+
+  /* same notes at internal rate: similar energy, delayed by the upsampler latency
+   * (plus up to one host sample: events are processed at the next internal sample)
+   */
+  const double db_delta = 10 * log10 (energy (fixed_512) / energy (host_rate));
+  assert (energy (host_rate) > 1 && std::abs (db_delta) < 1);
+  assert (lag >= int (latency) && lag <= int (latency) + 1);
+}
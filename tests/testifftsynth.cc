@@ -1,6 +1,7 @@
 // Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
 
 #include "smifftsynth.hh"
+#include "smoscbank.hh"
 #include "smsinedecoder.hh"
 #include "smlivedecoder.hh"
 #include "smmath.hh"
@@ -8,6 +9,7 @@
 #include "smfft.hh"
 #include "smutils.hh"
 #include "smpandaresampler.hh"
+#include "smrandom.hh"
 
 #include <stdio.h>
 #include <assert.h>
@@ -198,6 +200,52 @@ test_negative_phase()
   assert (max_diff < 1e-8);
 }
 
+void
+test_render_partials()
+{
+  const double mix_freq = 48000;
+  const size_t block_size = 1024;
+
+  IFFTSynth synth (block_size, mix_freq, IFFTSynth::WIN_BLACKMAN_HARRIS_92);
+
+  /* include corner cases: very low frequencies and frequencies near nyquist */
+  Random rand;
+  vector<float> freqs, mags;
+  vector<uint>  phases;
+  for (size_t i = 0; i < 1000; i++)
+    {
+      if (i % 10 == 0)
+        freqs.push_back (rand.random_double_range (0, 200));
+      else if (i % 10 == 1)
+        freqs.push_back (rand.random_double_range (23800, 24000));
+      else
+        freqs.push_back (rand.random_double_range (200, 23800));
+      mags.push_back (rand.random_double_range (0, 1));
+      phases.push_back (rand.random_uint32());
+    }
+
+  synth.clear_partials();
+  for (size_t i = 0; i < freqs.size(); i++)
+    synth.render_partial (freqs[i], mags[i], phases[i]);
+  vector<float> spectrum1 (synth.fft_input(), synth.fft_input() + block_size);
+
+  synth.clear_partials();
+  synth.render_partials (freqs.size(), freqs.data(), mags.data(), phases.data());
+  vector<float> spectrum2 (synth.fft_input(), synth.fft_input() + block_size);
+
+  double max_diff = 0;
+  for (size_t i = 0; i < block_size; i++)
+    max_diff = max (max_diff, std::abs (double (spectrum1[i]) - spectrum2[i]));
+  sm_printf ("# test_render_partials: %.17g\n", max_diff);
+
+  /* SSE code uses separate multiply and add, so without FMA, the result must be bit-identical */
+#if defined(__SSE__) && !defined(__FMA__)
+  assert (max_diff == 0);
+#else
+  assert (max_diff < 1e-6);
+#endif
+}
+
 
 void
 test_accs()
@@ -273,6 +321,118 @@ public:
   }
 };
 
+void
+test_loop_cache()
+{
+  const double mix_freq = 48000;
+
+  AudioBlock audio_block;
+
+  for (size_t partial = 1; partial <= 50; partial++)
+    push_partial_f (audio_block, partial, 0.5 / partial, 0);
+
+  vector<float> samples[2];
+  for (int i = 0; i < 2; i++)
+    {
+      ConstBlockSource source (audio_block, mix_freq);
+
+      RTMemoryArea rt_memory_area;
+      LiveDecoder live_decoder (&source, mix_freq);
+      live_decoder.enable_noise (false);
+      live_decoder.enable_start_phase_rand (false);
+      live_decoder.enable_loop_cache (i == 1);
+      live_decoder.retrigger (0, 220, 127);
+
+      samples[i].resize (mix_freq * 2);
+      for (size_t pos = 0; pos < samples[i].size(); pos += 256)
+        live_decoder.process (rt_memory_area, 256, nullptr, &samples[i][pos]);
+    }
+
+  /* partial phases are not exactly the same (loop cache uses exact harmonics), so we compare
+   * energy, and check that there are no discontinuities when switching to the loop cache
+   */
+  double energy[2] = { 0, 0 };
+  double max_delta[2] = { 0, 0 };
+  for (int i = 0; i < 2; i++)
+    {
+      for (size_t pos = 1; pos < samples[i].size(); pos++)
+        {
+          energy[i] += samples[i][pos] * samples[i][pos];
+          max_delta[i] = max (max_delta[i], std::abs (double (samples[i][pos]) - samples[i][pos - 1]));
+        }
+    }
+  const double db_diff = db_from_factor (sqrt (energy[1] / energy[0]), -200);
+  sm_printf ("# test_loop_cache: energy diff %f dB, max delta %f %f\n", db_diff, max_delta[0], max_delta[1]);
+  assert (std::abs (db_diff) < 0.01);
+  assert (max_delta[1] < max_delta[0] * 1.01);
+}
+
+void
+test_osc_bank()
+{
+  const double mix_freq = 48000;
+  const size_t block_size = 1024;
+
+  /* oscillator bank output should be the same as IFFTSynth output (hann window) */
+  IFFTSynth synth (block_size, mix_freq, IFFTSynth::WIN_HANN);
+  OscBank   osc_bank (block_size, mix_freq);
+
+  Random rand;
+  vector<float> freqs, mags;
+  vector<uint>  phases;
+  for (size_t i = 0; i < 7; i++)
+    {
+      freqs.push_back (synth.quantized_freq (rand.random_double_range (200, 20000)));
+      mags.push_back (rand.random_double_range (0, 1));
+      phases.push_back (rand.random_uint32());
+    }
+  vector<float> ifft_samples (block_size), osc_samples (block_size);
+
+  synth.clear_partials();
+  synth.render_partials (freqs.size(), freqs.data(), mags.data(), phases.data());
+  synth.get_samples (ifft_samples.data());
+  osc_bank.render_partials (freqs.size(), freqs.data(), mags.data(), phases.data(), osc_samples.data());
+
+  double max_diff = 0;
+  for (size_t i = 0; i < block_size; i++)
+    max_diff = max (max_diff, std::abs (double (ifft_samples[i]) - osc_samples[i]));
+
+  /* LiveDecoder should produce (almost) the same output with and without oscillator bank */
+  AudioBlock audio_block;
+
+  push_partial_f (audio_block, 1, 0.5, 0);
+  push_partial_f (audio_block, 2, 0.2, 0);
+  push_partial_f (audio_block, 3, 0.1, 0);
+
+  vector<float> samples[2];
+  for (int i = 0; i < 2; i++)
+    {
+      ConstBlockSource source (audio_block, mix_freq);
+
+      RTMemoryArea rt_memory_area;
+      LiveDecoder live_decoder (&source, mix_freq);
+      live_decoder.enable_noise (false);
+      live_decoder.enable_start_phase_rand (false);
+      live_decoder.enable_loop_cache (false);
+      live_decoder.enable_osc_bank (i == 1);
+      live_decoder.retrigger (0, 220, 127);
+
+      samples[i].resize (mix_freq * 2);
+      for (size_t pos = 0; pos < samples[i].size(); pos += 256)
+        live_decoder.process (rt_memory_area, 256, nullptr, &samples[i][pos]);
+    }
+  double signal = 0, error = 0;
+  for (size_t pos = 0; pos < samples[0].size(); pos++)
+    {
+      signal += samples[0][pos] * samples[0][pos];
+      error += (samples[0][pos] - samples[1][pos]) * (samples[0][pos] - samples[1][pos]);
+    }
+  const double snr = db_from_factor (sqrt (signal / error), -200);
+  sm_printf ("# test_osc_bank: max_diff %.17g, live decoder snr %f dB\n", max_diff, snr);
+  assert (max_diff < 5e-3);
+  assert (snr > 60);
+}
+
 void
 test_spect()
 {
@@ -666,4 +826,7 @@ main (int argc, char **argv)
 
   test_portaslide (false);
   test_negative_phase();
+  test_render_partials();
+  test_loop_cache();
+  test_osc_bank();
 }
@@ -0,0 +1,94 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smifftsynth.hh"
+#include "smoscbank.hh"
+#include "smmath.hh"
+#include "smmain.hh"
+#include "smrandom.hh"
+#include "smutils.hh"
+
+#include <stdio.h>
+
+#include <vector>
+
+using namespace SpectMorph;
+
+using std::vector;
+using std::min;
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  const double mix_freq = 48000;
+  const size_t block_size = 1024;
+  const size_t n_partials = 1000;
+
+  IFFTSynth synth (block_size, mix_freq, IFFTSynth::WIN_HANN);
+
+  Random rand;
+  vector<float> freqs, mags;
+  vector<uint>  phases;
+  for (size_t i = 0; i < n_partials; i++)
+    {
+      freqs.push_back (rand.random_double_range (50, 20000));
+      mags.push_back (rand.random_double_range (0, 1));
+      phases.push_back (rand.random_uint32());
+    }
+
+  const int RUNS = 2000;
+  double t_scalar = 1e30, t_batch = 1e30;
+  for (int reps = 0; reps < 10; reps++)
+    {
+      synth.clear_partials();
+
+      double start = get_time();
+      for (int r = 0; r < RUNS; r++)
+        {
+          for (size_t i = 0; i < n_partials; i++)
+            synth.render_partial (freqs[i], mags[i], phases[i]);
+        }
+      double end = get_time();
+      t_scalar = min (t_scalar, end - start);
+
+      start = get_time();
+      for (int r = 0; r < RUNS; r++)
+        synth.render_partials (n_partials, freqs.data(), mags.data(), phases.data());
+      end = get_time();
+      t_batch = min (t_batch, end - start);
+    }
+  printf ("render_partial:  %.2f Mpartials/sec\n", RUNS * n_partials / t_scalar / 1e6);
+  printf ("render_partials: %.2f Mpartials/sec\n", RUNS * n_partials / t_batch / 1e6);
+  printf ("speedup:         %.2f\n", t_scalar / t_batch);
+
+  /* compare IFFT synthesis (spectrum + IFFT + overlap-add) with the oscillator bank for sparse frames */
+  OscBank osc_bank (block_size, mix_freq);
+  vector<float> samples (block_size);
+  for (size_t n : { 1, 4, 8, 16, 24, 32, 48, 64 })
+    {
+      const int BLOCKS = 20000;
+      double t_ifft = 1e30, t_osc = 1e30;
+      for (int reps = 0; reps < 5; reps++)
+        {
+          double start = get_time();
+          for (int b = 0; b < BLOCKS; b++)
+            {
+              synth.clear_partials();
+              synth.render_partials (n, freqs.data(), mags.data(), phases.data());
+              synth.get_samples (samples.data(), IFFTSynth::ADD);
+            }
+          double end = get_time();
+          t_ifft = min (t_ifft, end - start);
+
+          start = get_time();
+          for (int b = 0; b < BLOCKS; b++)
+            osc_bank.render_partials (n, freqs.data(), mags.data(), phases.data(), samples.data());
+          end = get_time();
+          t_osc = min (t_osc, end - start);
+        }
+      printf ("%2zu partials: ifft %.3f us, osc bank %.3f us (%s), cost model: %s\n", n,
+              t_ifft / BLOCKS * 1e6, t_osc / BLOCKS * 1e6, t_osc < t_ifft ? "osc bank" : "ifft",
+              OscBank::cheaper_than_ifft (n, block_size) ? "osc bank" : "ifft");
+    }
+}
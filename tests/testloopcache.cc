@@ -0,0 +1,160 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smlivedecoder.hh"
+#include "smwavsetbuilder.hh"
+#include "sminstrument.hh"
+#include "smrandom.hh"
+#include "smmain.hh"
+#include "smfft.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+using std::string;
+
+/* LiveDecoder plays stationary frames (like single frame loops) from a periodic table
+ * (loop cache); the partials of encoded instruments are never exactly harmonic, so check
+ * that the loop cache is used for an encoded instrument, and that it sounds the same
+ */
+
+static Instrument *
+make_instrument (double detune_cent, double inharmonicity)
+{
+  Instrument *inst = new Instrument();
+
+  const double sr = 48000;
+  const double f0 = 261.626 * exp2 (detune_cent / 1200);
+  Random random;
+  random.set_seed (42);
+
+  vector<float> signal (sr * 0.5);
+  for (size_t i = 0; i < signal.size(); i++)
+    {
+      double t = i / sr, v = 0;
+      for (int h = 1; h * f0 < 10000; h++)
+        {
+          const double freq = h * f0 * sqrt (1 + inharmonicity * h * h);
+          v += sin (2 * M_PI * freq * t + h * 0.7) / (h * h * 0.3 + 1);
+        }
+      v += 0.01 * random.random_double_range (-1, 1);
+      signal[i] = v * 0.3;
+    }
+  WavData wav_data (signal, 1, sr, 16);
+  Sample *sample = inst->add_sample (wav_data, "loopcache.wav");
+  sample->set_midi_note (60);
+  sample->set_loop (Sample::Loop::SINGLE_FRAME);
+  sample->set_marker (MARKER_LOOP_START, 300);
+  sample->set_marker (MARKER_LOOP_END, 300);
+  return inst;
+}
+
+static vector<float>
+render (WavSet *wav_set, bool loop_cache, double *cache_fraction = nullptr, size_t *cache_start = nullptr, size_t partial_budget = 0)
+{
+  const double mix_freq = 48000;
+
+  LiveDecoder live_decoder (wav_set, mix_freq);
+  RTMemoryArea rt_memory_area;
+
+  live_decoder.enable_loop_cache (loop_cache);
+  live_decoder.set_random_seed (1);
+  live_decoder.enable_noise (false);
+  live_decoder.set_partial_budget (partial_budget);
+  live_decoder.retrigger (0, 261.626, 100);
+
+  vector<float> samples (mix_freq * 2);
+  const size_t block_size = 256;
+  size_t n_blocks = 0, n_cache_blocks = 0;
+  for (size_t pos = 0; pos < samples.size(); pos += block_size)
+    {
+      live_decoder.process (rt_memory_area, block_size, nullptr, &samples[pos]);
+      rt_memory_area.free_all();
+
+      if (cache_start && !*cache_start && live_decoder.loop_cache_active())
+        *cache_start = pos;
+
+      if (pos > mix_freq) // sustain phase: frame loop
+        {
+          n_blocks++;
+          if (live_decoder.loop_cache_active())
+            n_cache_blocks++;
+
+          /* partials beyond the budget are not rendered into the loop cache */
+          if (partial_budget)
+            assert (live_decoder.culled_partials() > 0);
+        }
+    }
+  if (cache_fraction)
+    *cache_fraction = double (n_cache_blocks) / n_blocks;
+  return samples;
+}
+
+static double
+snr (const vector<float>& samples, const vector<float>& ref, size_t start, size_t end)
+{
+  double signal_energy = 0, error_energy = 0;
+  for (size_t i = start; i < end; i++)
+    {
+      signal_energy += ref[i] * ref[i];
+      error_energy += (samples[i] - ref[i]) * (samples[i] - ref[i]);
+    }
+  return 10 * log10 (signal_energy / error_energy);
+}
+
+static double
+energy (const vector<float>& samples, size_t start)
+{
+  double e = 0;
+  for (size_t i = start; i < samples.size(); i++)
+    e += samples[i] * samples[i];
+  return e;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  FFT::debug_in_test_program (true);
+
+  for (double detune_cent : { 0, 10 })
+    {
+      for (double inharmonicity : { 0.0, 1e-5 })
+        {
+          std::unique_ptr<Instrument> inst (make_instrument (detune_cent, inharmonicity));
+          WavSetBuilder builder (inst.get(), false);
+          std::unique_ptr<WavSet> wav_set (builder.run());
+
+          double cache_fraction;
+          size_t cache_start = 0;
+          vector<float> cached = render (wav_set.get(), true, &cache_fraction, &cache_start);
+          vector<float> ifft = render (wav_set.get(), false);
+
+          /* switching to the loop cache should be seamless */
+          const double switch_snr_db = cache_start ? snr (cached, ifft, cache_start, cache_start + 256) : 0;
+          /* partials are slightly detuned to fit into the table, so the phases drift apart
+           * over time, but the energy should be the same
+           */
+          const double energy_db = 10 * log10 (energy (cached, cached.size() / 2) / energy (ifft, ifft.size() / 2));
+          sm_printf ("detune %.0f cent, inharmonicity %g: loop cache used for %.1f%% of the blocks, snr %.2f dB, energy delta %.3f dB\n",
+                     detune_cent, inharmonicity, cache_fraction * 100, switch_snr_db, energy_db);
+
+          if (inharmonicity == 0)
+            {
+              assert (cache_fraction > 0.99);
+              assert (switch_snr_db > 50);
+              assert (std::abs (energy_db) < 0.01);
+
+              /* loop cache with partial culling */
+              render (wav_set.get(), true, &cache_fraction, nullptr, 20);
+              assert (cache_fraction > 0.99);
+            }
+          else
+            {
+              /* loud partials are too far away from the harmonics */
+              assert (cache_fraction == 0);
+            }
+        }
+    }
+}
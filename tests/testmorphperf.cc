@@ -0,0 +1,274 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmorphutils.hh"
+#include "smaudio.hh"
+#include "smmain.hh"
+#include "smutils.hh"
+
+#include <stdio.h>
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+using std::max;
+using std::min;
+
+/* previous implementation of MorphUtils::morph (sort by magnitude + binary search) for comparison */
+namespace Reference
+{
+
+struct MagData
+{
+  enum {
+    BLOCK_LEFT  = 0,
+    BLOCK_RIGHT = 1
+  }        block;
+  size_t   index;
+  uint16_t mag;
+};
+
+static bool
+md_cmp (const MagData& m1, const MagData& m2)
+{
+  return m1.mag > m2.mag;
+}
+
+struct FreqState
+{
+  float freq_f;
+  int   used;
+};
+
+static bool
+fs_cmp (const FreqState& fs1, const FreqState& fs2)
+{
+  return fs1.freq_f < fs2.freq_f;
+}
+
+static bool
+find_match (float freq, const FreqState *freq_state, size_t freq_state_size, size_t *index)
+{
+  const float freq_start = freq - 0.5;
+  const float freq_end   = freq + 0.5;
+
+  float min_diff = 1e20;
+  size_t best_index = 0;
+
+  FreqState start_freq_state = {freq_start, 0};
+  const FreqState *start_ptr = std::lower_bound (freq_state, freq_state + freq_state_size, start_freq_state, fs_cmp);
+  size_t i = start_ptr - freq_state;
+
+  while (i < freq_state_size && freq_state[i].freq_f < freq_end)
+    {
+      if (!freq_state[i].used)
+        {
+          float diff = std::abs (freq - freq_state[i].freq_f);
+          if (diff < min_diff)
+            {
+              best_index = i;
+              min_diff = diff;
+            }
+        }
+      i++;
+    }
+  if (min_diff < 0.5)
+    {
+      *index = best_index;
+      return true;
+    }
+  return false;
+}
+
+static void
+morph (RTAudioBlock& out_block, const RTAudioBlock& left_block, const RTAudioBlock& right_block, double morphing)
+{
+  const float interp = (morphing + 1) / 2;
+
+  const size_t max_partials = left_block.freqs.size() + right_block.freqs.size();
+  out_block.freqs.set_capacity (max_partials);
+  out_block.mags.set_capacity (max_partials);
+
+  MagData mds[max_partials + AVOID_ARRAY_UB];
+  size_t  mds_size = 0;
+  for (size_t i = 0; i < left_block.freqs.size(); i++)
+    mds[mds_size++] = { MagData::BLOCK_LEFT, i, left_block.mags[i] };
+  for (size_t i = 0; i < right_block.freqs.size(); i++)
+    mds[mds_size++] = { MagData::BLOCK_RIGHT, i, right_block.mags[i] };
+  std::sort (mds, mds + mds_size, md_cmp);
+
+  const size_t left_size = left_block.freqs.size();
+  const size_t right_size = right_block.freqs.size();
+  FreqState left_freqs[left_size + AVOID_ARRAY_UB];
+  FreqState right_freqs[right_size + AVOID_ARRAY_UB];
+  for (size_t i = 0; i < left_size; i++)
+    left_freqs[i] = { left_block.freqs_f (i), 0 };
+  for (size_t i = 0; i < right_size; i++)
+    right_freqs[i] = { right_block.freqs_f (i), 0 };
+
+  for (size_t m = 0; m < mds_size; m++)
+    {
+      const MagData& md = mds[m];
+      size_t i, j;
+      bool match = false;
+      if (md.block == MagData::BLOCK_LEFT)
+        {
+          i = md.index;
+          if (!left_freqs[i].used)
+            match = find_match (left_freqs[i].freq_f, right_freqs, right_size, &j);
+        }
+      else
+        {
+          j = md.index;
+          if (!right_freqs[j].used)
+            match = find_match (right_freqs[j].freq_f, left_freqs, left_size, &i);
+        }
+      if (match)
+        {
+          const float lfreq = left_block.freqs[i];
+          const float rfreq = right_block.freqs[j];
+          float freq;
+
+          if (left_block.mags[i] > right_block.mags[j])
+            {
+              const float mfact = right_block.mags_f (j) / left_block.mags_f (i);
+
+              freq = lfreq + mfact * interp * (rfreq - lfreq);
+            }
+          else
+            {
+              const float mfact = left_block.mags_f (i) / right_block.mags_f (j);
+
+              freq = rfreq + mfact * (1 - interp) * (lfreq - rfreq);
+            }
+          const uint16_t lmag_idb = max (left_block.mags[i], SM_IDB_CONST_M96);
+          const uint16_t rmag_idb = max (right_block.mags[j], SM_IDB_CONST_M96);
+
+          out_block.freqs.push_back (freq);
+          out_block.mags.push_back (sm_round_positive ((1 - interp) * lmag_idb + interp * rmag_idb));
+
+          left_freqs[i].used = 1;
+          right_freqs[j].used = 1;
+        }
+    }
+  for (size_t i = 0; i < left_block.freqs.size(); i++)
+    {
+      if (!left_freqs[i].used)
+        {
+          out_block.freqs.push_back (left_block.freqs[i]);
+          out_block.mags.push_back (sm_round_positive ((1 - interp) * max (left_block.mags[i], SM_IDB_CONST_M96) + interp * SM_IDB_CONST_M96));
+        }
+    }
+  for (size_t i = 0; i < right_block.freqs.size(); i++)
+    {
+      if (!right_freqs[i].used)
+        {
+          out_block.freqs.push_back (right_block.freqs[i]);
+          out_block.mags.push_back (sm_round_positive ((1 - interp) * SM_IDB_CONST_M96 + interp * max (right_block.mags[i], SM_IDB_CONST_M96)));
+        }
+    }
+  out_block.noise.set_capacity (left_block.noise.size());
+  for (size_t i = 0; i < left_block.noise.size(); i++)
+    out_block.noise.push_back (sm_factor2idb ((1 - interp) * left_block.noise_f (i) + interp * right_block.noise_f (i)));
+
+  out_block.sort_freqs();
+}
+
+}
+
+static vector<std::pair<uint16_t, uint16_t>>
+sorted_partials (const RTAudioBlock& block)
+{
+  vector<std::pair<uint16_t, uint16_t>> partials;
+  for (size_t i = 0; i < block.freqs.size(); i++)
+    partials.emplace_back (block.freqs[i], block.mags[i]);
+
+  std::sort (partials.begin(), partials.end());
+  return partials;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  if (argc != 3)
+    {
+      fprintf (stderr, "usage: testmorphperf <left.sm> <right.sm>\n");
+      return 1;
+    }
+  Audio left_audio, right_audio;
+  Error error = left_audio.load (argv[1]);
+  assert (!error);
+  error = right_audio.load (argv[2]);
+  assert (!error);
+
+  const size_t n_frames = min (left_audio.contents.size(), right_audio.contents.size());
+  assert (n_frames > 0);
+
+  RTMemoryArea rt_memory_area;
+
+  /* check that both implementations produce the same partials */
+  size_t n_partials = 0, n_noise_diff = 0;
+  for (double morphing : { -0.6, 0.0, 0.4 })
+    {
+      for (size_t f = 0; f < n_frames; f++)
+        {
+          RTAudioBlock left (&rt_memory_area), right (&rt_memory_area), out_ref (&rt_memory_area), out (&rt_memory_area);
+          left.borrow (left_audio.contents[f]);
+          right.borrow (right_audio.contents[f]);
+
+          Reference::morph (out_ref, left, right, morphing);
+          MorphUtils::morph (out, true, left, true, right, morphing, MorphUtils::MorphMode::DB_LINEAR);
+
+          for (size_t i = 1; i < out.freqs.size(); i++)
+            assert (out.freqs[i - 1] <= out.freqs[i]);
+
+          assert (sorted_partials (out) == sorted_partials (out_ref));
+          n_partials += out.freqs.size();
+
+          /* noise uses fast (approximate) log2 now, so we allow 1/64 dB rounding differences */
+          assert (out.noise.size() == out_ref.noise.size());
+          for (size_t i = 0; i < out.noise.size(); i++)
+            {
+              assert (abs (out.noise[i] - out_ref.noise[i]) <= 1);
+              if (out.noise[i] != out_ref.noise[i])
+                n_noise_diff++;
+            }
+          rt_memory_area.free_all();
+        }
+    }
+  printf ("%zd frames, %.2f partials per morphed frame: results identical (noise bands with 1/64 dB difference: %zd)\n",
+          n_frames, double (n_partials) / (3 * n_frames), n_noise_diff);
+
+  const int REPS = 15;
+  double t_ref = 1e30, t_new = 1e30;
+  for (int rep = 0; rep < REPS; rep++)
+    {
+      for (int impl = 0; impl < 2; impl++)
+        {
+          double start = get_time();
+          for (size_t f = 0; f < n_frames; f++)
+            {
+              RTAudioBlock left (&rt_memory_area), right (&rt_memory_area), out (&rt_memory_area);
+              left.borrow (left_audio.contents[f]);
+              right.borrow (right_audio.contents[f]);
+
+              if (impl == 0)
+                Reference::morph (out, left, right, 0.2);
+              else
+                MorphUtils::morph (out, true, left, true, right, 0.2, MorphUtils::MorphMode::DB_LINEAR);
+
+              rt_memory_area.free_all();
+            }
+          double t = get_time() - start;
+          if (impl == 0)
+            t_ref = min (t_ref, t);
+          else
+            t_new = min (t_new, t);
+        }
+    }
+  printf ("sort+search morph: %10.0f morphs/sec\n", n_frames / t_ref);
+  printf ("merge morph:       %10.0f morphs/sec\n", n_frames / t_new);
+  printf ("speedup:           %10.2f\n", t_ref / t_new);
+}
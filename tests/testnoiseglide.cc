@@ -0,0 +1,112 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smlivedecoder.hh"
+#include "smutils.hh"
+#include "smmain.hh"
+#include "smfft.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+/* LiveDecoder can merge the noise of a block into the IFFT of the sines, but the
+ * sine signal is resampled if the frequency changes (pitch bend, portamento), and
+ * noise must not be: so the noise signal should not depend on the frequency at all
+ */
+
+class NoiseSource : public LiveDecoderSource
+{
+  Audio      my_audio;
+  AudioBlock my_audio_block;
+public:
+  NoiseSource (float mix_freq)
+  {
+    my_audio.frame_size_ms = 40;
+    my_audio.frame_step_ms = 10;
+    my_audio.attack_start_ms = 0;
+    my_audio.attack_end_ms = 0;
+    my_audio.zeropad = 4;
+    my_audio.loop_type = Audio::LOOP_NONE;
+    my_audio.mix_freq = mix_freq;
+
+    my_audio_block.noise.resize (32);
+    for (size_t band = 0; band < my_audio_block.noise.size(); band++)
+      my_audio_block.noise[band] = sm_factor2idb (0.1);
+  }
+  void
+  retrigger (int channel, float freq, int midi_velocity) override
+  {
+    my_audio.fundamental_freq = freq;
+  }
+  Audio *
+  audio() override
+  {
+    return &my_audio;
+  }
+  bool
+  rt_audio_block (size_t index, RTAudioBlock& out_block) override
+  {
+    out_block.assign (my_audio_block);
+    return true;
+  }
+  void
+  set_portamento_freq (float freq) override
+  {
+  }
+};
+
+static vector<float>
+render (float mix_freq, bool glide)
+{
+  NoiseSource source (mix_freq);
+  LiveDecoder live_decoder (&source, mix_freq);
+  RTMemoryArea rt_memory_area;
+
+  live_decoder.set_random_seed (42);
+  live_decoder.retrigger (0, 440, 127);
+
+  vector<float> samples (mix_freq);
+  vector<float> freq_in (samples.size(), 440);
+  if (glide)
+    {
+      /* bend up one octave in the middle, with a few jumps */
+      for (size_t i = samples.size() / 2; i < samples.size(); i++)
+        freq_in[i] = 440 * exp2 (std::min (double (i - samples.size() / 2) / (mix_freq * 0.1), 1.0));
+      for (size_t i = samples.size() * 3 / 4; i < samples.size() * 7 / 8; i++)
+        freq_in[i] = 500;
+    }
+  const size_t block_size = 256;
+  for (size_t pos = 0; pos < samples.size(); pos += block_size)
+    {
+      const size_t todo = std::min (block_size, samples.size() - pos);
+
+      live_decoder.process (rt_memory_area, todo, &freq_in[pos], &samples[pos]);
+      rt_memory_area.free_all();
+    }
+  return samples;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  FFT::debug_in_test_program (true);
+
+  for (float mix_freq : { 44100, 48000, 96000 })
+    {
+      vector<float> constant = render (mix_freq, false);
+      vector<float> glide = render (mix_freq, true);
+
+      double max_diff = 0, max_value = 0;
+      for (size_t i = 0; i < constant.size(); i++)
+        {
+          max_diff = std::max<double> (max_diff, std::abs (constant[i] - glide[i]));
+          max_value = std::max<double> (max_value, std::abs (constant[i]));
+        }
+      sm_printf ("mix_freq %.0f: max value %f, max diff %g\n", mix_freq, max_value, max_diff);
+      assert (max_value > 0.01);
+      assert (max_diff < max_value * 1e-4);
+    }
+}
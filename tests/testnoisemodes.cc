@@ -129,6 +129,37 @@ main (int argc, char **argv)
       ASSERT_PRINTF (s_diff_max < 3e-9, "noise test: sse=%d s_diff_max=%.17g", sse, s_diff_max);
     }
 
+  // LOW DETAIL: skipped bands are more than 40 dB below the loudest band, so the result should be close to full detail
+  AudioBlock low_block;
+  for (int i = 0; i < 32; i++)
+    low_block.noise.push_back (sm_factor2idb (i < 12 ? db_to_factor (-120) : (i < 20 ? db_to_factor (-170) : 0)));
+  assert (NoiseDecoder::envelope_detail (audio_block.noise.data()) == NoiseDecoder::Detail::FULL);
+  assert (NoiseDecoder::envelope_detail (low_block.noise.data()) == NoiseDecoder::Detail::LOW);
+  for (int sse = 0; sse < 2; sse++)
+    {
+      sm_enable_sse (sse);
+      for (auto mode : { NoiseDecoder::ADD_SPECTRUM_BH92, NoiseDecoder::SET_SPECTRUM_HANN })
+        {
+          vector<float> spectrum[2];
+          for (int low = 0; low < 2; low++)
+            {
+              ifft_synth.clear_partials();
+              noise_dec.set_seed (42);
+              noise_dec.process (low_block.noise.data(), ifft_synth.fft_input(), mode, 1, 1,
+                                 low ? NoiseDecoder::Detail::LOW : NoiseDecoder::Detail::FULL);
+              spectrum[low].assign (ifft_synth.fft_input(), ifft_synth.fft_input() + block_size);
+            }
+          float peak = 0, diff_max = 0;
+          for (size_t i = 0; i < block_size; i++)
+            {
+              peak = max (peak, fabs (spectrum[0][i]));
+              diff_max = max (diff_max, fabs (spectrum[0][i] - spectrum[1][i]));
+            }
+          ASSERT_PRINTF (peak > 0 && diff_max < peak * 0.01, "noise test: low detail sse=%d mode=%d diff_max=%.17g peak=%.17g",
+                         sse, int (mode), diff_max, peak);
+        }
+    }
+
   FFT::free_array_float (samples);
   FFT::free_array_float (win_samples);
   FFT::free_array_float (cos_win_samples);
@@ -33,6 +33,29 @@ measure_update (MorphPlan& plan, size_t n_voices)
   printf ("update (%zd voices): %f updates per ms\n", n_voices, 1 / ((end - start) * 1000 / runs));
 }
 
+static void
+measure_structural_update (MorphPlan& plan, size_t n_voices)
+{
+  MorphPlanSynth synth (44100, n_voices);
+  synth.apply_update (synth.prepare_update (plan));
+
+  size_t runs = 1000;
+  double start = get_time();
+  for (size_t j = 0; j < runs; j++)
+    {
+      /* add + remove one operator: two full updates */
+      MorphOperator *lfo = MorphOperator::create ("SpectMorph::MorphLFO", &plan);
+      plan.add_operator (lfo);
+      synth.apply_update (synth.prepare_update (plan));
+
+      plan.remove (lfo);
+      synth.apply_update (synth.prepare_update (plan));
+    }
+  double end = get_time();
+
+  printf ("structural update (%zd voices): %f ms per update\n", n_voices, (end - start) * 1000 / (2 * runs));
+}
+
 int
 main (int argc, char **argv)
 {
@@ -55,4 +78,6 @@ main (int argc, char **argv)
   preinit_plan (*plan);
   measure_update (*plan, 1);
   measure_update (*plan, 64);
+  measure_structural_update (*plan, 64);
+  measure_structural_update (*plan, 256);
 }
@@ -0,0 +1,58 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smproject.hh"
+#include "smmorphwavsource.hh"
+#include "smmorphoutput.hh"
+#include "sminstrument.hh"
+
+#include <unistd.h>
+
+namespace SpectMorph
+{
+
+/* Load the plan given on the command line, or (for make check) create a plan with
+ * one wav source, using an instrument with one looped sample (saw440.wav in srcdir)
+ */
+inline Error
+load_test_plan (Project& project, int argc, char **argv)
+{
+  if (argc == 2)
+    return project.load (argv[1]);
+
+  const char *srcdir = getenv ("srcdir");
+  const std::string filename = std::string (srcdir ? srcdir : ".") + "/saw440.wav";
+
+  WavData wav_data;
+  if (!wav_data.load (filename))
+    return Error (string_printf ("%s: %s", filename.c_str(), wav_data.error_blurb()));
+
+  MorphPlan *plan = project.morph_plan();
+  while (!plan->operators().empty())
+    plan->remove (plan->operators().back());
+
+  MorphWavSource *wav_source = new MorphWavSource (plan);
+  plan->add_operator (wav_source, MorphPlan::ADD_POS_AUTO);
+
+  Instrument *instrument = new Instrument();
+  Sample *sample = instrument->add_sample (wav_data, filename);
+  sample->set_midi_note (69);
+  sample->set_loop (Sample::Loop::FORWARD);
+  sample->set_marker (MARKER_LOOP_START, 300);
+  sample->set_marker (MARKER_LOOP_END, 500);
+  project.lookup_instrument (wav_source).instrument.reset (instrument);
+  project.rebuild (wav_source);
+
+  MorphOutput *output = new MorphOutput (plan);
+  plan->add_operator (output, MorphPlan::ADD_POS_AUTO);
+  output->set_channel_op (0, wav_source);
+
+  // instrument is built in the background
+  while (project.rebuild_active (wav_source->object_id()))
+    usleep (10 * 1000);
+
+  return Error::Code::NONE;
+}
+
+}
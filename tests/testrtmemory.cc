@@ -0,0 +1,61 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smrtmemory.hh"
+#include "smmain.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  AudioBlock block;
+  block.freqs = { 100, 200, 300 };
+  block.mags  = { 1000, 2000, 3000 };
+  block.noise = { 10, 20 };
+
+  RTMemoryArea rt_memory_area;
+
+  /* borrowed data is not copied */
+  RTAudioBlock rt_block (&rt_memory_area);
+  rt_block.borrow (block);
+  assert (rt_block.freqs.borrowed() && rt_block.freqs.data() == block.freqs.data());
+  assert (rt_block.mags.size() == 3 && rt_block.noise.size() == 2);
+
+  /* assigning a borrowed block shares the data */
+  RTAudioBlock rt_copy (&rt_memory_area);
+  rt_copy.assign (rt_block);
+  assert (rt_copy.mags.borrowed() && rt_copy.mags.data() == block.mags.data());
+
+  /* reading doesn't copy */
+  const RTAudioBlock& const_block = rt_block;
+  assert (const_block.mags[1] == 2000 && const_block.mags.back() == 3000 && const_block.mags_f (0) == sm_idb2factor (1000));
+  assert (rt_block.mags.borrowed() && rt_block.mags.data() == block.mags.data());
+
+  /* writing creates a private copy (and leaves the original data alone) */
+  rt_copy.mags.set (1, 4242);
+  assert (!rt_copy.mags.borrowed());
+  assert (rt_copy.mags.data() != block.mags.data());
+  assert (rt_copy.mags[0] == 1000 && rt_copy.mags[1] == 4242 && rt_copy.mags[2] == 3000);
+  assert (block.mags[1] == 2000 && const_block.mags[1] == 2000);
+  assert (rt_block.mags.borrowed() && rt_copy.freqs.borrowed());
+
+  /* a borrowed view can be replaced by new data */
+  RTAudioBlock rt_new (&rt_memory_area);
+  rt_new.borrow (block);
+  rt_new.freqs.set_capacity (2);
+  rt_new.freqs.push_back (500);
+  assert (!rt_new.freqs.borrowed() && rt_new.freqs.size() == 1 && rt_new.freqs[0] == 500);
+  rt_new.mags.borrow (block.noise);
+  assert (rt_new.mags.borrowed() && rt_new.mags.size() == 2);
+
+  /* copying data we own still copies */
+  RTAudioBlock rt_copy2 (&rt_memory_area);
+  rt_copy2.assign (rt_copy);
+  assert (rt_copy2.mags.data() != rt_copy.mags.data() && rt_copy2.mags[1] == 4242);
+
+  rt_memory_area.free_all();
+}
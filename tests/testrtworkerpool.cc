@@ -0,0 +1,58 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smrtworkerpool.hh"
+#include "smmain.hh"
+
+#include <unistd.h>
+#include <assert.h>
+
+using std::vector;
+
+using namespace SpectMorph;
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  for (int n_threads : { 1, 2, 4 })
+    {
+      RTWorkerPool pool (n_threads);
+      assert (pool.n_threads() == n_threads);
+
+      vector<int> job_count (256);
+      vector<int> job_thread (256);
+      int         thread_used[4] = { 0, };
+
+      for (int run = 0; run < 2000; run++)
+        {
+          size_t n_jobs = run % 256;
+
+          std::fill (job_count.begin(), job_count.end(), 0);
+          auto func = [&] (size_t job, int thread_index)
+            {
+              job_count[job]++;
+              job_thread[job] = thread_index;
+            };
+          pool.run (n_jobs, func);
+
+          /* every job must be executed exactly once before run() returns */
+          for (size_t job = 0; job < job_count.size(); job++)
+            assert (job_count[job] == (job < n_jobs ? 1 : 0));
+
+          for (size_t job = 0; job < n_jobs; job++)
+            {
+              assert (job_thread[job] >= 0 && job_thread[job] < n_threads);
+              thread_used[job_thread[job]]++;
+            }
+
+          /* sometimes wait long enough to make workers park */
+          if (run % 500 == 0)
+            usleep (20 * 1000);
+        }
+      printf ("threads %d:", n_threads);
+      for (int t = 0; t < n_threads; t++)
+        printf (" %d", thread_used[t]);
+      printf ("\n");
+    }
+}
@@ -0,0 +1,161 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smlivedecoder.hh"
+#include "smspectralmixer.hh"
+#include "smwavsetbuilder.hh"
+#include "sminstrument.hh"
+#include "smrandom.hh"
+#include "smmain.hh"
+#include "smfft.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+using std::max;
+
+/* voices that use the spectral mixer should sound like voices with their own IFFTs; if the
+ * gain of a voice changes (like when the envelope is released), blocks that were already mixed
+ * must follow the gain change at the exact sample position
+ */
+
+static Instrument *
+make_instrument()
+{
+  Instrument *inst = new Instrument();
+
+  const double sr = 48000;
+  const double f0 = 261.626;
+  Random random;
+  random.set_seed (42);
+
+  vector<float> signal (sr * 1.5);
+  for (size_t i = 0; i < signal.size(); i++)
+    {
+      double t = i / sr, v = 0;
+      for (int h = 1; h * f0 < 10000; h++)
+        v += sin (2 * M_PI * h * f0 * t + h * 0.7) / (h * h * 0.3 + 1);
+      v += 0.05 * random.random_double_range (-1, 1);
+      signal[i] = v * 0.3;
+    }
+  WavData wav_data (signal, 1, sr, 16);
+  Sample *sample = inst->add_sample (wav_data, "spectralmixer.wav");
+  sample->set_midi_note (60);
+  return inst;
+}
+
+/* render a chord, the gain of the voices is 1 until release_pos, then fades to 0 within release_len samples */
+static vector<float>
+render (WavSet *wav_set, bool spectral_mixing, bool noise, size_t release_pos, size_t release_len, size_t *max_lanes = nullptr)
+{
+  const double mix_freq = 48000;
+  const float  gain = 0.7;
+  const size_t step = 50;
+  const int    notes[]  = { 60, 64, 67 };
+  const size_t starts[] = { 0, 0, 100 };  // third voice is not aligned with the other voices
+
+  std::unique_ptr<SpectralMixer> mixer (spectral_mixing ? new SpectralMixer (mix_freq) : nullptr);
+  vector<std::unique_ptr<LiveDecoder>> voices;
+  for (size_t v = 0; v < 3; v++)
+    {
+      voices.emplace_back (new LiveDecoder (wav_set, mix_freq));
+      voices[v]->set_random_seed (v);
+      voices[v]->enable_noise (noise);
+      voices[v]->enable_loop_cache (false);
+      voices[v]->enable_osc_bank (false);
+    }
+  auto envelope = [&] (size_t pos) -> float
+    {
+      if (pos < release_pos)
+        return 1;
+      if (pos >= release_pos + release_len)
+        return 0;
+      return 1 - float (pos - release_pos) / release_len;
+    };
+
+  RTMemoryArea rt_memory_area;
+  vector<float> samples (mix_freq), voice_samples (step);
+  for (size_t pos = 0; pos < samples.size(); pos += step)
+    {
+      for (size_t v = 0; v < voices.size(); v++)
+        {
+          if (pos < starts[v])
+            continue;
+          if (pos == starts[v])
+            voices[v]->retrigger (0, 440 * exp2 ((notes[v] - 69) / 12.), 100);
+
+          /* mixing is only possible while the envelope is constant */
+          const bool constant = pos + step <= release_pos;
+          voices[v]->set_spectral_mixer (constant ? mixer.get() : nullptr, gain * envelope (pos));
+          voices[v]->process (rt_memory_area, step, nullptr, &voice_samples[0]);
+          rt_memory_area.free_all();
+
+          for (size_t i = 0; i < step; i++)
+            samples[pos + i] += voice_samples[i] * gain * envelope (pos + i);
+        }
+      if (mixer)
+        {
+          mixer->process (&samples[pos], step);
+
+          if (max_lanes)
+            *max_lanes = max (*max_lanes, mixer->active_lanes());
+        }
+    }
+  return samples;
+}
+
+static double
+snr (const vector<float>& samples, const vector<float>& ref)
+{
+  double signal_energy = 0, error_energy = 0;
+  for (size_t i = 0; i < samples.size(); i++)
+    {
+      signal_energy += ref[i] * ref[i];
+      error_energy += (samples[i] - ref[i]) * (samples[i] - ref[i]);
+    }
+  return 10 * log10 (signal_energy / error_energy);
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  FFT::debug_in_test_program (true);
+
+  std::unique_ptr<Instrument> inst (make_instrument());
+  WavSetBuilder builder (inst.get(), false);
+  std::unique_ptr<WavSet> wav_set (builder.run());
+
+  const size_t release_pos = 30000; // not aligned with any voice block
+
+  /* sustained notes: mixed output should be the same as the output of voices with their own IFFTs */
+  size_t max_lanes = 0;
+  vector<float> mixed = render (wav_set.get(), true, false, 48000, 0, &max_lanes);
+  vector<float> ref = render (wav_set.get(), false, false, 48000, 0);
+  const double sustain_snr_db = snr (mixed, ref);
+  sm_printf ("sustain: lanes %zd, snr %.2f dB\n", max_lanes, sustain_snr_db);
+  assert (max_lanes == 2);
+  assert (sustain_snr_db > 80);
+
+  /* release: the fade out starts at the release position, also for blocks that were mixed before */
+  mixed = render (wav_set.get(), true, false, release_pos, 1000);
+  ref = render (wav_set.get(), false, false, release_pos, 1000);
+  const double release_snr_db = snr (mixed, ref);
+  sm_printf ("release: snr %.2f dB\n", release_snr_db);
+  assert (release_snr_db > 80);
+
+  /* voices with noise are cut at the release position: nothing should remain in the mixer */
+  mixed = render (wav_set.get(), true, true, release_pos, 0);
+  float peak_before = 0, peak_after = 0;
+  for (size_t i = 0; i < mixed.size(); i++)
+    {
+      if (i < release_pos)
+        peak_before = max (peak_before, std::abs (mixed[i]));
+      else
+        peak_after = max (peak_after, std::abs (mixed[i]));
+    }
+  sm_printf ("cut: peak before %f, peak after %g\n", peak_before, peak_after);
+  assert (peak_before > 0.1);
+  assert (peak_after < 1e-5);
+}
@@ -0,0 +1,116 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smfft.hh"
+#include "testplan.hh"
+
+#include <unistd.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+/* run synthesis thread for some time, process control events like a plugin would do */
+static void
+run_synth (Project& project, double seconds)
+{
+  vector<float> output (512);
+
+  double end = get_time() + seconds;
+  while (get_time() < end)
+    {
+      project.try_update_synth();
+      project.midi_synth()->process (output.data(), output.size());
+      usleep (10 * 1000);
+    }
+}
+
+static void
+process_block (Project& project)
+{
+  vector<float> output (64);
+
+  project.try_update_synth();
+  project.midi_synth()->process (output.data(), output.size());
+}
+
+static void
+notes (MidiSynth& midi_synth, int channel, int first, int count, bool on)
+{
+  for (int i = 0; i < count; i++)
+    {
+      unsigned char event[3] = { uint8 ((on ? 0x90 : 0x80) + channel), uint8 (first + i), 100 };
+      midi_synth.add_midi_event (0, event);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  FFT::debug_in_test_program (true);
+  if (argc > 2)
+    {
+      printf ("usage: %s [ <plan> ]\n", argv[0]);
+      exit (1);
+    }
+
+  Project project;
+  project.enable_voice_pool();
+  project.set_mix_freq (48000);
+
+  Error error = load_test_plan (project, argc, argv);
+  assert (!error);
+  run_synth (project, 0.2);
+
+  MidiSynth& midi_synth = *project.midi_synth();
+  const size_t max_voices = midi_synth.max_voices();
+  printf ("initial pool size: %zd (max voices %zd)\n", midi_synth.pool_size(), max_voices);
+  assert (midi_synth.pool_size() == std::min (VoicePool::INITIAL_VOICES, max_voices));
+
+  notes (midi_synth, 0, 30, 40, true);
+  run_synth (project, 0.01);
+  printf ("40 notes: %zd active voices\n", midi_synth.active_voice_count());
+  assert (midi_synth.active_voice_count() == std::min<size_t> (40, max_voices));
+
+  /* more notes than voices in pool: notes wait until the pool has grown, none is lost */
+  notes (midi_synth, 0, 70, 40, true);
+  run_synth (project, 0.5);
+  printf ("80 notes: %zd active voices, pool size %zd\n", midi_synth.active_voice_count(), midi_synth.pool_size());
+  assert (midi_synth.active_voice_count() == std::min<size_t> (80, max_voices));
+  assert (midi_synth.pool_size() >= std::min (80 + VoicePool::HEADROOM, max_voices));
+
+  /* more notes than max_voices: voices are stolen */
+  notes (midi_synth, 1, 30, 80, true);
+  run_synth (project, 0.5);
+  printf ("160 notes: %zd active voices, pool size %zd\n", midi_synth.active_voice_count(), midi_synth.pool_size());
+  assert (midi_synth.pool_size() == max_voices);
+  assert (midi_synth.active_voice_count() == max_voices);
+
+  /* release all notes: after some time without demand, the pool shrinks */
+  notes (midi_synth, 0, 30, 80, false);
+  notes (midi_synth, 1, 30, 80, false);
+  run_synth (project, VoicePool::SHRINK_DELAY * 2 + 1);
+  printf ("pool size after shrinking: %zd\n", midi_synth.pool_size());
+  assert (midi_synth.pool_size() == std::min (VoicePool::MIN_VOICES, max_voices));
+
+  /* normal chords don't need to wait for voices */
+  notes (midi_synth, 0, 60, 10, true);
+  process_block (project);
+  assert (midi_synth.active_voice_count() == 10);
+
+  /* if notes are waiting, the pool grows without waiting for the next regular update */
+  notes (midi_synth, 1, 30, 60, true);
+  const double start = get_time();
+  while (midi_synth.active_voice_count() < std::min<size_t> (70, max_voices))
+    {
+      process_block (project);
+      usleep (1000);
+    }
+  const double grow_ms = (get_time() - start) * 1000;
+  printf ("time to grow pool for 60 more notes: %.2f ms\n", grow_ms);
+  assert (grow_ms < VoicePool::UPDATE_MS);
+}
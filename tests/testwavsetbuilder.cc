@@ -0,0 +1,91 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smwavsetbuilder.hh"
+#include "sminstrument.hh"
+#include "smmain.hh"
+#include "smfft.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+/* WavSetBuilder encodes samples in parallel; if the build is killed, it should return
+ * nullptr and not start any more encodes after the first encode has been killed
+ *
+ * encoded samples are cached, so each build uses different samples
+ */
+
+static Instrument *
+make_instrument (int first_note, int n_samples)
+{
+  Instrument *inst = new Instrument();
+
+  const double sr = 48000;
+  for (int s = 0; s < n_samples; s++)
+    {
+      const int    note = first_note + s * 5;
+      const double freq = 440 * exp2 ((note - 69) / 12.);
+
+      vector<float> signal (sr * 0.3);
+      for (size_t i = 0; i < signal.size(); i++)
+        signal[i] = 0.5 * sin (2 * M_PI * freq * i / sr);
+
+      WavData wav_data (signal, 1, sr, 16);
+      Sample *sample = inst->add_sample (wav_data, string_printf ("sample%d.wav", s));
+      sample->set_midi_note (note);
+    }
+  return inst;
+}
+
+/* build instrument, with a kill function that kills the first encode */
+static WavSet *
+build_killed (Instrument *inst, int n_threads, size_t memory_budget, int *kill_calls)
+{
+  WavSetBuilder builder (inst, false);
+
+  *kill_calls = 0;
+  builder.set_kill_function ([kill_calls]() { (*kill_calls)++; return true; });
+  builder.set_threads (n_threads);
+  builder.set_memory_budget (memory_budget);
+  return builder.run();
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  FFT::debug_in_test_program (true);
+
+  std::unique_ptr<Instrument> inst (make_instrument (48, 4));
+  std::unique_ptr<Instrument> inst1 (make_instrument (80, 1));
+  std::unique_ptr<Instrument> inst_kill1 (make_instrument (49, 4));
+  std::unique_ptr<Instrument> inst_kill2 (make_instrument (50, 4));
+
+  /* normal build */
+  WavSetBuilder builder (inst.get(), false);
+  builder.set_threads (2);
+  std::unique_ptr<WavSet> wav_set (builder.run());
+  assert (wav_set && wav_set->waves.size() == 4);
+
+  assert (WavSetBuilder::default_memory_budget() > 0);
+
+  /* reference: number of kill function calls for one killed encode (one encoder thread) */
+  int kill_calls_one = 0;
+  std::unique_ptr<WavSet> wav_set1 (build_killed (inst1.get(), 1, WavSetBuilder::default_memory_budget(), &kill_calls_one));
+  assert (!wav_set1 && kill_calls_one > 0);
+
+  /* one thread: no more samples are encoded after the first one was killed */
+  int kill_calls = 0;
+  std::unique_ptr<WavSet> wav_set_killed (build_killed (inst_kill1.get(), 1, WavSetBuilder::default_memory_budget(), &kill_calls));
+  sm_printf ("kill calls: one encode %d, one thread %d\n", kill_calls_one, kill_calls);
+  assert (!wav_set_killed && kill_calls == kill_calls_one);
+
+  /* two workers, but memory budget only allows one encode at a time: the second worker must
+   * not start an encode after the first was killed
+   */
+  wav_set_killed.reset (build_killed (inst_kill2.get(), 2, 1, &kill_calls));
+  sm_printf ("kill calls: two threads, small memory budget %d\n", kill_calls);
+  assert (!wav_set_killed && kill_calls == kill_calls_one);
+}
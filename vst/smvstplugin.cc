@@ -63,6 +63,7 @@ VstPlugin::VstPlugin (audioMasterCallback master, AEffect *aeffect) :
   parameters.push_back (Parameter ("Control #4", 0, -1, 1));
 
   // initialize mix_freq with something, so that the plugin doesn't crash if the host never calls SetSampleRate
+  project.enable_voice_pool();
   set_mix_freq (48000);
 }
 